@@ -0,0 +1,502 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2016 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "backlogcache.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QtEndian>
+
+// The file starts with a header (magic, version), followed by records of
+//   quint32 payload length | quint8 record type | qint32 buffer id | qint32 msg id | payload
+// with all integers in big endian. Message records carry the serialized Message, drop records have no payload.
+// Range records mark the messages of a buffer from their msg id to the one in their payload (qint32) as complete.
+static const quint32 cacheMagic = 0x51424c43; // "QBLC"
+static const quint32 cacheVersion = 2;
+static const qint64 fileHeaderSize = 8;
+static const qint64 recordHeaderSize = 13;
+
+BacklogCache::BacklogCache()
+    : _map(0),
+    _mapSize(0),
+    _maxSize(0)
+{
+}
+
+
+BacklogCache::~BacklogCache()
+{
+    close();
+}
+
+
+bool BacklogCache::open(const QString &fileName, qint64 maxSize)
+{
+    close();
+
+    _file.setFileName(fileName);
+    _maxSize = maxSize;
+    if (!_file.open(QIODevice::ReadWrite)) {
+        qWarning() << "Could not open backlog cache" << fileName << ":" << qPrintable(_file.errorString());
+        return false;
+    }
+
+    if (_file.size() == 0 || !scan()) {
+        if (_file.size() > 0)
+            qWarning() << "Discarding unusable backlog cache" << fileName;
+        _index.clear();
+        _ranges.clear();
+        unmap();
+        _file.resize(0);
+        _file.seek(0);
+        QDataStream out(&_file);
+        out << cacheMagic << cacheVersion;
+        _file.flush();
+    }
+    _file.seek(_file.size());
+
+    if (_file.size() > _maxSize)
+        compact();
+    return true;
+}
+
+
+void BacklogCache::close()
+{
+    unmap();
+    if (_file.isOpen())
+        _file.close();
+    _index.clear();
+    _ranges.clear();
+    _droppedBefore.clear();
+    _compactedBefore = MsgId();
+}
+
+
+bool BacklogCache::scan()
+{
+    _index.clear();
+    _ranges.clear();
+    unmap();
+
+    qint64 size = _file.size();
+    if (size < fileHeaderSize)
+        return false;
+
+    QByteArray contents;
+    const uchar *data = _map = _file.map(0, size);
+    if (_map) {
+        _mapSize = size;
+    }
+    else {
+        // not all platforms support mapping files
+        _file.seek(0);
+        contents = _file.readAll();
+        data = reinterpret_cast<const uchar *>(contents.constData());
+    }
+
+    if (qFromBigEndian<quint32>(data) != cacheMagic || qFromBigEndian<quint32>(data + 4) != cacheVersion)
+        return false;
+
+    qint64 pos = fileHeaderSize;
+    while (pos + recordHeaderSize <= size) {
+        quint32 length = qFromBigEndian<quint32>(data + pos);
+        if (pos + recordHeaderSize + length > size)
+            break;
+
+        quint8 type = data[pos + 4];
+        BufferId bufferId = qFromBigEndian<qint32>(data + pos + 5);
+        MsgId msgId = qFromBigEndian<qint32>(data + pos + 9);
+        switch (type) {
+            case MessageRecord:
+                _index[bufferId].insert(msgId, pos);
+                break;
+            case DropRecord:
+                removeFromIndex(bufferId, msgId);
+                break;
+            case RangeRecord:
+                if (length == 4)
+                    addRange(bufferId, msgId, qFromBigEndian<qint32>(data + pos + recordHeaderSize));
+                break;
+            default:
+                break;
+        }
+        pos += recordHeaderSize + length;
+    }
+
+    if (pos < size) {
+        // the last record was only partially written, most likely we crashed
+        unmap();
+        _file.resize(pos);
+    }
+    return true;
+}
+
+
+void BacklogCache::addMessage(const Message &msg)
+{
+    if (!append(msg))
+        return;
+
+    _file.flush();
+    if (_file.size() > _maxSize)
+        compact();
+}
+
+
+void BacklogCache::addMessages(const MessageList &msgs)
+{
+    bool added = false;
+    foreach(const Message &msg, msgs) {
+        added |= append(msg);
+    }
+    if (!added)
+        return;
+
+    _file.flush();
+    if (_file.size() > _maxSize)
+        compact();
+}
+
+
+bool BacklogCache::append(const Message &msg)
+{
+    if (!isOpen() || !msg.msgId().isValid() || !msg.bufferId().isValid())
+        return false;
+
+    QMap<MsgId, qint64> &msgIds = _index[msg.bufferId()];
+    if (msgIds.contains(msg.msgId()))
+        return false;
+
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_2);
+    out << msg;
+
+    qint64 offset = _file.pos();
+    if (!writeRecord(_file, MessageRecord, msg.bufferId(), msg.msgId(), payload)) {
+        qWarning() << "Could not write to backlog cache:" << qPrintable(_file.errorString());
+        close();
+        return false;
+    }
+    msgIds.insert(msg.msgId(), offset);
+    return true;
+}
+
+
+void BacklogCache::dropOlderThan(BufferId bufferId, MsgId msgId)
+{
+    if (!isOpen() || (!_index.contains(bufferId) && !_ranges.contains(bufferId)))
+        return;
+
+    removeFromIndex(bufferId, msgId);
+    if (msgId > _droppedBefore.value(bufferId))
+        _droppedBefore[bufferId] = msgId;
+    writeRecord(_file, DropRecord, bufferId, msgId);
+    _file.flush();
+}
+
+
+void BacklogCache::removeFromIndex(BufferId bufferId, MsgId msgId)
+{
+    QHash<BufferId, QMap<MsgId, MsgId> >::iterator ranges = _ranges.find(bufferId);
+    if (ranges != _ranges.end()) {
+        QMap<MsgId, MsgId>::iterator range = ranges->begin();
+        while (range != ranges->end() && range.key() < msgId) {
+            MsgId last = range.value();
+            range = ranges->erase(range);
+            if (last >= msgId) {
+                ranges->insert(msgId, last);
+                break;
+            }
+        }
+        if (ranges->isEmpty())
+            _ranges.erase(ranges);
+    }
+
+    QHash<BufferId, QMap<MsgId, qint64> >::iterator msgIds = _index.find(bufferId);
+    if (msgIds == _index.end())
+        return;
+
+    QMap<MsgId, qint64>::iterator iter = msgIds->begin();
+    while (iter != msgIds->end() && iter.key() < msgId)
+        iter = msgIds->erase(iter);
+
+    if (msgIds->isEmpty())
+        _index.erase(msgIds);
+}
+
+
+void BacklogCache::markComplete(BufferId bufferId, MsgId first, MsgId last)
+{
+    if (first < _compactedBefore)
+        first = _compactedBefore;
+    if (first < _droppedBefore.value(bufferId))
+        first = _droppedBefore.value(bufferId);
+    if (!isOpen() || !bufferId.isValid() || last < first)
+        return;
+
+    if (!addRange(bufferId, first, last))
+        return; // nothing new
+
+    QByteArray payload(4, 0);
+    qToBigEndian<qint32>(last.toInt(), reinterpret_cast<uchar *>(payload.data()));
+    writeRecord(_file, RangeRecord, bufferId, first, payload);
+    _file.flush();
+}
+
+
+// Merges the given range with the ones it overlaps or directly continues. Returns false if it was covered already.
+bool BacklogCache::addRange(BufferId bufferId, MsgId first, MsgId last)
+{
+    QMap<MsgId, MsgId> &ranges = _ranges[bufferId];
+    QMap<MsgId, MsgId>::iterator range = ranges.upperBound(first);
+    if (range != ranges.begin()) {
+        --range;
+        if (range.value() >= last)
+            return false;
+        if (range.value().toInt() + 1 < first.toInt())
+            ++range;
+    }
+
+    while (range != ranges.end() && range.key().toInt() <= last.toInt() + 1) {
+        if (range.key() < first)
+            first = range.key();
+        if (range.value() > last)
+            last = range.value();
+        range = ranges.erase(range);
+    }
+    ranges.insert(first, last);
+    return true;
+}
+
+
+bool BacklogCache::completeTail(BufferId bufferId, MsgId *first, MsgId *last) const
+{
+    QHash<BufferId, QMap<MsgId, MsgId> >::const_iterator ranges = _ranges.constFind(bufferId);
+    if (ranges == _ranges.constEnd() || ranges->isEmpty())
+        return false;
+
+    QMap<MsgId, MsgId>::const_iterator tail = ranges->constEnd();
+    --tail;
+    *first = tail.key();
+    *last = tail.value();
+    return true;
+}
+
+
+MessageList BacklogCache::messages(BufferId bufferId, MsgId first, int limit, int additional) const
+{
+    MessageList result;
+    QHash<BufferId, QMap<MsgId, qint64> >::const_iterator msgIds = _index.constFind(bufferId);
+    MsgId tailFirst, tailLast;
+    if (msgIds == _index.constEnd() || !completeTail(bufferId, &tailFirst, &tailLast))
+        return result;
+
+    // the newest limit messages not older than first...
+    QMap<MsgId, qint64>::const_iterator tailBegin = msgIds->lowerBound(tailFirst);
+    QMap<MsgId, qint64>::const_iterator begin = msgIds->lowerBound(qMax(first, tailFirst));
+    QMap<MsgId, qint64>::const_iterator end = msgIds->upperBound(tailLast);
+    QMap<MsgId, qint64>::const_iterator iter = end;
+    int count = 0;
+    while (iter != begin && (limit < 0 || count < limit)) {
+        --iter;
+        ++count;
+    }
+
+    // ... plus additional older ones, but only if they continue seamlessly (like the core does it)
+    if (iter == begin) {
+        count = 0;
+        while (iter != tailBegin && count < additional) {
+            --iter;
+            ++count;
+        }
+    }
+
+    mapFile();
+    while (iter != end) {
+        QByteArray payload = readRecord(iter.value());
+        QDataStream in(payload);
+        in.setVersion(QDataStream::Qt_4_2);
+        Message msg;
+        in >> msg;
+        if (in.status() == QDataStream::Ok)
+            result << msg;
+        ++iter;
+    }
+    return result;
+}
+
+
+bool BacklogCache::writeRecord(QFile &file, quint8 type, BufferId bufferId, MsgId msgId, const QByteArray &payload)
+{
+    uchar header[recordHeaderSize];
+    qToBigEndian<quint32>(payload.size(), header);
+    header[4] = type;
+    qToBigEndian<qint32>(bufferId.toInt(), header + 5);
+    qToBigEndian<qint32>(msgId.toInt(), header + 9);
+
+    return file.write(reinterpret_cast<const char *>(header), recordHeaderSize) == recordHeaderSize
+           && file.write(payload) == payload.size();
+}
+
+
+// The returned data may point into the mapped file, so it is only valid until the next mapFile() or unmap()
+QByteArray BacklogCache::readRecord(qint64 offset) const
+{
+    if (_map && offset + recordHeaderSize <= _mapSize) {
+        quint32 length = qFromBigEndian<quint32>(_map + offset);
+        if (offset + recordHeaderSize + length <= _mapSize)
+            return QByteArray::fromRawData(reinterpret_cast<const char *>(_map + offset + recordHeaderSize), length);
+    }
+
+    // not mapped (yet), so read it the old-fashioned way
+    QByteArray payload;
+    qint64 end = _file.pos();
+    if (_file.seek(offset)) {
+        QByteArray header = _file.read(recordHeaderSize);
+        if (header.size() == recordHeaderSize)
+            payload = _file.read(qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(header.constData())));
+    }
+    _file.seek(end);
+    return payload;
+}
+
+
+// Maps all records written so far; callers must do this before reading records, not while they still use some
+void BacklogCache::mapFile() const
+{
+    _file.flush();
+    if (_map && _mapSize == _file.size())
+        return;
+
+    unmap();
+    _mapSize = _file.size();
+    _map = _file.map(0, _mapSize);
+    if (!_map)
+        _mapSize = 0;
+}
+
+
+void BacklogCache::unmap() const
+{
+    if (_map) {
+        _file.unmap(_map);
+        _map = 0;
+        _mapSize = 0;
+    }
+}
+
+
+// Rewrites the log with only the newest messages (MsgIds are global, so that's across all buffers). We keep
+// three quarters of the maximum size, so we don't need to compact again after a few more messages.
+void BacklogCache::compact()
+{
+    mapFile();
+
+    QMap<MsgId, QPair<BufferId, qint64> > records;
+    QHash<BufferId, QMap<MsgId, qint64> >::const_iterator bufferIter = _index.constBegin();
+    while (bufferIter != _index.constEnd()) {
+        QMap<MsgId, qint64>::const_iterator msgIter = bufferIter->constBegin();
+        while (msgIter != bufferIter->constEnd()) {
+            records.insert(msgIter.key(), qMakePair(bufferIter.key(), msgIter.value()));
+            ++msgIter;
+        }
+        ++bufferIter;
+    }
+
+    // find the oldest message we can keep; the range records written after the messages need room as well
+    qint64 budget = _maxSize * 3 / 4 - fileHeaderSize;
+    QHash<BufferId, QMap<MsgId, MsgId> >::const_iterator rangeCountIter = _ranges.constBegin();
+    while (rangeCountIter != _ranges.constEnd()) {
+        budget -= rangeCountIter->count() * (recordHeaderSize + 4);
+        ++rangeCountIter;
+    }
+    QMap<MsgId, QPair<BufferId, qint64> >::const_iterator first = records.constEnd();
+    while (first != records.constBegin()) {
+        --first;
+        budget -= recordHeaderSize + readRecord(first.value().second).size();
+        if (budget < 0) {
+            ++first;
+            break;
+        }
+    }
+
+    QString fileName = _file.fileName();
+    QFile newFile(fileName + ".new");
+    if (!newFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Could not compact backlog cache" << fileName << ":" << qPrintable(newFile.errorString());
+        return;
+    }
+    QDataStream out(&newFile);
+    out << cacheMagic << cacheVersion;
+
+    QMap<MsgId, QPair<BufferId, qint64> >::const_iterator recordIter = first;
+    while (recordIter != records.constEnd()) {
+        if (!writeRecord(newFile, MessageRecord, recordIter.value().first, recordIter.key(), readRecord(recordIter.value().second))) {
+            qWarning() << "Could not compact backlog cache" << fileName << ":" << qPrintable(newFile.errorString());
+            newFile.remove();
+            return;
+        }
+        ++recordIter;
+    }
+
+    // the complete ranges still hold from the oldest message we keep on
+    if (first != records.constEnd()) {
+        MsgId oldest = first.key();
+        QHash<BufferId, QMap<MsgId, MsgId> >::const_iterator rangesIter = _ranges.constBegin();
+        while (rangesIter != _ranges.constEnd()) {
+            QMap<MsgId, MsgId>::const_iterator range = rangesIter->constBegin();
+            while (range != rangesIter->constEnd()) {
+                if (range.value() >= oldest) {
+                    QByteArray payload(4, 0);
+                    qToBigEndian<qint32>(range.value().toInt(), reinterpret_cast<uchar *>(payload.data()));
+                    if (!writeRecord(newFile, RangeRecord, rangesIter.key(), qMax(range.key(), oldest), payload)) {
+                        qWarning() << "Could not compact backlog cache" << fileName << ":" << qPrintable(newFile.errorString());
+                        newFile.remove();
+                        return;
+                    }
+                }
+                ++range;
+            }
+            ++rangesIter;
+        }
+    }
+    newFile.close();
+
+    // remember what we've dropped, so markComplete() doesn't extend ranges over it
+    MsgId compactedBefore = _compactedBefore;
+    if (first != records.constEnd())
+        compactedBefore = qMax(compactedBefore, first.key());
+    else if (!records.isEmpty())
+        compactedBefore = qMax(compactedBefore, MsgId((records.constEnd() - 1).key().toInt() + 1));
+    QHash<BufferId, MsgId> droppedBefore = _droppedBefore;
+
+    qint64 maxSize = _maxSize;
+    close();
+    QFile::remove(fileName);
+    if (!QFile::rename(newFile.fileName(), fileName) || !open(fileName, maxSize)) {
+        qWarning() << "Could not replace backlog cache" << fileName;
+        return;
+    }
+    if (_compactedBefore < compactedBefore)
+        _compactedBefore = compactedBefore; // open() may have compacted once more
+    _droppedBefore = droppedBefore;
+}
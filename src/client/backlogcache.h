@@ -0,0 +1,100 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2016 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#ifndef BACKLOGCACHE_H
+#define BACKLOGCACHE_H
+
+#include <QFile>
+#include <QHash>
+#include <QMap>
+
+#include "message.h"
+#include "types.h"
+
+//! A local on-disk copy of the messages a client has received from a core
+/** Messages are appended to a log file, one per core account, and found through an in-memory index by MsgId.
+ *  The log is memory-mapped for reading. Once it grows beyond its maximum size, it is rewritten with only the
+ *  newest messages.
+ *
+ *  A buffer's cached messages may have gaps (e.g. from times the client wasn't connected), so the cache also
+ *  keeps track of the MsgId ranges it is known to hold all messages of a buffer for. Only those are handed out.
+ */
+class BacklogCache
+{
+public:
+    BacklogCache();
+    ~BacklogCache();
+
+    bool open(const QString &fileName, qint64 maxSize);
+    void close();
+    inline bool isOpen() const { return _file.isOpen(); }
+
+    void addMessage(const Message &msg);
+    void addMessages(const MessageList &msgs);
+
+    //! Forgets all cached messages of the given buffer that are older than msgId
+    void dropOlderThan(BufferId bufferId, MsgId msgId);
+
+    //! Records that all messages of the given buffer from first to last (inclusive) have been added
+    /** Messages that have been dropped since (by dropOlderThan() or because the cache got too big) are
+     *  excluded from the range.
+     */
+    void markComplete(BufferId bufferId, MsgId first, MsgId last);
+
+    //! The newest MsgId range we have all messages of the given buffer for
+    /** Returns false if there is no such range.
+     */
+    bool completeTail(BufferId bufferId, MsgId *first, MsgId *last) const;
+
+    //! Returns the newest limit messages not older than first, plus up to additional older ones
+    /** Only messages from the completeTail() are returned. A negative limit returns all messages not older
+     *  than first.
+     */
+    MessageList messages(BufferId bufferId, MsgId first, int limit, int additional = 0) const;
+
+private:
+    enum RecordType {
+        MessageRecord = 0,
+        DropRecord = 1,
+        RangeRecord = 2
+    };
+
+    bool scan();
+    bool append(const Message &msg);
+    void removeFromIndex(BufferId bufferId, MsgId msgId);
+    bool addRange(BufferId bufferId, MsgId first, MsgId last);
+    bool writeRecord(QFile &file, quint8 type, BufferId bufferId, MsgId msgId, const QByteArray &payload = QByteArray());
+    QByteArray readRecord(qint64 offset) const;
+    void mapFile() const;
+    void unmap() const;
+    void compact();
+
+    mutable QFile _file;
+    mutable uchar *_map;
+    mutable qint64 _mapSize;
+    qint64 _maxSize;
+    QHash<BufferId, QMap<MsgId, qint64> > _index; // record offsets by MsgId, per buffer
+    QHash<BufferId, QMap<MsgId, MsgId> > _ranges; // last MsgId of the complete ranges by their first one, per buffer
+    QHash<BufferId, MsgId> _droppedBefore; // in this session, per buffer
+    MsgId _compactedBefore; // in this session
+};
+
+
+#endif // BACKLOGCACHE_H
@@ -23,12 +23,14 @@
 #include <QObject>
 
 #include "backlogsettings.h"
+#include "buffermodel.h"
 #include "bufferviewoverlay.h"
 #include "clientbacklogmanager.h"
 
+// Streamed backlog is dispatched chunk by chunk as it arrives, so there's nothing to buffer
 BacklogRequester::BacklogRequester(bool buffering, RequesterType requesterType, ClientBacklogManager *backlogManager)
     : backlogManager(backlogManager),
-    _isBuffering(buffering),
+    _isBuffering(buffering && !backlogManager->isChunked()),
     _requesterType(requesterType),
     _totalBuffers(0)
 {
@@ -58,6 +60,13 @@ bool BacklogRequester::buffer(BufferId bufferId, const MessageList &messages)
 }
 
 
+bool BacklogRequester::bufferComplete(BufferId bufferId)
+{
+    _buffersWaiting.remove(bufferId);
+    return !_buffersWaiting.isEmpty();
+}
+
+
 BufferIdList BacklogRequester::allBufferIds() const
 {
     QSet<BufferId> bufferIds = Client::bufferViewOverlay()->bufferIds();
@@ -66,6 +75,29 @@ BufferIdList BacklogRequester::allBufferIds() const
 }
 
 
+// The core answers requests in order, so requesting the visible buffer first gets it painted first
+BufferIdList BacklogRequester::currentBufferFirst(const BufferIdList &bufferIds) const
+{
+    BufferId currentBuffer = Client::bufferModel()->currentBuffer();
+    int pos = bufferIds.indexOf(currentBuffer);
+    if (pos <= 0)
+        return bufferIds;
+
+    BufferIdList result = bufferIds;
+    result.move(pos, 0);
+    return result;
+}
+
+
+void BacklogRequester::fetchBacklog(BufferId bufferId, MsgId first, MsgId last, int limit, int additional)
+{
+    if (backlogManager->isChunked())
+        backlogManager->requestBacklogChunked(0, bufferId, first, last, limit, additional);
+    else
+        backlogManager->requestBacklog(bufferId, first, last, limit, additional);
+}
+
+
 void BacklogRequester::flushBuffer()
 {
     if (!_buffersWaiting.isEmpty()) {
@@ -93,8 +125,8 @@ void FixedBacklogRequester::requestBacklog(const BufferIdList &bufferIds)
 {
     setWaitingBuffers(bufferIds);
     backlogManager->emitMessagesRequested(QObject::tr("Requesting a total of up to %1 backlog messages for %2 buffers").arg(_backlogCount * bufferIds.count()).arg(bufferIds.count()));
-    foreach(BufferId bufferId, bufferIds) {
-        backlogManager->requestBacklog(bufferId, -1, -1, _backlogCount);
+    foreach(BufferId bufferId, currentBufferFirst(bufferIds)) {
+        fetchBacklog(bufferId, -1, -1, _backlogCount);
     }
 }
 
@@ -140,7 +172,139 @@ void PerBufferUnreadBacklogRequester::requestBacklog(const BufferIdList &bufferI
 {
     setWaitingBuffers(bufferIds);
     backlogManager->emitMessagesRequested(QObject::tr("Requesting a total of up to %1 unread backlog messages for %2 buffers").arg((_limit + _additional) * bufferIds.count()).arg(bufferIds.count()));
+    foreach(BufferId bufferId, currentBufferFirst(bufferIds)) {
+        fetchBacklog(bufferId, Client::networkModel()->lastSeenMsgId(bufferId), -1, _limit, _additional);
+    }
+}
+
+
+// ========================================
+//  LAZY BACKLOG REQUESTER
+// ========================================
+static const int prefetchInterval = 100;     // ms between two prefetches
+static const int busyThreshold = 50;         // ms the prefetch timer may be late before we consider the client busy
+
+LazyBacklogRequester::LazyBacklogRequester(ClientBacklogManager *backlogManager)
+    : BacklogRequester(false, BacklogRequester::PerBufferLazy, backlogManager)
+{
+    BacklogSettings backlogSettings;
+    _limit = backlogSettings.perBufferUnreadBacklogLimit();
+    _additional = backlogSettings.perBufferUnreadBacklogAdditional();
+
+    _prefetchTimer.setSingleShot(true);
+    _prefetchTimer.setInterval(prefetchInterval);
+    connect(&_prefetchTimer, SIGNAL(timeout()), this, SLOT(prefetchNext()));
+    connect(backlogManager, SIGNAL(backlogComplete(BufferId)), this, SLOT(backlogComplete(BufferId)));
+}
+
+
+void LazyBacklogRequester::requestInitialBacklog()
+{
+    BufferIdList bufferIds = allBufferIds();
+    BufferId currentBuffer = Client::bufferModel()->currentBuffer();
+
+    BufferIdList initialBuffers;
     foreach(BufferId bufferId, bufferIds) {
-        backlogManager->requestBacklog(bufferId, Client::networkModel()->lastSeenMsgId(bufferId), -1, _limit, _additional);
+        BufferInfo::ActivityLevel activity = Client::networkModel()->bufferActivity(bufferId);
+        if (bufferId == currentBuffer || activity & BufferInfo::Highlight)
+            initialBuffers << bufferId;
+        else
+            _prefetchQueue << bufferId;
+    }
+
+    backlogManager->emitMessagesRequested(QObject::tr("Requesting unread backlog for %1 buffers, prefetching %2 more in the background").arg(initialBuffers.count()).arg(_prefetchQueue.count()));
+    foreach(BufferId bufferId, currentBufferFirst(initialBuffers)) {
+        fetch(bufferId);
+    }
+    schedulePrefetch();
+}
+
+
+// A single buffer is requested when a chat view is shown, which is what the user is waiting for. Larger sets
+// come from buffer views being added and can wait for the prefetcher, unless the current buffer is among them.
+void LazyBacklogRequester::requestBacklog(const BufferIdList &bufferIds)
+{
+    BufferId currentBuffer = Client::bufferModel()->currentBuffer();
+    foreach(BufferId bufferId, bufferIds) {
+        if (bufferIds.count() == 1 || bufferId == currentBuffer) {
+            _prefetchQueue.remove(bufferId);
+            fetch(bufferId);
+        }
+        else {
+            _prefetchQueue << bufferId;
+        }
+    }
+    schedulePrefetch();
+}
+
+
+void LazyBacklogRequester::fetch(BufferId bufferId)
+{
+    fetchBacklog(bufferId, Client::networkModel()->lastSeenMsgId(bufferId), -1, _limit, _additional);
+}
+
+
+void LazyBacklogRequester::backlogComplete(BufferId bufferId)
+{
+    if (bufferId != _prefetching)
+        return;
+
+    _prefetching = BufferId();
+    schedulePrefetch();
+}
+
+
+void LazyBacklogRequester::schedulePrefetch()
+{
+    // only one prefetch in flight at a time, so on-demand requests never queue up behind a pile of them
+    if (_prefetching.isValid() || _prefetchQueue.isEmpty() || _prefetchTimer.isActive())
+        return;
+
+    _prefetchScheduled.start();
+    _prefetchTimer.start();
+}
+
+
+void LazyBacklogRequester::prefetchNext()
+{
+    // a late timer means the event loop is busy, e.g. with processing backlog; try again later
+    if (_prefetchScheduled.elapsed() > prefetchInterval + busyThreshold) {
+        schedulePrefetch();
+        return;
+    }
+
+    BufferId bufferId = nextPrefetchBuffer();
+    if (!bufferId.isValid())
+        return;
+
+    _prefetchQueue.remove(bufferId);
+    if (!Client::networkModel()->bufferIndex(bufferId).isValid()) {
+        // buffer is gone
+        schedulePrefetch();
+        return;
+    }
+
+    _prefetching = bufferId;
+    fetch(bufferId);
+}
+
+
+// Highlighted buffers first, then the buffers most recently read in (which is what BufferSyncer tracks)
+BufferId LazyBacklogRequester::nextPrefetchBuffer() const
+{
+    BufferId best;
+    bool bestHighlighted = false;
+    MsgId bestLastSeen;
+    foreach(BufferId bufferId, _prefetchQueue) {
+        bool highlighted = Client::networkModel()->bufferActivity(bufferId) & BufferInfo::Highlight;
+        MsgId lastSeen = Client::networkModel()->lastSeenMsgId(bufferId);
+        if (!best.isValid()
+            || (highlighted && !bestHighlighted)
+            || (highlighted == bestHighlighted && lastSeen > bestLastSeen)) {
+            best = bufferId;
+            bestHighlighted = highlighted;
+            bestLastSeen = lastSeen;
+        }
     }
+    return best;
 }
@@ -21,7 +21,10 @@
 #ifndef BACKLOGREQUESTER_H
 #define BACKLOGREQUESTER_H
 
+#include <QElapsedTimer>
 #include <QList>
+#include <QObject>
+#include <QTimer>
 
 #include "client.h"
 #include "message.h"
@@ -37,7 +40,8 @@ public:
         InvalidRequester = 0,
         PerBufferFixed,
         PerBufferUnread,
-        GlobalUnread
+        GlobalUnread,
+        PerBufferLazy
     };
 
     BacklogRequester(bool buffering, RequesterType requesterType, ClientBacklogManager *backlogManger);
@@ -51,6 +55,7 @@ public:
     inline int totalBuffers() const { return _totalBuffers; }
 
     bool buffer(BufferId bufferId, const MessageList &messages); //! returns false if it was the last missing backlogpart
+    bool bufferComplete(BufferId bufferId); //! same as buffer(), for backlog that has been streamed and dispatched already
 
     virtual void requestBacklog(const BufferIdList &bufferIds) = 0;
     virtual inline void requestInitialBacklog() { requestBacklog(allBufferIds()); }
@@ -59,6 +64,8 @@ public:
 
 protected:
     BufferIdList allBufferIds() const;
+    BufferIdList currentBufferFirst(const BufferIdList &bufferIds) const;
+    void fetchBacklog(BufferId bufferId, MsgId first, MsgId last, int limit, int additional = 0);
     inline void setWaitingBuffers(const QList<BufferId> &buffers) { setWaitingBuffers(buffers.toSet()); }
     void setWaitingBuffers(const QSet<BufferId> &buffers);
     void addWaitingBuffer(BufferId buffer);
@@ -119,4 +126,39 @@ private:
 };
 
 
+// ========================================
+//  LAZY BACKLOG REQUESTER
+// ========================================
+//! Fetches unread backlog for the buffer being shown, and prefetches the rest while the client is idle
+/** Only the current buffer and buffers with highlights are requested at connect. The remaining buffers are
+ *  prefetched one at a time, most recently read first, and only when the event loop isn't busy. Buffers the
+ *  user switches to are fetched right away.
+ */
+class LazyBacklogRequester : public QObject, public BacklogRequester
+{
+    Q_OBJECT
+
+public:
+    LazyBacklogRequester(ClientBacklogManager *backlogManager);
+    virtual void requestInitialBacklog();
+    virtual void requestBacklog(const BufferIdList &bufferIds);
+
+private slots:
+    void backlogComplete(BufferId bufferId);
+    void prefetchNext();
+
+private:
+    void fetch(BufferId bufferId);
+    void schedulePrefetch();
+    BufferId nextPrefetchBuffer() const;
+
+    int _limit;
+    int _additional;
+    QSet<BufferId> _prefetchQueue;
+    BufferId _prefetching;
+    QTimer _prefetchTimer;
+    QElapsedTimer _prefetchScheduled;
+};
+
+
 #endif //BACKLOGREQUESTER_H
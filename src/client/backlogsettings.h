@@ -45,6 +45,12 @@ public:
     inline void setPerBufferUnreadBacklogLimit(int limit) { return setLocalValue("PerBufferUnreadBacklogLimit", limit); }
     inline int perBufferUnreadBacklogAdditional() { return localValue("PerBufferUnreadBacklogAdditional", 50).toInt(); }
     inline void setPerBufferUnreadBacklogAdditional(int Additional) { return setLocalValue("PerBufferUnreadBacklogAdditional", Additional); }
+
+    inline bool cacheEnabled() { return localValue("CacheEnabled", false).toBool(); }
+    inline void setCacheEnabled(bool enabled) { return setLocalValue("CacheEnabled", enabled); }
+    //! Maximum size of the on-disk backlog cache per core account, in MB
+    inline int cacheSize() { return localValue("CacheSize", 50).toInt(); }
+    inline void setCacheSize(int size) { return setLocalValue("CacheSize", size); }
 };
 
 
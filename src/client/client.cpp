@@ -410,6 +410,7 @@ void Client::setSyncedToCore()
     // create IgnoreListManager
     Q_ASSERT(!_ignoreListManager);
     _ignoreListManager = new ClientIgnoreListManager(this);
+    connect(ignoreListManager(), SIGNAL(ignoreListChanged()), _messageModel, SLOT(ignoreListChanged()));
     p->synchronize(ignoreListManager());
 
     Q_ASSERT(!_transferManager);
@@ -550,6 +551,7 @@ void Client::recvStatusMsg(QString /*net*/, QString /*msg*/)
 
 void Client::recvMessage(const Message &msg)
 {
+    backlogManager()->cacheMessage(msg);
     Message msg_ = msg;
     messageProcessor()->process(msg_);
 }
@@ -288,7 +288,12 @@ void ClientAuthHandler::startRegistration()
     useSsl = _account.useSsl();
 #endif
 
-    _peer->dispatch(RegisterClient(Quassel::buildInfo().fancyVersionString, Quassel::buildInfo().commitDate, useSsl));
+    // Lazy IrcUser synchronization trades completeness of the nick list for connect time, so it's opt-in
+    Quassel::Features features = Quassel::features();
+    if (!CoreConnectionSettings().lazyIrcUserSync())
+        features &= ~Quassel::LazyIrcUsers;
+
+    _peer->dispatch(RegisterClient(Quassel::buildInfo().fancyVersionString, Quassel::buildInfo().commitDate, useSsl, features));
 }
 
 
@@ -28,6 +28,7 @@
 #include <ctime>
 
 #include <QDebug>
+#include <QDir>
 
 INIT_SYNCABLE_OBJECT(ClientBacklogManager)
 ClientBacklogManager::ClientBacklogManager(QObject *parent)
@@ -41,14 +42,14 @@ ClientBacklogManager::ClientBacklogManager(QObject *parent)
 QVariantList ClientBacklogManager::requestBacklog(BufferId bufferId, MsgId first, MsgId last, int limit, int additional)
 {
     _buffersRequested << bufferId;
+    useCache(bufferId, first, last, limit, additional);
+    expectLiveMessages(bufferId, last);
     return BacklogManager::requestBacklog(bufferId, first, last, limit, additional);
 }
 
 
 void ClientBacklogManager::receiveBacklog(BufferId bufferId, MsgId first, MsgId last, int limit, int additional, QVariantList msgs)
 {
-    Q_UNUSED(first) Q_UNUSED(last) Q_UNUSED(limit) Q_UNUSED(additional)
-
     emit messagesReceived(bufferId, msgs.count());
 
     MessageList msglist;
@@ -58,6 +59,15 @@ void ClientBacklogManager::receiveBacklog(BufferId bufferId, MsgId first, MsgId
         msglist << msg;
     }
 
+    if (_cache.isOpen()) {
+        _cache.addMessages(msglist);
+        BacklogReply reply = backlogReply(first, last, limit, additional);
+        addToReply(reply, msglist);
+        markReplyComplete(bufferId, reply);
+    }
+    if (last == -1 && _cachedBacklog.contains(bufferId) && _cachedBacklog[bufferId].first == first)
+        mergeCachedBacklog(bufferId, msglist, true);
+
     if (isBuffering()) {
         bool lastPart = !_requester->buffer(bufferId, msglist);
         updateProgress(_requester->totalBuffers() - _requester->buffersWaiting(), _requester->totalBuffers());
@@ -69,6 +79,59 @@ void ClientBacklogManager::receiveBacklog(BufferId bufferId, MsgId first, MsgId
     else {
         dispatchMessages(msglist);
     }
+    emit backlogComplete(bufferId);
+}
+
+
+void ClientBacklogManager::requestBacklogChunked(PeerPtr peer, BufferId bufferId, MsgId first, MsgId last, int limit, int additional)
+{
+    _buffersRequested << bufferId;
+    useCache(bufferId, first, last, limit, additional);
+    expectLiveMessages(bufferId, last);
+    if (_cache.isOpen())
+        _pendingChunkedReplies[bufferId] << backlogReply(first, last, limit, additional);
+    BacklogManager::requestBacklogChunked(peer, bufferId, first, last, limit, additional);
+}
+
+
+// Chunks are dispatched right away, so the first messages show up long before a large backlog is complete
+void ClientBacklogManager::receiveBacklogChunk(PeerPtr, BufferId bufferId, QVariantList msgs, bool last)
+{
+    emit messagesReceived(bufferId, msgs.count());
+
+    MessageList msglist;
+    foreach(QVariant v, msgs) {
+        Message msg = v.value<Message>();
+        msg.setFlags(msg.flags() | Message::Backlog);
+        msglist << msg;
+    }
+
+    if (_cache.isOpen()) {
+        _cache.addMessages(msglist);
+        // replies for the same buffer arrive in the order we've requested them
+        QHash<BufferId, QList<BacklogReply> >::iterator replies = _pendingChunkedReplies.find(bufferId);
+        if (replies != _pendingChunkedReplies.end() && !replies->isEmpty()) {
+            addToReply(replies->first(), msglist);
+            if (last) {
+                markReplyComplete(bufferId, replies->takeFirst());
+                if (replies->isEmpty())
+                    _pendingChunkedReplies.erase(replies);
+            }
+        }
+    }
+    mergeCachedBacklog(bufferId, msglist, last);
+    dispatchMessages(msglist);
+
+    if (!last)
+        return;
+
+    if (_requester && _requester->totalBuffers()) {
+        bool lastPart = !_requester->bufferComplete(bufferId);
+        updateProgress(_requester->totalBuffers() - _requester->buffersWaiting(), _requester->totalBuffers());
+        if (lastPart)
+            _requester->flushBuffer();
+    }
+    emit backlogComplete(bufferId);
 }
 
 
@@ -83,6 +146,8 @@ void ClientBacklogManager::receiveBacklogAll(MsgId first, MsgId last, int limit,
         msglist << msg;
     }
 
+    if (_cache.isOpen())
+        _cache.addMessages(msglist);
     dispatchMessages(msglist);
 }
 
@@ -95,6 +160,8 @@ void ClientBacklogManager::requestInitialBacklog()
         return;
     }
 
+    openCache();
+
     BacklogSettings settings;
     switch (settings.requesterType()) {
     case BacklogRequester::GlobalUnread:
@@ -103,6 +170,9 @@ void ClientBacklogManager::requestInitialBacklog()
     case BacklogRequester::PerBufferUnread:
         _requester = new PerBufferUnreadBacklogRequester(this);
         break;
+    case BacklogRequester::PerBufferLazy:
+        _requester = new LazyBacklogRequester(this);
+        break;
     case BacklogRequester::PerBufferFixed:
     default:
         _requester = new FixedBacklogRequester(this);
@@ -110,7 +180,7 @@ void ClientBacklogManager::requestInitialBacklog()
 
     _requester->requestInitialBacklog();
     _initBacklogRequested = true;
-    if (_requester->isBuffering()) {
+    if (_requester->totalBuffers()) {
         updateProgress(0, _requester->totalBuffers());
     }
 }
@@ -156,6 +226,12 @@ void ClientBacklogManager::checkForBacklog(const QList<BufferId> &bufferIds)
 }
 
 
+bool ClientBacklogManager::isChunked() const
+{
+    return Client::coreFeatures() & Quassel::ChunkedBacklog;
+}
+
+
 bool ClientBacklogManager::isBuffering()
 {
     return _requester && _requester->isBuffering();
@@ -179,10 +255,170 @@ void ClientBacklogManager::dispatchMessages(const MessageList &messages, bool so
 }
 
 
+void ClientBacklogManager::openCache()
+{
+    BacklogSettings settings;
+    CoreAccount account = Client::currentCoreAccount();
+    if (!settings.cacheEnabled() || !account.isValid() || account.isInternal())
+        return;
+
+    QDir cacheDir(Quassel::configDirPath() + "backlogcache");
+    if (!cacheDir.exists() && !cacheDir.mkpath(".")) {
+        qWarning() << "Could not create backlog cache directory" << cacheDir.path();
+        return;
+    }
+    _cache.open(cacheDir.filePath(QString("%1.log").arg(account.accountId().toInt())), (qint64)settings.cacheSize() * 1024 * 1024);
+}
+
+
+// If we have cached messages for an initial backlog request, we only ask the core for what's newer than those.
+// The cached messages are held back until that has arrived, see mergeCachedBacklog().
+void ClientBacklogManager::useCache(BufferId bufferId, MsgId &first, MsgId last, int limit, int &additional)
+{
+    if (!_cache.isOpen() || last != -1)
+        return;
+
+    // the cache can't help if it doesn't have everything from first on
+    MsgId cachedFirst, cachedLast;
+    if (!_cache.completeTail(bufferId, &cachedFirst, &cachedLast) || first > cachedLast || (first != -1 && first < cachedFirst))
+        return;
+
+    CachedBacklog cached;
+    cached.messages = _cache.messages(bufferId, first, limit, additional);
+    MessageList::iterator msgIter = cached.messages.begin();
+    while (msgIter != cached.messages.end()) {
+        msgIter->setFlags(msgIter->flags() | Message::Backlog);
+        ++msgIter;
+    }
+
+    first = cachedLast.toInt() + 1;
+    additional = 0;
+    cached.first = first;
+    cached.limit = limit;
+    cached.received = 0;
+    _cachedBacklog[bufferId] = cached;
+}
+
+
+// If the core had more new messages than we asked for, there's a gap between those and the cached ones. In that
+// case we drop the cached messages rather than showing them.
+void ClientBacklogManager::mergeCachedBacklog(BufferId bufferId, MessageList &msglist, bool last)
+{
+    QHash<BufferId, CachedBacklog>::iterator cached = _cachedBacklog.find(bufferId);
+    if (cached == _cachedBacklog.end())
+        return;
+
+    cached->received += msglist.count();
+    foreach(const Message &msg, msglist) {
+        if (!cached->oldestReceived.isValid() || msg.msgId() < cached->oldestReceived)
+            cached->oldestReceived = msg.msgId();
+    }
+    if (!last)
+        return;
+
+    if (cached->limit < 0 || cached->received < cached->limit)
+        msglist << cached->messages;
+    else
+        _cache.dropOlderThan(bufferId, cached->oldestReceived);
+    _cachedBacklog.erase(cached);
+}
+
+
+ClientBacklogManager::BacklogReply ClientBacklogManager::backlogReply(MsgId first, MsgId last, int limit, int additional)
+{
+    BacklogReply reply;
+    reply.first = first;
+    reply.last = last;
+    reply.limit = limit;
+    reply.additional = additional;
+    reply.received = 0;
+    return reply;
+}
+
+
+void ClientBacklogManager::addToReply(BacklogReply &reply, const MessageList &msglist)
+{
+    reply.received += msglist.count();
+    foreach(const Message &msg, msglist) {
+        if (!reply.oldest.isValid() || msg.msgId() < reply.oldest)
+            reply.oldest = msg.msgId();
+        if (msg.msgId() > reply.newest)
+            reply.newest = msg.msgId();
+    }
+}
+
+
+// The core replies with one seamless run of messages, which also covers everything from first on unless
+// the limit has cut it off. A reply to a request up to the newest message (last == -1) also means that we
+// can cache the buffer's new messages from now on.
+void ClientBacklogManager::markReplyComplete(BufferId bufferId, const BacklogReply &reply)
+{
+    MsgId from = reply.oldest;
+    if (reply.first.isValid() && reply.additional == 0 && (reply.limit < 0 || reply.received < reply.limit))
+        from = reply.first;
+
+    if (reply.last.isValid()) {
+        if (from.isValid() && reply.received > 0)
+            _cache.markComplete(bufferId, from, reply.last.toInt() - 1);
+        return;
+    }
+
+    // Everything newer than what the core had when it got our request has reached us as a new message
+    // since, and has been cached while we were waiting for the reply; see cacheMessage().
+    MsgId newest = reply.newest;
+    if (_liveCachePending.contains(bufferId))
+        newest = qMax(newest, _liveCachePending.take(bufferId));
+    if (!from.isValid())
+        return; // nothing in there, and we don't know where the buffer begins
+
+    if (newest >= from)
+        _cache.markComplete(bufferId, from, newest);
+    if (!_liveCacheFrom.contains(bufferId) || from < _liveCacheFrom.value(bufferId))
+        _liveCacheFrom[bufferId] = from;
+}
+
+
+// New messages that arrive while we're waiting for a buffer's newest backlog are cached right away, as the reply
+// might not contain them. They only count as complete once the reply has arrived, see markReplyComplete().
+void ClientBacklogManager::expectLiveMessages(BufferId bufferId, MsgId last)
+{
+    if (!_cache.isOpen() || last.isValid() || _liveCacheFrom.contains(bufferId) || _liveCachePending.contains(bufferId))
+        return;
+
+    _liveCachePending.insert(bufferId, MsgId());
+}
+
+
+void ClientBacklogManager::cacheMessage(const Message &msg)
+{
+    if (!_cache.isOpen())
+        return;
+
+    QHash<BufferId, MsgId>::const_iterator from = _liveCacheFrom.constFind(msg.bufferId());
+    if (from != _liveCacheFrom.constEnd()) {
+        _cache.addMessage(msg);
+        _cache.markComplete(msg.bufferId(), *from, msg.msgId());
+        return;
+    }
+
+    QHash<BufferId, MsgId>::iterator pending = _liveCachePending.find(msg.bufferId());
+    if (pending != _liveCachePending.end()) {
+        _cache.addMessage(msg);
+        if (msg.msgId() > *pending)
+            *pending = msg.msgId();
+    }
+}
+
+
 void ClientBacklogManager::reset()
 {
     delete _requester;
     _requester = 0;
     _initBacklogRequested = false;
     _buffersRequested.clear();
+    _cache.close();
+    _cachedBacklog.clear();
+    _pendingChunkedReplies.clear();
+    _liveCacheFrom.clear();
+    _liveCachePending.clear();
 }
@@ -21,6 +21,7 @@
 #ifndef CLIENTBACKLOGMANAGER_H
 #define CLIENTBACKLOGMANAGER_H
 
+#include "backlogcache.h"
 #include "backlogmanager.h"
 #include "message.h"
 
@@ -39,10 +40,21 @@ public:
 
     void reset();
 
+    //! Whether backlog is streamed in chunks (\sa Quassel::ChunkedBacklog)
+    bool isChunked() const;
+
+    //! Adds a message that didn't come in as backlog to the local backlog cache, if that's enabled
+    /** Only messages of buffers whose newest backlog we've received or requested in this session are cached,
+     *  otherwise we'd cache them on top of a gap.
+     */
+    void cacheMessage(const Message &msg);
+
 public slots:
     virtual QVariantList requestBacklog(BufferId bufferId, MsgId first = -1, MsgId last = -1, int limit = -1, int additional = 0);
     virtual void receiveBacklog(BufferId bufferId, MsgId first, MsgId last, int limit, int additional, QVariantList msgs);
     virtual void receiveBacklogAll(MsgId first, MsgId last, int limit, int additional, QVariantList msgs);
+    virtual void requestBacklogChunked(PeerPtr peer, BufferId bufferId, MsgId first = -1, MsgId last = -1, int limit = -1, int additional = 0);
+    virtual void receiveBacklogChunk(PeerPtr peer, BufferId bufferId, QVariantList msgs, bool last);
 
     void requestInitialBacklog();
 
@@ -51,6 +63,7 @@ public slots:
 
 signals:
     void messagesReceived(BufferId bufferId, int count) const;
+    void backlogComplete(BufferId bufferId) const;
     void messagesRequested(const QString &) const;
     void messagesProcessed(const QString &) const;
 
@@ -62,9 +75,43 @@ private:
 
     void dispatchMessages(const MessageList &messages, bool sort = false);
 
+    void openCache();
+    void useCache(BufferId bufferId, MsgId &first, MsgId last, int limit, int &additional);
+    void mergeCachedBacklog(BufferId bufferId, MessageList &msglist, bool last);
+
+    //! A backlog request to the core, and what we've received for it so far
+    struct BacklogReply {
+        MsgId first;
+        MsgId last;
+        int limit;
+        int additional;
+        int received;
+        MsgId oldest;
+        MsgId newest;
+    };
+
+    static BacklogReply backlogReply(MsgId first, MsgId last, int limit, int additional);
+    static void addToReply(BacklogReply &reply, const MessageList &msglist);
+    void markReplyComplete(BufferId bufferId, const BacklogReply &reply);
+    void expectLiveMessages(BufferId bufferId, MsgId last);
+
+    //! Cached messages waiting for the core to send what's newer
+    struct CachedBacklog {
+        MsgId first;
+        int limit;
+        int received;
+        MsgId oldestReceived;
+        MessageList messages;
+    };
+
     BacklogRequester *_requester;
     bool _initBacklogRequested;
     QSet<BufferId> _buffersRequested;
+    BacklogCache _cache;
+    QHash<BufferId, CachedBacklog> _cachedBacklog;
+    QHash<BufferId, QList<BacklogReply> > _pendingChunkedReplies;
+    QHash<BufferId, MsgId> _liveCacheFrom; // buffers we cache new messages for, and since which MsgId they're complete
+    QHash<BufferId, MsgId> _liveCachePending; // buffers waiting for their newest backlog, and the newest message cached meanwhile
 };
 
 
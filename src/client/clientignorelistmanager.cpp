@@ -28,6 +28,29 @@ ClientIgnoreListManager::ClientIgnoreListManager(QObject *parent)
     : IgnoreListManager(parent)
 {
     connect(this, SIGNAL(updatedRemotely()), SIGNAL(ignoreListChanged()));
+    connect(this, SIGNAL(initDone()), SIGNAL(ignoreListChanged()));
+}
+
+
+void ClientIgnoreListManager::removeIgnoreListItem(const QString &ignoreRule)
+{
+    IgnoreListManager::removeIgnoreListItem(ignoreRule);
+    emit ignoreListChanged();
+}
+
+
+void ClientIgnoreListManager::toggleIgnoreRule(const QString &ignoreRule)
+{
+    IgnoreListManager::toggleIgnoreRule(ignoreRule);
+    emit ignoreListChanged();
+}
+
+
+void ClientIgnoreListManager::addIgnoreListItem(int type, const QString &ignoreRule, bool isRegEx, int strictness,
+    int scope, const QString &scopeRule, bool isActive)
+{
+    IgnoreListManager::addIgnoreListItem(type, ignoreRule, isRegEx, strictness, scope, scopeRule, isActive);
+    emit ignoreListChanged();
 }
 
 
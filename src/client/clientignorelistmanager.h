@@ -41,6 +41,12 @@ public:
       */
     QMap<QString, bool> matchingRulesForHostmask(const QString &hostmask, const QString &network, const QString &channel) const;
 
+    // Overridden to emit ignoreListChanged() for incremental updates from the core
+    virtual void removeIgnoreListItem(const QString &ignoreRule);
+    virtual void toggleIgnoreRule(const QString &ignoreRule);
+    virtual void addIgnoreListItem(int type, const QString &ignoreRule, bool isRegEx, int strictness,
+        int scope, const QString &scopeRule, bool isActive);
+
 signals:
     void ignoreListChanged();
 
@@ -292,6 +292,18 @@ int CoreConnectionSettings::reconnectInterval()
 }
 
 
+void CoreConnectionSettings::setLazyIrcUserSync(bool enabled)
+{
+    setLocalValue("LazyIrcUserSync", enabled);
+}
+
+
+bool CoreConnectionSettings::lazyIrcUserSync()
+{
+    return localValue("LazyIrcUserSync", false).toBool();
+}
+
+
 /***********************************************************************************************/
 // NotificationSettings:
 
@@ -142,6 +142,9 @@ public:
 
     void setReconnectInterval(int interval);
     int reconnectInterval();
+
+    void setLazyIrcUserSync(bool enabled);
+    bool lazyIrcUserSync();
 };
 
 
@@ -0,0 +1,188 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2016 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "messagebucketproxy.h"
+
+#include "messagemodel.h"
+
+MessageBucketProxy::MessageBucketProxy(MessageModel *source, const QSet<BufferId> &bufferIds, bool includeQuits, QObject *parent)
+    : QAbstractProxyModel(parent),
+    _messageModel(source),
+    _bufferIds(bufferIds),
+    _includeQuits(includeQuits)
+{
+    setSourceModel(source);
+    _sourceRows = source->bufferRows(_bufferIds, _includeQuits);
+
+    connect(source, SIGNAL(rowsInserted(const QModelIndex &, int, int)),
+        this, SLOT(sourceRowsInserted(const QModelIndex &, int, int)));
+    connect(source, SIGNAL(rowsAboutToBeRemoved(const QModelIndex &, int, int)),
+        this, SLOT(sourceRowsAboutToBeRemoved(const QModelIndex &, int, int)));
+    connect(source, SIGNAL(rowsRemoved(const QModelIndex &, int, int)),
+        this, SLOT(sourceRowsRemoved(const QModelIndex &, int, int)));
+    connect(source, SIGNAL(dataChanged(const QModelIndex &, const QModelIndex &)),
+        this, SLOT(sourceDataChanged(const QModelIndex &, const QModelIndex &)));
+    connect(source, SIGNAL(modelAboutToBeReset()), this, SLOT(sourceModelAboutToBeReset()));
+    connect(source, SIGNAL(modelReset()), this, SLOT(sourceModelReset()));
+}
+
+
+QModelIndex MessageBucketProxy::mapFromSource(const QModelIndex &sourceIndex) const
+{
+    if (!sourceIndex.isValid())
+        return QModelIndex();
+
+    int row = lowerBound(sourceIndex.row());
+    if (row == _sourceRows.count() || _sourceRows.at(row) != sourceIndex.row())
+        return QModelIndex();
+
+    return createIndex(row, sourceIndex.column());
+}
+
+
+QModelIndex MessageBucketProxy::mapToSource(const QModelIndex &proxyIndex) const
+{
+    if (!proxyIndex.isValid())
+        return QModelIndex();
+
+    return sourceModel()->index(_sourceRows.at(proxyIndex.row()), proxyIndex.column());
+}
+
+
+QModelIndex MessageBucketProxy::index(int row, int column, const QModelIndex &parent) const
+{
+    if (parent.isValid() || row < 0 || row >= _sourceRows.count() || column < 0 || column >= columnCount())
+        return QModelIndex();
+
+    return createIndex(row, column);
+}
+
+
+QModelIndex MessageBucketProxy::parent(const QModelIndex &index) const
+{
+    Q_UNUSED(index)
+    return QModelIndex();
+}
+
+
+int MessageBucketProxy::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : _sourceRows.count();
+}
+
+
+int MessageBucketProxy::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : sourceModel()->columnCount();
+}
+
+
+// The first of our rows that shows sourceRow or a later one
+int MessageBucketProxy::lowerBound(int sourceRow) const
+{
+    return qLowerBound(_sourceRows.constBegin(), _sourceRows.constEnd(), sourceRow) - _sourceRows.constBegin();
+}
+
+
+void MessageBucketProxy::sourceRowsInserted(const QModelIndex &parent, int start, int end)
+{
+    Q_UNUSED(parent)
+
+    // rows after the new ones move down; new messages usually arrive at the end, so this is mostly a no-op
+    int count = end - start + 1;
+    int first = lowerBound(start);
+    for (int i = first; i < _sourceRows.count(); i++)
+        _sourceRows[i] += count;
+
+    QVector<int> newRows;
+    for (int row = start; row <= end; row++) {
+        if (MessageModel::isBufferCandidate(_messageModel->messageItem(row), _bufferIds, _includeQuits))
+            newRows << row;
+    }
+    if (newRows.isEmpty())
+        return;
+
+    beginInsertRows(QModelIndex(), first, first + newRows.count() - 1);
+    _sourceRows.insert(first, newRows.count(), 0);
+    for (int i = 0; i < newRows.count(); i++)
+        _sourceRows[first + i] = newRows.at(i);
+    endInsertRows();
+}
+
+
+void MessageBucketProxy::sourceRowsAboutToBeRemoved(const QModelIndex &parent, int start, int end)
+{
+    Q_UNUSED(parent)
+
+    int first = lowerBound(start);
+    int last = lowerBound(end + 1);
+    if (first == last)
+        return;
+
+    beginRemoveRows(QModelIndex(), first, last - 1);
+    _sourceRows.remove(first, last - first);
+    endRemoveRows();
+}
+
+
+void MessageBucketProxy::sourceRowsRemoved(const QModelIndex &parent, int start, int end)
+{
+    Q_UNUSED(parent)
+
+    // our rows of the removed ones are gone already, the ones after them move up
+    int count = end - start + 1;
+    for (int i = lowerBound(start); i < _sourceRows.count(); i++)
+        _sourceRows[i] -= count;
+}
+
+
+void MessageBucketProxy::sourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
+{
+    int first = lowerBound(topLeft.row());
+    int last = lowerBound(bottomRight.row() + 1) - 1;
+    if (first <= last)
+        emit dataChanged(index(first, topLeft.column()), index(last, bottomRight.column()));
+
+    // messages can become candidates, e.g. when their buffer has been merged into one of ours
+    for (int row = topLeft.row(); row <= bottomRight.row(); row++) {
+        int proxyRow = lowerBound(row);
+        if (proxyRow < _sourceRows.count() && _sourceRows.at(proxyRow) == row)
+            continue;
+        if (!MessageModel::isBufferCandidate(_messageModel->messageItem(row), _bufferIds, _includeQuits))
+            continue;
+
+        beginInsertRows(QModelIndex(), proxyRow, proxyRow);
+        _sourceRows.insert(proxyRow, row);
+        endInsertRows();
+    }
+}
+
+
+void MessageBucketProxy::sourceModelAboutToBeReset()
+{
+    beginResetModel();
+}
+
+
+void MessageBucketProxy::sourceModelReset()
+{
+    _sourceRows = _messageModel->bufferRows(_bufferIds, _includeQuits);
+    endResetModel();
+}
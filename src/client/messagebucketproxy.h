@@ -0,0 +1,74 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2016 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#ifndef MESSAGEBUCKETPROXY_H_
+#define MESSAGEBUCKETPROXY_H_
+
+#include <QAbstractProxyModel>
+#include <QSet>
+#include <QVector>
+
+#include "types.h"
+
+class MessageModel;
+
+//! Shows only the rows of a MessageModel that may appear in a view of the given buffers
+/** The rows are looked up through the MessageModel's per-buffer indexes and kept up to date as rows come
+ *  and go, so filters on top of this only need to look at the candidate rows instead of the whole model.
+ *  \sa MessageModel::isBufferCandidate()
+ */
+class MessageBucketProxy : public QAbstractProxyModel
+{
+    Q_OBJECT
+
+public:
+    MessageBucketProxy(MessageModel *source, const QSet<BufferId> &bufferIds, bool includeQuits, QObject *parent = 0);
+
+    virtual QModelIndex mapFromSource(const QModelIndex &sourceIndex) const;
+    virtual QModelIndex mapToSource(const QModelIndex &proxyIndex) const;
+
+    virtual QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const;
+    virtual QModelIndex parent(const QModelIndex &index) const;
+
+    virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    virtual int columnCount(const QModelIndex &parent = QModelIndex()) const;
+
+    //! The MessageModel row shown in the given row
+    inline int sourceRow(int row) const { return _sourceRows.at(row); }
+
+private slots:
+    void sourceRowsInserted(const QModelIndex &parent, int start, int end);
+    void sourceRowsAboutToBeRemoved(const QModelIndex &parent, int start, int end);
+    void sourceRowsRemoved(const QModelIndex &parent, int start, int end);
+    void sourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+    void sourceModelAboutToBeReset();
+    void sourceModelReset();
+
+private:
+    int lowerBound(int sourceRow) const;
+
+    MessageModel *_messageModel;
+    QSet<BufferId> _bufferIds;
+    bool _includeQuits;
+    QVector<int> _sourceRows; // in ascending order
+};
+
+
+#endif
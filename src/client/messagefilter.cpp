@@ -29,6 +29,8 @@
 
 MessageFilter::MessageFilter(QAbstractItemModel *source, QObject *parent)
     : QSortFilterProxyModel(parent),
+    _messageModel(qobject_cast<MessageModel *>(source)),
+    _bucketProxy(0),
     _messageTypeFilter(0)
 {
     init();
@@ -38,11 +40,29 @@ MessageFilter::MessageFilter(QAbstractItemModel *source, QObject *parent)
 
 MessageFilter::MessageFilter(MessageModel *source, const QList<BufferId> &buffers, QObject *parent)
     : QSortFilterProxyModel(parent),
+    _messageModel(source),
+    _bucketProxy(0),
     _validBuffers(buffers.toSet()),
     _messageTypeFilter(0)
 {
     init();
-    setSourceModel(source);
+
+    // Only look at the messages that can possibly show up in our buffers, rather than at the whole model.
+    // Quits of other buffers are candidates only if we show a query.
+    if (!_validBuffers.isEmpty()) {
+        bool includeQuits = false;
+        foreach(BufferId id, _validBuffers) {
+            if (Client::networkModel()->bufferType(id) != BufferInfo::ChannelBuffer) {
+                includeQuits = true;
+                break;
+            }
+        }
+        _bucketProxy = new MessageBucketProxy(source, _validBuffers, includeQuits, this);
+        setSourceModel(_bucketProxy);
+    }
+    else {
+        setSourceModel(source);
+    }
 }
 
 
@@ -131,6 +151,20 @@ QString MessageFilter::idString() const
 bool MessageFilter::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
 {
     Q_UNUSED(sourceParent);
+
+    // Reject messages of foreign buffers as cheaply as possible, i.e. straight from the model item
+    // and without any further lookups. Only redirected messages and quits (for query buffers) can
+    // make it into a view of another buffer.
+    const MessageModelItem *item = sourceItem(sourceRow);
+    if (item && !_validBuffers.isEmpty()) {
+        if (_messageTypeFilter & item->msgType())
+            return false;
+        BufferId bufferId = item->bufferId();
+        if (bufferId.isValid() && !_validBuffers.contains(bufferId)
+            && !(item->msgFlags() & Message::Redirected) && !(item->msgType() & Message::Quit))
+            return false;
+    }
+
     QModelIndex sourceIdx = sourceModel()->index(sourceRow, 2);
     Message::Type messageType = (Message::Type)sourceIdx.data(MessageModel::TypeRole).toInt();
 
@@ -154,10 +188,7 @@ bool MessageFilter::filterAcceptsRow(int sourceRow, const QModelIndex &sourcePar
     if (myNetworkId != msgNetworkId)
         return false;
 
-    // ignorelist handling
-    // only match if message is not flagged as server msg
-    if (!(flags & Message::ServerMsg) && Client::ignoreListManager()
-        && Client::ignoreListManager()->match(sourceIdx.data(MessageModel::MessageRole).value<Message>(), Client::networkModel()->networkName(bufferId)))
+    if (isIgnored(sourceRow, sourceIdx))
         return false;
 
     if (flags & Message::Redirected) {
@@ -236,6 +267,19 @@ bool MessageFilter::filterAcceptsRow(int sourceRow, const QModelIndex &sourcePar
 }
 
 
+bool MessageFilter::isIgnored(int sourceRow, const QModelIndex &sourceIdx) const
+{
+    if (_messageModel)
+        return _messageModel->isIgnored(messageModelRow(sourceRow));
+
+    // only match if message is not flagged as server msg
+    Message::Flags flags = (Message::Flags)sourceIdx.data(MessageModel::FlagsRole).toInt();
+    BufferId bufferId = sourceIdx.data(MessageModel::BufferIdRole).value<BufferId>();
+    return !(flags & Message::ServerMsg) && Client::ignoreListManager()
+           && Client::ignoreListManager()->match(sourceIdx.data(MessageModel::MessageRole).value<Message>(), Client::networkModel()->networkName(bufferId));
+}
+
+
 void MessageFilter::requestBacklog()
 {
     QSet<BufferId>::const_iterator bufferIdIter = _validBuffers.constBegin();
@@ -25,6 +25,7 @@
 
 #include "bufferinfo.h"
 #include "client.h"
+#include "messagebucketproxy.h"
 #include "messagemodel.h"
 #include "networkmodel.h"
 #include "types.h"
@@ -58,9 +59,21 @@ protected:
     BufferInfo::Type bufferType() const { return Client::networkModel()->bufferType(singleBufferId()); }
     NetworkId networkId() const { return Client::networkModel()->networkId(singleBufferId()); }
 
+    //! Returns the source item for the given row, or 0 if the source isn't a MessageModel
+    inline const MessageModelItem *sourceItem(int sourceRow) const { return _messageModel ? _messageModel->messageItem(messageModelRow(sourceRow)) : 0; }
+
+    //! Maps a row of our source model to the MessageModel, in case we see it through a MessageBucketProxy
+    inline int messageModelRow(int sourceRow) const { return _bucketProxy ? _bucketProxy->sourceRow(sourceRow) : sourceRow; }
+
+    //! Checks the given source row against the ignore list, using the model's cached verdict if possible
+    bool isIgnored(int sourceRow, const QModelIndex &sourceIdx) const;
+
 private:
     void init();
 
+    MessageModel *_messageModel;
+    MessageBucketProxy *_bucketProxy; // only set if we show specific buffers
+
     QSet<BufferId> _validBuffers;
     QMultiHash<QString, uint> _filteredQuitMsgs;
     int _messageTypeFilter;
@@ -20,23 +20,20 @@
 
 #include "messagemodel.h"
 
-#include <QEvent>
-
 #include "backlogsettings.h"
 #include "clientbacklogmanager.h"
+#include "clientignorelistmanager.h"
 #include "client.h"
 #include "message.h"
 #include "networkmodel.h"
 
-class ProcessBufferEvent : public QEvent
-{
-public:
-    inline ProcessBufferEvent() : QEvent(QEvent::User) {}
-};
-
+// Number of rows we recheck against the ignore list per event loop iteration
+const int ignoreUpdateBatchSize = 1000;
 
 MessageModel::MessageModel(QObject *parent)
-    : QAbstractItemModel(parent)
+    : QAbstractItemModel(parent),
+    _ignoreGeneration(1),
+    _ignoreUpdateRow(0)
 {
     QDateTime now = QDateTime::currentDateTime();
     now.setTimeSpec(Qt::UTC);
@@ -46,6 +43,11 @@ MessageModel::MessageModel(QObject *parent)
     _dayChangeTimer.setInterval(QDateTime::currentDateTime().secsTo(_nextDayChange) * 1000);
     _dayChangeTimer.start();
     connect(&_dayChangeTimer, SIGNAL(timeout()), this, SLOT(changeOfDay()));
+
+    _ignoreUpdateTimer.setInterval(0);
+    connect(&_ignoreUpdateTimer, SIGNAL(timeout()), this, SLOT(updateIgnoreVerdicts()));
+    connect(this, SIGNAL(rowsInserted(const QModelIndex &, int, int)), this, SLOT(shiftIgnoreUpdateOnInsert(const QModelIndex &, int, int)));
+    connect(this, SIGNAL(rowsRemoved(const QModelIndex &, int, int)), this, SLOT(shiftIgnoreUpdateOnRemove(const QModelIndex &, int, int)));
 }
 
 
@@ -96,25 +98,57 @@ void MessageModel::insertMessages(const QList<Message> &msglist)
     if (msglist.isEmpty())
         return;
 
-    if (_messageBuffer.isEmpty()) {
-        int processedMsgs = insertMessagesGracefully(msglist);
-        int remainingMsgs = msglist.count() - processedMsgs;
-        if (remainingMsgs > 0) {
-            if (msglist.first().msgId() < msglist.last().msgId()) {
-                // in Order - we have just successfully processed "processedMsg" messages from the end of the list
-                _messageBuffer = msglist.mid(0, remainingMsgs);
-            }
-            else {
-                _messageBuffer = msglist.mid(processedMsgs);
+    QList<Message> sortedList = msglist;
+    qSort(sortedList);
+
+    // Merge the sorted batch with the existing messages in one pass: split it into runs that go
+    // into the same gap between existing messages (dropping dupes and adding day change markers
+    // on the way), so each run can be inserted with a single beginInsertRows().
+    QList<QList<Message> > runs;
+    QList<Message> run;
+    int runPos = -1;
+    MsgId lastId;
+    foreach(const Message &msg, sortedList) {
+        if (lastId.isValid() && msg.msgId() == lastId)
+            continue;
+        lastId = msg.msgId();
+
+        // as long as we're before the next existing message, we stay in the same gap
+        int pos = runPos;
+        if (runPos < 0 || (runPos < messageCount() && msg.msgId() >= messageItemAt(runPos)->msgId()))
+            pos = indexForId(msg.msgId());
+        if (pos < messageCount() && messageItemAt(pos)->msgId() == msg.msgId())
+            continue; // dupe
+
+        if (pos != runPos && !run.isEmpty()) {
+            runs << run;
+            run.clear();
+        }
+        runPos = pos;
+
+        if (!run.isEmpty()) {
+            QDateTime nextTs = msg.timestamp();
+            QDateTime prevTs = run.last().timestamp();
+            nextTs.setTimeSpec(Qt::UTC);
+            prevTs.setTimeSpec(Qt::UTC);
+            uint nextDay = nextTs.toTime_t() / 86400;
+            uint prevDay = prevTs.toTime_t() / 86400;
+            if (nextDay != prevDay) {
+                nextTs.setTime_t(nextDay * 86400);
+                nextTs.setTimeSpec(Qt::LocalTime);
+                Message dayChangeMsg = Message::ChangeOfDay(nextTs);
+                dayChangeMsg.setMsgId(run.last().msgId());
+                run << dayChangeMsg;
             }
-            qSort(_messageBuffer);
-            QCoreApplication::postEvent(this, new ProcessBufferEvent());
         }
+        run << msg;
     }
-    else {
-        _messageBuffer << msglist;
-        qSort(_messageBuffer);
-    }
+    if (!run.isEmpty())
+        runs << run;
+
+    // Insert from the back, so the gaps we determined above stay valid
+    for (int i = runs.count() - 1; i >= 0; i--)
+        insertMessageGroup(runs.at(i));
 }
 
 
@@ -175,8 +209,12 @@ void MessageModel::insertMessageGroup(const QList<Message> &msglist)
     Q_ASSERT(start == messageCount() || messageItemAt(start)->msgId() > msglist.last().msgId());
     beginInsertRows(QModelIndex(), start, end);
     insertMessages__(start, msglist);
-    if (dayChangeMsg.isValid())
+    if (dayChangeMsg.isValid()) {
         insertMessage__(start + msglist.count(), dayChangeMsg);
+        addToBufferIndex(dayChangeMsg);
+    }
+    foreach(const Message &msg, msglist)
+        addToBufferIndex(msg);
     endInsertRows();
 
     Q_ASSERT(start == end || messageItemAt(start)->msgId() != messageItemAt(end)->msgId() || messageItemAt(end)->msgType() == Message::DayChange);
@@ -185,160 +223,73 @@ void MessageModel::insertMessageGroup(const QList<Message> &msglist)
 }
 
 
-int MessageModel::insertMessagesGracefully(const QList<Message> &msglist)
+void MessageModel::clear()
 {
-    /* short description:
-     * 1) first we check where the message with the highest msgId from msglist would be inserted
-     * 2) check that position for dupe
-     * 3) determine the messageId of the preceeding msg
-     * 4) insert as many msgs from msglist with with msgId larger then the just determined id
-     *    those messages are automatically less then the msg of the position we just determined in 1)
-     */
-    bool inOrder = (msglist.first().msgId() < msglist.last().msgId());
-    // depending on the order we have to traverse from the front to the back or vice versa
-
-    QList<Message> grouplist;
-    MsgId minId;
-    MsgId dupeId;
-    int processedMsgs = 1; // we know the list isn't empty, so we at least process one message
-    int idx;
-    bool fastForward = false;
-    QList<Message>::const_iterator iter;
-    if (inOrder) {
-        iter = msglist.constEnd();
-        --iter; // this op is safe as we've allready passed an empty check
-    }
-    else {
-        iter = msglist.constBegin();
+    _messagesWaiting.clear();
+    _bufferIndex.clear();
+    _crossBufferIndex.clear();
+    if (rowCount() > 0) {
+        beginRemoveRows(QModelIndex(), 0, rowCount() - 1);
+        removeAllMessages();
+        endRemoveRows();
     }
+}
 
-    idx = indexForId((*iter).msgId());
-    if (idx < messageCount())
-        dupeId = messageItemAt(idx)->msgId();
 
-    // we always compare to the previous entry...
-    // if there isn't, we can fastforward to the top
-    if (idx - 1 >= 0)
-        minId = messageItemAt(idx - 1)->msgId();
-    else
-        fastForward = true;
-
-    if ((*iter).msgId() != dupeId) {
-        grouplist << *iter;
-        dupeId = (*iter).msgId();
+// DayChange and error messages borrow the msgId of their predecessor, so they don't go into the buffer's index.
+// Like every other message that may show up in views of other buffers, they go into the cross buffer index.
+void MessageModel::addToBufferIndex(const Message &msg)
+{
+    if (!msg.bufferInfo().bufferId().isValid() || msg.type() & (Message::DayChange | Message::Error | Message::Quit)
+        || msg.flags() & Message::Redirected) {
+        QList<MsgId>::iterator iter = qLowerBound(_crossBufferIndex.begin(), _crossBufferIndex.end(), msg.msgId());
+        if (iter == _crossBufferIndex.end() || *iter != msg.msgId())
+            _crossBufferIndex.insert(iter, msg.msgId());
     }
 
-    if (!inOrder)
-        ++iter;
-
-    if (inOrder) {
-        while (iter != msglist.constBegin()) {
-            --iter;
-
-            if (!fastForward && (*iter).msgId() <= minId)
-                break;
-            processedMsgs++;
-
-            if (grouplist.isEmpty()) { // as long as we don't have a starting point, we have to update the dupeId
-                idx = indexForId((*iter).msgId());
-                if (idx >= 0 && !messagesIsEmpty())
-                    dupeId = messageItemAt(idx)->msgId();
-            }
-            if ((*iter).msgId() != dupeId) {
-                if (!grouplist.isEmpty()) {
-                    QDateTime nextTs = grouplist.value(0).timestamp();
-                    QDateTime prevTs = (*iter).timestamp();
-                    nextTs.setTimeSpec(Qt::UTC);
-                    prevTs.setTimeSpec(Qt::UTC);
-                    uint nextDay = nextTs.toTime_t() / 86400;
-                    uint prevDay = prevTs.toTime_t() / 86400;
-                    if (nextDay != prevDay) {
-                        nextTs.setTime_t(nextDay * 86400);
-                        nextTs.setTimeSpec(Qt::LocalTime);
-                        Message dayChangeMsg = Message::ChangeOfDay(nextTs);
-                        dayChangeMsg.setMsgId((*iter).msgId());
-                        grouplist.prepend(dayChangeMsg);
-                    }
-                }
-                dupeId = (*iter).msgId();
-                grouplist.prepend(*iter);
-            }
-        }
-    }
-    else {
-        while (iter != msglist.constEnd()) {
-            if (!fastForward && (*iter).msgId() <= minId)
-                break;
-            processedMsgs++;
-
-            if (grouplist.isEmpty()) { // as long as we don't have a starting point, we have to update the dupeId
-                idx = indexForId((*iter).msgId());
-                if (idx >= 0 && !messagesIsEmpty())
-                    dupeId = messageItemAt(idx)->msgId();
-            }
-            if ((*iter).msgId() != dupeId) {
-                if (!grouplist.isEmpty()) {
-                    QDateTime nextTs = grouplist.value(0).timestamp();
-                    QDateTime prevTs = (*iter).timestamp();
-                    nextTs.setTimeSpec(Qt::UTC);
-                    prevTs.setTimeSpec(Qt::UTC);
-                    uint nextDay = nextTs.toTime_t() / 86400;
-                    uint prevDay = prevTs.toTime_t() / 86400;
-                    if (nextDay != prevDay) {
-                        nextTs.setTime_t(nextDay * 86400);
-                        nextTs.setTimeSpec(Qt::LocalTime);
-                        Message dayChangeMsg = Message::ChangeOfDay(nextTs);
-                        dayChangeMsg.setMsgId((*iter).msgId());
-                        grouplist.prepend(dayChangeMsg);
-                    }
-                }
-                dupeId = (*iter).msgId();
-                grouplist.prepend(*iter);
-            }
-            ++iter;
-        }
-    }
+    if (!msg.bufferInfo().bufferId().isValid() || msg.type() == Message::DayChange || msg.type() == Message::Error)
+        return;
 
-    if (!grouplist.isEmpty())
-        insertMessageGroup(grouplist);
-    return processedMsgs;
+    QList<MsgId> &ids = _bufferIndex[msg.bufferInfo().bufferId()];
+    if (ids.isEmpty() || ids.last() < msg.msgId())
+        ids.append(msg.msgId()); // the common case: new messages arriving at the end
+    else
+        ids.insert(qLowerBound(ids.begin(), ids.end(), msg.msgId()), msg.msgId());
 }
 
 
-void MessageModel::customEvent(QEvent *event)
+QVector<int> MessageModel::bufferRows(const QSet<BufferId> &bufferIds, bool includeQuits) const
 {
-    if (event->type() != QEvent::User)
-        return;
-
-    event->accept();
-
-    if (_messageBuffer.isEmpty())
-        return;
-
-    int processedMsgs = insertMessagesGracefully(_messageBuffer);
-    int remainingMsgs = _messageBuffer.count() - processedMsgs;
-
-    QList<Message>::iterator removeStart = _messageBuffer.begin() + remainingMsgs;
-    QList<Message>::iterator removeEnd = _messageBuffer.end();
-    _messageBuffer.erase(removeStart, removeEnd);
-    if (!_messageBuffer.isEmpty())
-        QCoreApplication::postEvent(this, new ProcessBufferEvent());
+    QList<MsgId> msgIds = _crossBufferIndex;
+    foreach(BufferId bufferId, bufferIds)
+        msgIds << _bufferIndex.value(bufferId);
+    qSort(msgIds);
+
+    // synthetic messages share their msgId with the preceding message, so we check all rows of each msgId
+    QVector<int> rows;
+    for (int i = 0; i < msgIds.count(); i++) {
+        MsgId msgId = msgIds.at(i);
+        if (i > 0 && msgId == msgIds.at(i - 1))
+            continue;
+        for (int row = indexForId(msgId); row < messageCount() && messageItemAt(row)->msgId() == msgId; row++) {
+            if (isBufferCandidate(messageItemAt(row), bufferIds, includeQuits))
+                rows << row;
+        }
+    }
+    return rows;
 }
 
 
-void MessageModel::clear()
+bool MessageModel::isBufferCandidate(const MessageModelItem *item, const QSet<BufferId> &bufferIds, bool includeQuits)
 {
-    _messagesWaiting.clear();
-    if (rowCount() > 0) {
-        beginRemoveRows(QModelIndex(), 0, rowCount() - 1);
-        removeAllMessages();
-        endRemoveRows();
-    }
+    BufferId bufferId = item->bufferId();
+    return !bufferId.isValid() || bufferIds.contains(bufferId) || item->msgFlags() & Message::Redirected
+           || (includeQuits && item->msgType() == Message::Quit);
 }
 
 
 // returns index of msg with given Id or of the next message after that (i.e., the index where we'd insert this msg)
-int MessageModel::indexForId(MsgId id)
+int MessageModel::indexForId(MsgId id) const
 {
     if (messagesIsEmpty() || id <= messageItemAt(0)->msgId())
         return 0;
@@ -370,6 +321,7 @@ void MessageModel::changeOfDay()
         Message dayChangeMsg = Message::ChangeOfDay(_nextDayChange);
         dayChangeMsg.setMsgId(messageItemAt(idx - 1)->msgId());
         insertMessage__(idx, dayChangeMsg);
+        addToBufferIndex(dayChangeMsg);
         endInsertRows();
     }
     _nextDayChange = _nextDayChange.addSecs(86400);
@@ -386,29 +338,108 @@ void MessageModel::insertErrorMessage(BufferInfo bufferInfo, const QString &erro
     else
         msg.setMsgId(0);
     insertMessage__(idx, msg);
+    addToBufferIndex(msg);
     endInsertRows();
 }
 
 
+// Checks the message against the ignore list, without looking at or touching the cached verdict
+static bool matchesIgnoreList(const MessageModelItem *item)
+{
+    // only match if message is not flagged as server msg
+    return !(item->msgFlags() & Message::ServerMsg) && Client::ignoreListManager()
+           && Client::ignoreListManager()->match(item->message(), Client::networkModel()->networkName(item->bufferId()));
+}
+
+
+bool MessageModel::isIgnored(int row) const
+{
+    const MessageModelItem *item = messageItemAt(row);
+    if (item->ignoreGeneration() == _ignoreGeneration)
+        return item->isIgnored();
+
+    // A verdict from before the ignore list changed is only replaced by updateIgnoreVerdicts(), which announces
+    // the rows it flips. Until it gets there, we answer without caching; otherwise it wouldn't see a change.
+    bool ignored = matchesIgnoreList(item);
+    if (!item->ignoreGeneration())
+        item->setIgnored(ignored, _ignoreGeneration);
+    return ignored;
+}
+
+
+void MessageModel::ignoreListChanged()
+{
+    // Invalidate all cached verdicts, and recompute them in batches so we don't block the UI
+    ++_ignoreGeneration;
+    _ignoreUpdateRow = 0;
+    _ignoreUpdateTimer.start();
+}
+
+
+void MessageModel::shiftIgnoreUpdateOnInsert(const QModelIndex &parent, int start, int end)
+{
+    Q_UNUSED(parent);
+    // New rows get their verdict on demand, we only have to keep our position in the old ones
+    if (_ignoreUpdateTimer.isActive() && start < _ignoreUpdateRow)
+        _ignoreUpdateRow += end - start + 1;
+}
+
+
+void MessageModel::shiftIgnoreUpdateOnRemove(const QModelIndex &parent, int start, int end)
+{
+    Q_UNUSED(parent);
+    if (_ignoreUpdateTimer.isActive() && start < _ignoreUpdateRow)
+        _ignoreUpdateRow -= qMin(end + 1, _ignoreUpdateRow) - start;
+}
+
+
+void MessageModel::updateIgnoreVerdicts()
+{
+    int end = qMin(_ignoreUpdateRow + ignoreUpdateBatchSize, messageCount());
+    int changedStart = -1;
+    for (int row = _ignoreUpdateRow; row < end; row++) {
+        const MessageModelItem *item = messageItemAt(row);
+        bool changed = false;
+        if (item->ignoreGeneration() != _ignoreGeneration) {
+            // rows without a verdict yet haven't been filtered by it either
+            bool ignored = matchesIgnoreList(item);
+            changed = item->ignoreGeneration() && ignored != item->isIgnored();
+            item->setIgnored(ignored, _ignoreGeneration);
+        }
+        if (changed && changedStart < 0)
+            changedStart = row;
+        else if (!changed && changedStart >= 0) {
+            emit dataChanged(index(changedStart, 0), index(row - 1, columnCount() - 1));
+            changedStart = -1;
+        }
+    }
+    if (changedStart >= 0)
+        emit dataChanged(index(changedStart, 0), index(end - 1, columnCount() - 1));
+
+    _ignoreUpdateRow = end;
+    if (_ignoreUpdateRow >= messageCount())
+        _ignoreUpdateTimer.stop();
+}
+
+
 void MessageModel::requestBacklog(BufferId bufferId)
 {
     if (_messagesWaiting.contains(bufferId))
         return;
 
+    QHash<BufferId, QList<MsgId> >::const_iterator ids = _bufferIndex.constFind(bufferId);
+    if (ids == _bufferIndex.constEnd() || ids->isEmpty())
+        return;
+
     BacklogSettings backlogSettings;
     int requestCount = backlogSettings.dynamicBacklogAmount();
 
-    for (int i = 0; i < messageCount(); i++) {
-        if (messageItemAt(i)->bufferId() == bufferId) {
-            _messagesWaiting[bufferId] = requestCount;
-            Client::backlogManager()->emitMessagesRequested(tr("Requesting %1 messages from backlog for buffer %2:%3")
-                .arg(requestCount)
-                .arg(Client::networkModel()->networkName(bufferId))
-                .arg(Client::networkModel()->bufferName(bufferId)));
-            Client::backlogManager()->requestBacklog(bufferId, -1, messageItemAt(i)->msgId(), requestCount);
-            return;
-        }
-    }
+    _messagesWaiting[bufferId] = requestCount;
+    Client::backlogManager()->emitMessagesRequested(tr("Requesting %1 messages from backlog for buffer %2:%3")
+        .arg(requestCount)
+        .arg(Client::networkModel()->networkName(bufferId))
+        .arg(Client::networkModel()->bufferName(bufferId)));
+    Client::backlogManager()->requestBacklog(bufferId, -1, ids->first(), requestCount);
 }
 
 
@@ -427,6 +458,14 @@ void MessageModel::messagesReceived(BufferId bufferId, int count)
 
 void MessageModel::buffersPermanentlyMerged(BufferId bufferId1, BufferId bufferId2)
 {
+    if (_bufferIndex.contains(bufferId2)) {
+        QList<MsgId> mergedIds = _bufferIndex.take(bufferId2);
+        QList<MsgId> &ids = _bufferIndex[bufferId1];
+        ids << mergedIds;
+        qSort(ids);
+    }
+
+    // Error messages aren't in the index, so we still need to look at every row here
     for (int i = 0; i < messageCount(); i++) {
         if (messageItemAt(i)->bufferId() == bufferId2) {
             messageItemAt(i)->setBufferId(bufferId1);
@@ -23,7 +23,9 @@
 
 #include <QAbstractItemModel>
 #include <QDateTime>
+#include <QSet>
 #include <QTimer>
+#include <QVector>
 
 #include "message.h"
 #include "types.h"
@@ -73,6 +75,32 @@ public:
 
     void clear();
 
+    //! Direct access to the item in the given row, for proxies that want to avoid the QVariant roles
+    inline const MessageModelItem *messageItem(int row) const { return messageItemAt(row); }
+
+    //! The ids of all (non-synthetic) messages of the given buffer, in ascending order
+    inline QList<MsgId> bufferMessageIds(BufferId bufferId) const { return _bufferIndex.value(bufferId); }
+    inline bool containsBuffer(BufferId bufferId) const { return _bufferIndex.contains(bufferId); }
+
+    //! The rows of all messages that may be shown in a view of the given buffers, in ascending order
+    /** These are found through the per-buffer indexes, so this doesn't need to look at every row.
+     *  \sa isBufferCandidate()
+     */
+    QVector<int> bufferRows(const QSet<BufferId> &bufferIds, bool includeQuits) const;
+
+    //! Whether the given message may be shown in a view of the given buffers
+    /** That's the case for their own messages, but also for redirected and synthetic (e.g. day change) ones,
+     *  and for quits if includeQuits is set. The view's filter has the final say.
+     */
+    static bool isBufferCandidate(const MessageModelItem *item, const QSet<BufferId> &bufferIds, bool includeQuits);
+
+    //! Checks if the message in the given row matches the ignore list
+    /** The verdict is cached in the item and only recomputed after the ignore list has changed.
+     *  Rows whose verdict changes are announced via dataChanged(), so dynamic proxies refilter them;
+     *  there's no need to invalidate them on ignore list changes.
+     */
+    bool isIgnored(int row) const;
+
 signals:
     void finishedBacklogFetch(BufferId bufferId);
 
@@ -81,6 +109,7 @@ public slots:
     void messagesReceived(BufferId bufferId, int count);
     void buffersPermanentlyMerged(BufferId bufferId1, BufferId bufferId2);
     void insertErrorMessage(BufferInfo bufferInfo, const QString &errorString);
+    void ignoreListChanged();
 
 protected:
 //   virtual MessageModelItem *createMessageModelItem(const Message &) = 0;
@@ -99,21 +128,31 @@ protected:
     virtual void removeAllMessages() = 0;
     virtual Message takeMessageAt(int i) = 0;
 
-    virtual void customEvent(QEvent *event);
-
 private slots:
     void changeOfDay();
+    void updateIgnoreVerdicts();
+    void shiftIgnoreUpdateOnInsert(const QModelIndex &parent, int start, int end);
+    void shiftIgnoreUpdateOnRemove(const QModelIndex &parent, int start, int end);
 
 private:
     void insertMessageGroup(const QList<Message> &);
-    int insertMessagesGracefully(const QList<Message> &); // inserts as many contiguous msgs as possible. returns numer of inserted msgs.
-    int indexForId(MsgId);
+    int indexForId(MsgId) const;
+
+    void addToBufferIndex(const Message &msg);
 
     //  QList<MessageModelItem *> _messageList;
-    QList<Message> _messageBuffer;
     QTimer _dayChangeTimer;
     QDateTime _nextDayChange;
     QHash<BufferId, int> _messagesWaiting;
+
+    // Per-buffer buckets of msgIds, so we don't have to walk the whole model for buffer-specific lookups
+    QHash<BufferId, QList<MsgId> > _bufferIndex;
+    // msgIds of the rows that may show up in views of other buffers, see isBufferCandidate()
+    QList<MsgId> _crossBufferIndex;
+
+    quint32 _ignoreGeneration;
+    int _ignoreUpdateRow; // next row to be rechecked after an ignore list change
+    QTimer _ignoreUpdateTimer;
 };
 
 
@@ -138,7 +177,7 @@ public:
      *  Subclasses need to provide Qt::DisplayRole at least, which should describe the plaintext
      *  strings without formattings (e.g. for searching purposes).
      */
-    MessageModelItem() {}
+    MessageModelItem() : _ignoreGeneration(0), _ignored(false) {}
     inline virtual ~MessageModelItem() {}
 
     virtual QVariant data(int column, int role) const;
@@ -158,8 +197,15 @@ public:
     bool operator>(const MessageModelItem &) const;
     static bool lessThan(const MessageModelItem *m1, const MessageModelItem *m2);
 
+    //! Cached ignore list verdict, see MessageModel::isIgnored()
+    inline quint32 ignoreGeneration() const { return _ignoreGeneration; }
+    inline bool isIgnored() const { return _ignored; }
+    inline void setIgnored(bool ignored, quint32 generation) const { _ignored = ignored; _ignoreGeneration = generation; }
+
 private:
     BufferId _redirectedTo;
+    mutable quint32 _ignoreGeneration;
+    mutable bool _ignored;
 };
 
 
@@ -87,22 +87,26 @@ QString NetworkItem::escapeHTML(const QString &string, bool useNonbreakingSpaces
 }
 
 
-// FIXME shouldn't we check the bufferItemCache here?
-BufferItem *NetworkItem::findBufferItem(BufferId bufferId)
+BufferItem *NetworkItem::findBufferItem(const QString &bufferName, Qt::CaseSensitivity cs) const
 {
-    BufferItem *bufferItem = 0;
-
-    for (int i = 0; i < childCount(); i++) {
-        bufferItem = qobject_cast<BufferItem *>(child(i));
-        if (!bufferItem)
-            continue;
-        if (bufferItem->bufferId() == bufferId)
-            return bufferItem;
+    QString key = bufferName.toLower();
+    QMultiHash<QString, BufferItem *>::const_iterator iter = _bufferItemsByName.constFind(key);
+    while (iter != _bufferItemsByName.constEnd() && iter.key() == key) {
+        if (cs == Qt::CaseInsensitive || iter.value()->bufferName() == bufferName)
+            return iter.value();
+        ++iter;
     }
     return 0;
 }
 
 
+void NetworkItem::bufferItemRenamed(BufferItem *bufferItem, const QString &oldName)
+{
+    _bufferItemsByName.remove(oldName.toLower(), bufferItem);
+    _bufferItemsByName.insert(bufferItem->bufferName().toLower(), bufferItem);
+}
+
+
 BufferItem *NetworkItem::bufferItem(const BufferInfo &bufferInfo)
 {
     BufferItem *bufferItem = findBufferItem(bufferInfo);
@@ -127,6 +131,8 @@ BufferItem *NetworkItem::bufferItem(const BufferInfo &bufferInfo)
         bufferItem = new BufferItem(bufferInfo, this);
     }
 
+    _bufferItems[bufferInfo.bufferId()] = bufferItem;
+    _bufferItemsByName.insert(bufferInfo.bufferName().toLower(), bufferItem);
     newChild(bufferItem);
 
     // postprocess... this is necessary because Qt doesn't seem to like adding children which already have children on their own
@@ -175,32 +181,30 @@ void NetworkItem::attachNetwork(Network *network)
 
 void NetworkItem::attachIrcChannel(IrcChannel *ircChannel)
 {
-    ChannelBufferItem *channelItem;
-    for (int i = 0; i < childCount(); i++) {
-        channelItem = qobject_cast<ChannelBufferItem *>(child(i));
-        if (!channelItem)
-            continue;
-
-        if (channelItem->bufferName().toLower() == ircChannel->name().toLower()) {
+    QString key = ircChannel->name().toLower();
+    QMultiHash<QString, BufferItem *>::const_iterator iter = _bufferItemsByName.constFind(key);
+    while (iter != _bufferItemsByName.constEnd() && iter.key() == key) {
+        ChannelBufferItem *channelItem = qobject_cast<ChannelBufferItem *>(iter.value());
+        if (channelItem) {
             channelItem->attachIrcChannel(ircChannel);
             return;
         }
+        ++iter;
     }
 }
 
 
 void NetworkItem::attachIrcUser(IrcUser *ircUser)
 {
-    QueryBufferItem *queryItem = 0;
-    for (int i = 0; i < childCount(); i++) {
-        queryItem = qobject_cast<QueryBufferItem *>(child(i));
-        if (!queryItem)
-            continue;
-
-        if (queryItem->bufferName().toLower() == ircUser->nick().toLower()) {
+    QString key = ircUser->nick().toLower();
+    QMultiHash<QString, BufferItem *>::const_iterator iter = _bufferItemsByName.constFind(key);
+    while (iter != _bufferItemsByName.constEnd() && iter.key() == key) {
+        QueryBufferItem *queryItem = qobject_cast<QueryBufferItem *>(iter.value());
+        if (queryItem) {
             queryItem->setIrcUser(ircUser);
-            break;
+            return;
         }
+        ++iter;
     }
 }
 
@@ -250,11 +254,14 @@ QString NetworkItem::toolTip(int column) const
 void NetworkItem::onBeginRemoveChilds(int start, int end)
 {
     for (int i = start; i <= end; i++) {
-        StatusBufferItem *statusBufferItem = qobject_cast<StatusBufferItem *>(child(i));
-        if (statusBufferItem) {
+        BufferItem *bufferItem = qobject_cast<BufferItem *>(child(i));
+        if (!bufferItem)
+            continue;
+
+        _bufferItems.remove(bufferItem->bufferId());
+        _bufferItemsByName.remove(bufferItem->bufferName().toLower(), bufferItem);
+        if (bufferItem == _statusBufferItem)
             _statusBufferItem = 0;
-            break;
-        }
     }
 }
 
@@ -302,21 +309,21 @@ void BufferItem::clearActivityLevel()
 }
 
 
-void BufferItem::updateActivityLevel(const Message &msg)
+bool BufferItem::updateActivityLevel(const Message &msg)
 {
     if (isCurrentBuffer()) {
-        return;
+        return false;
     }
 
     if (msg.flags() & Message::Self)    // don't update activity for our own messages
-        return;
+        return false;
 
     if (Client::ignoreListManager()
         && Client::ignoreListManager()->match(msg, qobject_cast<NetworkItem *>(parent())->networkName()))
-        return;
+        return false;
 
     if (msg.msgId() <= lastSeenMsgId())
-        return;
+        return false;
 
     bool stateChanged = false;
     if (!firstUnreadMsgId().isValid() || msg.msgId() < firstUnreadMsgId()) {
@@ -334,9 +341,7 @@ void BufferItem::updateActivityLevel(const Message &msg)
         _activity |= BufferInfo::Highlight;
 
     stateChanged |= (oldLevel != _activity);
-
-    if (stateChanged)
-        emit dataChanged();
+    return stateChanged;
 }
 
 
@@ -382,7 +387,12 @@ bool BufferItem::setData(int column, const QVariant &value, int role)
 
 void BufferItem::setBufferName(const QString &name)
 {
+    QString oldName = _bufferInfo.bufferName();
     _bufferInfo = BufferInfo(_bufferInfo.bufferId(), _bufferInfo.networkId(), _bufferInfo.type(), _bufferInfo.groupId(), name);
+
+    NetworkItem *netItem = qobject_cast<NetworkItem *>(parent());
+    if (netItem)
+        netItem->bufferItemRenamed(this, oldName);
     emit dataChanged(0);
 }
 
@@ -647,6 +657,9 @@ void QueryBufferItem::setIrcUser(IrcUser *ircUser)
         connect(ircUser, SIGNAL(quited()), this, SLOT(removeIrcUser()));
         connect(ircUser, SIGNAL(awaySet(bool)), this, SIGNAL(dataChanged()));
         connect(ircUser, SIGNAL(encryptedSet(bool)), this, SLOT(setEncrypted(bool)));
+        connect(ircUser, SIGNAL(initDone()), this, SIGNAL(dataChanged()));
+        // a query needs the full user info, even if the network's IrcUsers are synchronized lazily
+        ircUser->requestInit();
     }
 
     _ircUser = ircUser;
@@ -782,7 +795,7 @@ void ChannelBufferItem::ircChannelParted()
     disconnect(_ircChannel, 0, this, 0);
     _ircChannel = 0;
     emit dataChanged();
-    removeAllChilds();
+    removeAllUsers();
 }
 
 
@@ -791,11 +804,18 @@ void ChannelBufferItem::ircChannelDestroyed()
     if (_ircChannel) {
         _ircChannel = 0;
         emit dataChanged();
-        removeAllChilds();
+        removeAllUsers();
     }
 }
 
 
+void ChannelBufferItem::removeAllUsers()
+{
+    _userItems.clear();
+    removeAllChilds();
+}
+
+
 void ChannelBufferItem::join(const QList<IrcUser *> &ircUsers)
 {
     addUsersToCategory(ircUsers);
@@ -846,7 +866,9 @@ void ChannelBufferItem::addUsersToCategory(const QList<IrcUser *> &ircUsers)
 
     QHash<UserCategoryItem *, QList<IrcUser *> >::const_iterator catIter = categories.constBegin();
     while (catIter != categories.constEnd()) {
-        catIter.key()->addUsers(catIter.value());
+        foreach(IrcUserItem *userItem, catIter.key()->addUsers(catIter.value())) {
+            _userItems[userItem->ircUser()] = userItem;
+        }
         ++catIter;
     }
 }
@@ -874,15 +896,15 @@ void ChannelBufferItem::removeUserFromCategory(IrcUser *ircUser)
         return;
     }
 
-    UserCategoryItem *categoryItem = 0;
-    for (int i = 0; i < childCount(); i++) {
-        categoryItem = qobject_cast<UserCategoryItem *>(child(i));
-        if (categoryItem->removeUser(ircUser)) {
-            if (categoryItem->childCount() == 0)
-                removeChild(i);
-            break;
-        }
-    }
+    IrcUserItem *userItem = _userItems.take(ircUser);
+    if (!userItem)
+        return;
+
+    UserCategoryItem *categoryItem = qobject_cast<UserCategoryItem *>(userItem->parent());
+    Q_ASSERT(categoryItem);
+    categoryItem->removeUserItem(userItem);
+    if (categoryItem->childCount() == 0)
+        removeChild(categoryItem);
 }
 
 
@@ -890,11 +912,18 @@ void ChannelBufferItem::userModeChanged(IrcUser *ircUser)
 {
     Q_ASSERT(_ircChannel);
 
+    // find the item that needs reparenting
+    IrcUserItem *ircUserItem = _userItems.value(ircUser);
+    if (!ircUserItem) {
+        qWarning() << "ChannelBufferItem::userModeChanged(IrcUser *): unable to determine old category of" << ircUser;
+        return;
+    }
+
     int categoryId = UserCategoryItem::categoryFromModes(_ircChannel->userModes(ircUser));
     UserCategoryItem *categoryItem = findCategoryItem(categoryId);
 
     if (categoryItem) {
-        if (categoryItem->findIrcUser(ircUser)) {
+        if (ircUserItem->parent() == categoryItem) {
             return; // already in the right category;
         }
     }
@@ -903,22 +932,6 @@ void ChannelBufferItem::userModeChanged(IrcUser *ircUser)
         newChild(categoryItem);
     }
 
-    // find the item that needs reparenting
-    IrcUserItem *ircUserItem = 0;
-    for (int i = 0; i < childCount(); i++) {
-        UserCategoryItem *oldCategoryItem = qobject_cast<UserCategoryItem *>(child(i));
-        Q_ASSERT(oldCategoryItem);
-        IrcUserItem *userItem = oldCategoryItem->findIrcUser(ircUser);
-        if (userItem) {
-            ircUserItem = userItem;
-            break;
-        }
-    }
-
-    if (!ircUserItem) {
-        qWarning() << "ChannelBufferItem::userModeChanged(IrcUser *): unable to determine old category of" << ircUser;
-        return;
-    }
     ircUserItem->reParent(categoryItem);
 }
 
@@ -943,8 +956,13 @@ UserCategoryItem::UserCategoryItem(int category, AbstractTreeItem *parent)
 // caching this makes no sense, since we display the user number dynamically
 QString UserCategoryItem::categoryName() const
 {
-    int n = childCount();
-    switch (_category) {
+    return categoryName(_category, childCount());
+}
+
+
+QString UserCategoryItem::categoryName(int category, int n)
+{
+    switch (category) {
     case 0:
         return tr("%n Owner(s)", 0, n);
     case 1:
@@ -976,13 +994,18 @@ IrcUserItem *UserCategoryItem::findIrcUser(IrcUser *ircUser)
 }
 
 
-void UserCategoryItem::addUsers(const QList<IrcUser *> &ircUsers)
+QList<IrcUserItem *> UserCategoryItem::addUsers(const QList<IrcUser *> &ircUsers)
 {
-    QList<AbstractTreeItem *> userItems;
-    foreach(IrcUser *ircUser, ircUsers)
-    userItems << new IrcUserItem(ircUser, this);
-    newChilds(userItems);
+    QList<IrcUserItem *> userItems;
+    QList<AbstractTreeItem *> treeItems;
+    foreach(IrcUser *ircUser, ircUsers) {
+        IrcUserItem *userItem = new IrcUserItem(ircUser, this);
+        userItems << userItem;
+        treeItems << userItem;
+    }
+    newChilds(treeItems);
     emit dataChanged(0);
+    return userItems;
 }
 
 
@@ -990,14 +1013,19 @@ bool UserCategoryItem::removeUser(IrcUser *ircUser)
 {
     IrcUserItem *userItem = findIrcUser(ircUser);
     bool success = (bool)userItem;
-    if (success) {
-        removeChild(userItem);
-        emit dataChanged(0);
-    }
+    if (success)
+        removeUserItem(userItem);
     return success;
 }
 
 
+void UserCategoryItem::removeUserItem(IrcUserItem *userItem)
+{
+    removeChild(userItem);
+    emit dataChanged(0);
+}
+
+
 int UserCategoryItem::categoryFromModes(const QString &modes)
 {
     for (int i = 0; i < categories.count(); i++) {
@@ -1040,6 +1068,18 @@ IrcUserItem::IrcUserItem(IrcUser *ircUser, AbstractTreeItem *parent)
     connect(ircUser, SIGNAL(quited()), this, SLOT(ircUserQuited()));
     connect(ircUser, SIGNAL(nickSet(QString)), this, SIGNAL(dataChanged()));
     connect(ircUser, SIGNAL(awaySet(bool)), this, SIGNAL(dataChanged()));
+    connect(ircUser, SIGNAL(initDone()), this, SIGNAL(dataChanged()));
+}
+
+
+// Let the channel remove us, so it can keep its user index up to date
+void IrcUserItem::ircUserQuited()
+{
+    ChannelBufferItem *channelItem = qobject_cast<ChannelBufferItem *>(parent()->parent());
+    if (channelItem && _ircUser)
+        channelItem->removeUserFromCategory(_ircUser);
+    else
+        parent()->removeChild(this);
 }
 
 
@@ -1071,6 +1111,19 @@ QVariant IrcUserItem::data(int column, int role) const
 QString IrcUserItem::toolTip(int column) const
 {
     Q_UNUSED(column);
+
+    if (!_ircUser)
+        return QString();
+
+    return userToolTip(_ircUser, channelModes());
+}
+
+
+QString IrcUserItem::userToolTip(IrcUser *ircUser, const QString &channelModes)
+{
+    // With lazy synchronization, we only know the nick so far; the tooltip will be updated once the rest arrives
+    ircUser->requestInit();
+
     QString strTooltip;
     QTextStream tooltip( &strTooltip, QIODevice::WriteOnly );
     tooltip << "<qt><style>.bold { font-weight: bold; }</style>"
@@ -1080,10 +1133,10 @@ QString IrcUserItem::toolTip(int column) const
     bool infoAdded = false;
 
     // Use bufferName() for QueryBufferItem, nickName() for IrcUserItem
-    tooltip << "<p class='bold' align='center'>" << NetworkItem::escapeHTML(nickName(), true);
-    if (_ircUser->userModes() != "") {
+    tooltip << "<p class='bold' align='center'>" << NetworkItem::escapeHTML(ircUser->nick(), true);
+    if (ircUser->userModes() != "") {
         //TODO: Translate user Modes and add them to the table below and in QueryBufferItem::toolTip
-        tooltip << " (" << _ircUser->userModes() << ")";
+        tooltip << " (" << ircUser->userModes() << ")";
     }
     tooltip << "</p>";
 
@@ -1097,41 +1150,41 @@ QString IrcUserItem::toolTip(int column) const
 
     tooltip << "<table cellspacing='5' cellpadding='0'>";
     addRow(tr("Modes"),
-           NetworkItem::escapeHTML(channelModes()),
-           !channelModes().isEmpty());
-    if (_ircUser->isAway()) {
+           NetworkItem::escapeHTML(channelModes),
+           !channelModes.isEmpty());
+    if (ircUser->isAway()) {
         QString awayMessage(tr("(unknown)"));
-        if(!_ircUser->awayMessage().isEmpty()) {
-            awayMessage = _ircUser->awayMessage();
+        if(!ircUser->awayMessage().isEmpty()) {
+            awayMessage = ircUser->awayMessage();
         }
         addRow(NetworkItem::escapeHTML(tr("Away message"), true), NetworkItem::escapeHTML(awayMessage), true);
     }
     addRow(tr("Realname"),
-           NetworkItem::escapeHTML(_ircUser->realName()),
-           !_ircUser->realName().isEmpty());
+           NetworkItem::escapeHTML(ircUser->realName()),
+           !ircUser->realName().isEmpty());
 
     // suserHost may return "<nick> is available for help", which should be translated.
     // See https://www.alien.net.au/irc/irc2numerics.html
-    if(_ircUser->suserHost().endsWith("available for help")) {
+    if(ircUser->suserHost().endsWith("available for help")) {
         addRow(NetworkItem::escapeHTML(tr("Help status"), true),
                NetworkItem::escapeHTML(tr("Available for help")),
                true);
     } else {
         addRow(NetworkItem::escapeHTML(tr("Service status"), true),
-               NetworkItem::escapeHTML(_ircUser->suserHost()),
-               !_ircUser->suserHost().isEmpty());
+               NetworkItem::escapeHTML(ircUser->suserHost()),
+               !ircUser->suserHost().isEmpty());
     }
 
     // Keep track of whether or not the account information's been added.  Don't show it twice.
     bool accountAdded = false;
-    if(!_ircUser->account().isEmpty()) {
+    if(!ircUser->account().isEmpty()) {
         // IRCv3 account-notify is supported by the core and IRC server.
         // Assume logged out (seems to be more common)
         QString accountHTML = QString("<p class='italic'>%1</p>").arg(tr("Not logged in"));
 
         // If account is logged in, replace with the escaped account name.
-        if (_ircUser->account() != "*") {
-            accountHTML = NetworkItem::escapeHTML(_ircUser->account());
+        if (ircUser->account() != "*") {
+            accountHTML = NetworkItem::escapeHTML(ircUser->account());
         }
         addRow(NetworkItem::escapeHTML(tr("Account"), true),
                accountHTML,
@@ -1141,7 +1194,7 @@ QString IrcUserItem::toolTip(int column) const
     }
     // whoisServiceReply may return "<nick> is identified for this nick", which should be translated.
     // See https://www.alien.net.au/irc/irc2numerics.html
-    if(_ircUser->whoisServiceReply().endsWith("identified for this nick")) {
+    if(ircUser->whoisServiceReply().endsWith("identified for this nick")) {
         addRow(NetworkItem::escapeHTML(tr("Account"), true),
                NetworkItem::escapeHTML(tr("Identified for this nick")),
                !accountAdded);
@@ -1150,29 +1203,29 @@ QString IrcUserItem::toolTip(int column) const
         accountAdded = true;
     } else {
         addRow(NetworkItem::escapeHTML(tr("Service Reply"), true),
-               NetworkItem::escapeHTML(_ircUser->whoisServiceReply()),
-               !_ircUser->whoisServiceReply().isEmpty());
+               NetworkItem::escapeHTML(ircUser->whoisServiceReply()),
+               !ircUser->whoisServiceReply().isEmpty());
     }
     addRow(tr("Hostmask"),
-           NetworkItem::escapeHTML(_ircUser->hostmask().remove(0, _ircUser->hostmask().indexOf("!") + 1)),
-           !(_ircUser->hostmask().remove(0, _ircUser->hostmask().indexOf("!") + 1) == "@"));
+           NetworkItem::escapeHTML(ircUser->hostmask().remove(0, ircUser->hostmask().indexOf("!") + 1)),
+           !(ircUser->hostmask().remove(0, ircUser->hostmask().indexOf("!") + 1) == "@"));
     // ircOperator may contain "is an" or "is a", which should be removed.
     addRow(tr("Operator"),
-           NetworkItem::escapeHTML(_ircUser->ircOperator().replace("is an ", "").replace("is a ", "")),
-           !_ircUser->ircOperator().isEmpty());
+           NetworkItem::escapeHTML(ircUser->ircOperator().replace("is an ", "").replace("is a ", "")),
+           !ircUser->ircOperator().isEmpty());
 
-    if (_ircUser->idleTime().isValid()) {
+    if (ircUser->idleTime().isValid()) {
         QDateTime now = QDateTime::currentDateTime();
-        QDateTime idle = _ircUser->idleTime();
+        QDateTime idle = ircUser->idleTime();
         int idleTime = idle.secsTo(now);
         addRow(NetworkItem::escapeHTML(tr("Idling since"), true), secondsToString(idleTime), true);
     }
 
-    if (_ircUser->loginTime().isValid()) {
-        addRow(NetworkItem::escapeHTML(tr("Login time"), true), _ircUser->loginTime().toString(), true);
+    if (ircUser->loginTime().isValid()) {
+        addRow(NetworkItem::escapeHTML(tr("Login time"), true), ircUser->loginTime().toString(), true);
     }
 
-    addRow(tr("Server"), NetworkItem::escapeHTML(_ircUser->server()), !_ircUser->server().isEmpty());
+    addRow(tr("Server"), NetworkItem::escapeHTML(ircUser->server()), !ircUser->server().isEmpty());
     tooltip << "</table>";
 
     // If no further information found, offer an explanatory message
@@ -1215,6 +1268,10 @@ NetworkModel::NetworkModel(QObject *parent)
     defaultSettings.notify("ServerNoticesTarget", this, SLOT(messageRedirectionSettingsChanged()));
     defaultSettings.notify("ErrorMsgsTarget", this, SLOT(messageRedirectionSettingsChanged()));
     messageRedirectionSettingsChanged();
+
+    _activityTimer.setSingleShot(true);
+    _activityTimer.setInterval(16);
+    connect(&_activityTimer, SIGNAL(timeout()), this, SLOT(emitActivityChanges()));
 }
 
 
@@ -1289,26 +1346,25 @@ void NetworkModel::networkRemoved(const NetworkId &networkId)
 
 QModelIndex NetworkModel::bufferIndex(BufferId bufferId)
 {
-    if (!_bufferItemCache.contains(bufferId))
+    BufferItem *bufferItem = findBufferItem(bufferId);
+    if (!bufferItem)
         return QModelIndex();
 
-    return indexByItem(_bufferItemCache[bufferId]);
+    return indexByItem(bufferItem);
 }
 
 
 BufferItem *NetworkModel::findBufferItem(BufferId bufferId) const
 {
-    if (_bufferItemCache.contains(bufferId))
-        return _bufferItemCache[bufferId];
-    else
-        return 0;
+    return _bufferItemCache.value(bufferId);
 }
 
 
 BufferItem *NetworkModel::bufferItem(const BufferInfo &bufferInfo)
 {
-    if (_bufferItemCache.contains(bufferInfo.bufferId()))
-        return _bufferItemCache[bufferInfo.bufferId()];
+    BufferItem *cachedItem = findBufferItem(bufferInfo.bufferId());
+    if (cachedItem)
+        return cachedItem;
 
     NetworkItem *netItem = networkItem(bufferInfo.networkId());
     return netItem->bufferItem(bufferInfo);
@@ -1400,19 +1456,31 @@ void NetworkModel::removeBuffer(BufferId bufferId)
 
 MsgId NetworkModel::lastSeenMsgId(BufferId bufferId) const
 {
-    if (!_bufferItemCache.contains(bufferId))
+    BufferItem *bufferItem = findBufferItem(bufferId);
+    if (!bufferItem)
         return MsgId();
 
-    return _bufferItemCache[bufferId]->lastSeenMsgId();
+    return bufferItem->lastSeenMsgId();
+}
+
+
+BufferInfo::ActivityLevel NetworkModel::bufferActivity(BufferId bufferId) const
+{
+    BufferItem *bufferItem = findBufferItem(bufferId);
+    if (!bufferItem)
+        return BufferInfo::NoActivity;
+
+    return bufferItem->activityLevel();
 }
 
 
 MsgId NetworkModel::markerLineMsgId(BufferId bufferId) const
 {
-    if (!_bufferItemCache.contains(bufferId))
+    BufferItem *bufferItem = findBufferItem(bufferId);
+    if (!bufferItem)
         return MsgId();
 
-    return _bufferItemCache[bufferId]->markerLineMsgId();
+    return bufferItem->markerLineMsgId();
 }
 
 
@@ -1512,12 +1580,30 @@ void NetworkModel::updateBufferActivity(BufferItem *bufferItem, const Message &m
     if (!bufferItem)
         return;
 
-    bufferItem->updateActivityLevel(msg);
+    if (bufferItem->updateActivityLevel(msg)) {
+        // the item's data is up to date already, we just announce it later on
+        _pendingActivityChanges.insert(bufferItem->bufferId());
+        if (!_activityTimer.isActive())
+            _activityTimer.start();
+    }
     if (bufferItem->isCurrentBuffer())
         emit requestSetLastSeenMsg(bufferItem->bufferId(), msg.msgId());
 }
 
 
+void NetworkModel::emitActivityChanges()
+{
+    // buffers might have been removed in the meantime, so we look them up again
+    QSet<BufferId> bufferIds = _pendingActivityChanges;
+    _pendingActivityChanges.clear();
+    foreach(BufferId bufferId, bufferIds) {
+        BufferItem *bufferItem = findBufferItem(bufferId);
+        if (bufferItem)
+            bufferItem->notifyActivityChanged();
+    }
+}
+
+
 void NetworkModel::setBufferActivity(const BufferId &bufferId, BufferInfo::ActivityLevel level)
 {
     BufferItem *bufferItem = findBufferItem(bufferId);
@@ -1576,37 +1662,41 @@ void NetworkModel::checkForNewBuffers(const QModelIndex &parent, int start, int
 
 QString NetworkModel::bufferName(BufferId bufferId) const
 {
-    if (!_bufferItemCache.contains(bufferId))
+    BufferItem *bufferItem = findBufferItem(bufferId);
+    if (!bufferItem)
         return QString();
 
-    return _bufferItemCache[bufferId]->bufferName();
+    return bufferItem->bufferName();
 }
 
 
 BufferInfo::Type NetworkModel::bufferType(BufferId bufferId) const
 {
-    if (!_bufferItemCache.contains(bufferId))
+    BufferItem *bufferItem = findBufferItem(bufferId);
+    if (!bufferItem)
         return BufferInfo::InvalidBuffer;
 
-    return _bufferItemCache[bufferId]->bufferType();
+    return bufferItem->bufferType();
 }
 
 
 BufferInfo NetworkModel::bufferInfo(BufferId bufferId) const
 {
-    if (!_bufferItemCache.contains(bufferId))
+    BufferItem *bufferItem = findBufferItem(bufferId);
+    if (!bufferItem)
         return BufferInfo();
 
-    return _bufferItemCache[bufferId]->bufferInfo();
+    return bufferItem->bufferInfo();
 }
 
 
 NetworkId NetworkModel::networkId(BufferId bufferId) const
 {
-    if (!_bufferItemCache.contains(bufferId))
+    BufferItem *bufferItem = findBufferItem(bufferId);
+    if (!bufferItem)
         return NetworkId();
 
-    NetworkItem *netItem = qobject_cast<NetworkItem *>(_bufferItemCache[bufferId]->parent());
+    NetworkItem *netItem = qobject_cast<NetworkItem *>(bufferItem->parent());
     if (netItem)
         return netItem->networkId();
     else
@@ -1616,10 +1706,11 @@ NetworkId NetworkModel::networkId(BufferId bufferId) const
 
 QString NetworkModel::networkName(BufferId bufferId) const
 {
-    if (!_bufferItemCache.contains(bufferId))
+    BufferItem *bufferItem = findBufferItem(bufferId);
+    if (!bufferItem)
         return QString();
 
-    NetworkItem *netItem = qobject_cast<NetworkItem *>(_bufferItemCache[bufferId]->parent());
+    NetworkItem *netItem = qobject_cast<NetworkItem *>(bufferItem->parent());
     if (netItem)
         return netItem->networkName();
     else
@@ -1633,12 +1724,8 @@ BufferId NetworkModel::bufferId(NetworkId networkId, const QString &bufferName,
     if (!netItem)
         return BufferId();
 
-    for (int i = 0; i < netItem->childCount(); i++) {
-        BufferItem *bufferItem = qobject_cast<BufferItem *>(netItem->child(i));
-        if (bufferItem && !bufferItem->bufferName().compare(bufferName, cs))
-            return bufferItem->bufferId();
-    }
-    return BufferId();
+    BufferItem *bufferItem = netItem->findBufferItem(bufferName, cs);
+    return bufferItem ? bufferItem->bufferId() : BufferId();
 }
 
 
@@ -1646,8 +1733,9 @@ void NetworkModel::sortBufferIds(QList<BufferId> &bufferIds) const
 {
     QList<BufferItem *> bufferItems;
     foreach(BufferId bufferId, bufferIds) {
-        if (_bufferItemCache.contains(bufferId))
-            bufferItems << _bufferItemCache[bufferId];
+        BufferItem *bufferItem = findBufferItem(bufferId);
+        if (bufferItem)
+            bufferItems << bufferItem;
     }
 
     qSort(bufferItems.begin(), bufferItems.end(), bufferItemLessThan);
@@ -21,6 +21,9 @@
 #ifndef NETWORKMODEL_H
 #define NETWORKMODEL_H
 
+#include <QSet>
+#include <QTimer>
+
 #include "bufferinfo.h"
 #include "clientsettings.h"
 #include "message.h"
@@ -67,9 +70,13 @@ public :
 
     virtual QString toolTip(int column) const;
 
-    BufferItem *findBufferItem(BufferId bufferId);
-    inline BufferItem *findBufferItem(const BufferInfo &bufferInfo) { return findBufferItem(bufferInfo.bufferId()); }
+    inline BufferItem *findBufferItem(BufferId bufferId) const { return _bufferItems.value(bufferId); }
+    inline BufferItem *findBufferItem(const BufferInfo &bufferInfo) const { return findBufferItem(bufferInfo.bufferId()); }
+    BufferItem *findBufferItem(const QString &bufferName, Qt::CaseSensitivity cs = Qt::CaseInsensitive) const;
     BufferItem *bufferItem(const BufferInfo &bufferInfo);
+
+    //! Keeps the name index up to date, called by our BufferItems
+    void bufferItemRenamed(BufferItem *bufferItem, const QString &oldName);
     inline StatusBufferItem *statusBufferItem() const { return _statusBufferItem; }
 
 public slots:
@@ -92,6 +99,9 @@ private:
     StatusBufferItem *_statusBufferItem;
 
     QPointer<Network> _network;
+
+    QHash<BufferId, BufferItem *> _bufferItems;
+    QMultiHash<QString, BufferItem *> _bufferItemsByName; // keyed by lower case name
 };
 
 
@@ -130,7 +140,10 @@ public :
     inline BufferInfo::ActivityLevel activityLevel() const { return _activity; }
     void setActivityLevel(BufferInfo::ActivityLevel level);
     void clearActivityLevel();
-    void updateActivityLevel(const Message &msg);
+    //! Updates the activity for a new message. Returns true if that changed anything; doesn't emit dataChanged() itself.
+    bool updateActivityLevel(const Message &msg);
+    //! Emits dataChanged() for an earlier updateActivityLevel(), see NetworkModel::emitActivityChanges()
+    inline void notifyActivityChanged() { emit dataChanged(); }
 
     inline const MsgId &firstUnreadMsgId() const { return _firstUnreadMsgId; }
 
@@ -196,6 +209,7 @@ private:
 *  ChannelBufferItem
 *****************************************/
 class UserCategoryItem;
+class IrcUserItem;
 
 class ChannelBufferItem : public BufferItem
 {
@@ -236,14 +250,16 @@ private slots:
     void ircChannelDestroyed();
 
 private:
+    void removeAllUsers();
+
     IrcChannel *_ircChannel;
+    QHash<IrcUser *, IrcUserItem *> _userItems;
 };
 
 
 /*****************************************
 *  User Category Items (like @vh etc.)
 *****************************************/
-class IrcUserItem;
 class UserCategoryItem : public PropertyMapItem
 {
     Q_OBJECT
@@ -253,12 +269,14 @@ public :
         UserCategoryItem(int category, AbstractTreeItem *parent);
 
     QString categoryName() const;
+    static QString categoryName(int category, int userCount);
     inline int categoryId() const { return _category; }
     virtual QVariant data(int column, int role) const;
 
     IrcUserItem *findIrcUser(IrcUser *ircUser);
-    void addUsers(const QList<IrcUser *> &ircUser);
+    QList<IrcUserItem *> addUsers(const QList<IrcUser *> &ircUser);
     bool removeUser(IrcUser *ircUser);
+    void removeUserItem(IrcUserItem *userItem);
 
     static int categoryFromModes(const QString &modes);
 
@@ -287,6 +305,9 @@ public :
     virtual QVariant data(int column, int role) const;
     virtual QString toolTip(int column) const;
 
+    //! Builds the tooltip shown for a user in a channel with the given channel modes
+    static QString userToolTip(IrcUser *ircUser, const QString &channelModes);
+
     /**
      * Gets the list of channel modes for this nick if parented to channel.
      *
@@ -295,7 +316,7 @@ public :
     QString channelModes() const;
 
 private slots:
-    inline void ircUserQuited() { parent()->removeChild(this); }
+    void ircUserQuited();
 
 private:
     QPointer<IrcUser> _ircUser;
@@ -351,7 +372,7 @@ public:
 
     const Network *networkByIndex(const QModelIndex &index) const;
 
-    BufferInfo::ActivityLevel bufferActivity(const BufferInfo &buffer) const;
+    BufferInfo::ActivityLevel bufferActivity(BufferId bufferId) const;
 
     //! Finds a buffer with a given name in a given network
     /** This performs a linear search through all BufferItems, hence it is expensive.
@@ -393,6 +414,7 @@ private slots:
     void checkForRemovedBuffers(const QModelIndex &parent, int start, int end);
     void checkForNewBuffers(const QModelIndex &parent, int start, int end);
     void messageRedirectionSettingsChanged();
+    void emitActivityChanges();
 
 private:
     int networkRow(NetworkId networkId) const;
@@ -408,6 +430,10 @@ private:
 
     QHash<BufferId, BufferItem *> _bufferItemCache;
 
+    // activity changes caused by new messages are announced at most once per buffer and frame
+    QSet<BufferId> _pendingActivityChanges;
+    QTimer _activityTimer;
+
     int _userNoticesTarget;
     int _serverNoticesTarget;
     int _errorMsgsTarget;
@@ -33,3 +33,9 @@ QVariantList BacklogManager::requestBacklogAll(MsgId first, MsgId last, int limi
     REQUEST(ARG(first), ARG(last), ARG(limit), ARG(additional))
     return QVariantList();
 }
+
+
+void BacklogManager::requestBacklogChunked(PeerPtr peer, BufferId bufferId, MsgId first, MsgId last, int limit, int additional)
+{
+    REQUEST(ARG(peer), ARG(bufferId), ARG(first), ARG(last), ARG(limit), ARG(additional))
+}
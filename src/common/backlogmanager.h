@@ -21,6 +21,7 @@
 #ifndef BACKLOGMANAGER_H
 #define BACKLOGMANAGER_H
 
+#include "peer.h"
 #include "syncableobject.h"
 #include "types.h"
 
@@ -40,6 +41,13 @@ public slots:
     virtual QVariantList requestBacklogAll(MsgId first = -1, MsgId last = -1, int limit = -1, int additional = 0);
     inline virtual void receiveBacklogAll(MsgId, MsgId, int, int, QVariantList) {};
 
+    //! Requests backlog to be streamed in chunks rather than returned in one reply
+    /** The core answers with a series of receiveBacklogChunk() calls to the requesting peer,
+     *  the last of which has \c last set. Only available if the core supports Quassel::ChunkedBacklog.
+     */
+    virtual void requestBacklogChunked(PeerPtr peer, BufferId bufferId, MsgId first = -1, MsgId last = -1, int limit = -1, int additional = 0);
+    inline virtual void receiveBacklogChunk(PeerPtr, BufferId, QVariantList, bool) {};
+
 signals:
     void backlogRequested(BufferId, MsgId, MsgId, int, int);
     void backlogAllRequested(MsgId, MsgId, int, int);
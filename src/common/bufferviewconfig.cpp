@@ -32,7 +32,8 @@ BufferViewConfig::BufferViewConfig(int bufferViewId, QObject *parent)
     _hideInactiveNetworks(false),
     _disableDecoration(false),
     _allowedBufferTypes(BufferInfo::StatusBuffer | BufferInfo::ChannelBuffer | BufferInfo::QueryBuffer | BufferInfo::GroupBuffer),
-    _minimumActivity(0)
+    _minimumActivity(0),
+    _bufferPositionsValid(false)
 {
     setObjectName(QString::number(bufferViewId));
 }
@@ -40,7 +41,8 @@ BufferViewConfig::BufferViewConfig(int bufferViewId, QObject *parent)
 
 BufferViewConfig::BufferViewConfig(int bufferViewId, const QVariantMap &properties, QObject *parent)
     : SyncableObject(parent),
-    _bufferViewId(bufferViewId)
+    _bufferViewId(bufferViewId),
+    _bufferPositionsValid(false)
 {
     fromVariantMap(properties);
     setObjectName(QString::number(bufferViewId));
@@ -145,6 +147,19 @@ void BufferViewConfig::setHideInactiveNetworks(bool hideInactiveNetworks)
 }
 
 
+int BufferViewConfig::bufferPosition(const BufferId &bufferId) const
+{
+    if (!_bufferPositionsValid) {
+        _bufferPositions.clear();
+        _bufferPositions.reserve(_buffers.count());
+        for (int i = 0; i < _buffers.count(); i++)
+            _bufferPositions[_buffers.at(i)] = i;
+        _bufferPositionsValid = true;
+    }
+    return _bufferPositions.value(bufferId, -1);
+}
+
+
 QVariantList BufferViewConfig::initBufferList() const
 {
     QVariantList buffers;
@@ -164,6 +179,7 @@ void BufferViewConfig::initSetBufferList(const QVariantList &buffers)
     foreach(QVariant buffer, buffers) {
         _buffers << buffer.value<BufferId>();
     }
+    _bufferPositionsValid = false;
 
     emit configChanged(); // used to track changes in the settingspage
 }
@@ -176,6 +192,7 @@ void BufferViewConfig::initSetBufferList(const QList<BufferId> &buffers)
     foreach(BufferId bufferId, buffers) {
         _buffers << bufferId;
     }
+    _bufferPositionsValid = false;
 
     emit configChanged(); // used to track changes in the settingspage
 }
@@ -227,7 +244,7 @@ void BufferViewConfig::initSetTemporarilyRemovedBuffers(const QVariantList &buff
 
 void BufferViewConfig::addBuffer(const BufferId &bufferId, int pos)
 {
-    if (_buffers.contains(bufferId))
+    if (containsBuffer(bufferId))
         return;
 
     if (pos < 0)
@@ -242,6 +259,7 @@ void BufferViewConfig::addBuffer(const BufferId &bufferId, int pos)
         _temporarilyRemovedBuffers.remove(bufferId);
 
     _buffers.insert(pos, bufferId);
+    _bufferPositionsValid = false;
     SYNC(ARG(bufferId), ARG(pos))
     emit bufferAdded(bufferId, pos);
     emit configChanged();
@@ -250,7 +268,8 @@ void BufferViewConfig::addBuffer(const BufferId &bufferId, int pos)
 
 void BufferViewConfig::moveBuffer(const BufferId &bufferId, int pos)
 {
-    if (!_buffers.contains(bufferId))
+    int oldPos = bufferPosition(bufferId);
+    if (oldPos == -1)
         return;
 
     if (pos < 0)
@@ -258,7 +277,8 @@ void BufferViewConfig::moveBuffer(const BufferId &bufferId, int pos)
     if (pos >= _buffers.count())
         pos = _buffers.count() - 1;
 
-    _buffers.move(_buffers.indexOf(bufferId), pos);
+    _buffers.move(oldPos, pos);
+    _bufferPositionsValid = false;
     SYNC(ARG(bufferId), ARG(pos))
     emit bufferMoved(bufferId, pos);
     emit configChanged();
@@ -267,8 +287,11 @@ void BufferViewConfig::moveBuffer(const BufferId &bufferId, int pos)
 
 void BufferViewConfig::removeBuffer(const BufferId &bufferId)
 {
-    if (_buffers.contains(bufferId))
-        _buffers.removeAt(_buffers.indexOf(bufferId));
+    int pos = bufferPosition(bufferId);
+    if (pos != -1) {
+        _buffers.removeAt(pos);
+        _bufferPositionsValid = false;
+    }
 
     if (_removedBuffers.contains(bufferId))
         _removedBuffers.remove(bufferId);
@@ -282,8 +305,11 @@ void BufferViewConfig::removeBuffer(const BufferId &bufferId)
 
 void BufferViewConfig::removeBufferPermanently(const BufferId &bufferId)
 {
-    if (_buffers.contains(bufferId))
-        _buffers.removeAt(_buffers.indexOf(bufferId));
+    int pos = bufferPosition(bufferId);
+    if (pos != -1) {
+        _buffers.removeAt(pos);
+        _bufferPositionsValid = false;
+    }
 
     if (_temporarilyRemovedBuffers.contains(bufferId))
         _temporarilyRemovedBuffers.remove(bufferId);
@@ -82,6 +82,10 @@ public slots:
     const QSet<BufferId> &removedBuffers() const { return _removedBuffers; }
     const QSet<BufferId> &temporarilyRemovedBuffers() const { return _temporarilyRemovedBuffers; }
 
+    //! Returns the position of the buffer in bufferList() or -1 if it's not part of this view
+    int bufferPosition(const BufferId &bufferId) const;
+    inline bool containsBuffer(const BufferId &bufferId) const { return bufferPosition(bufferId) != -1; }
+
     QVariantList initBufferList() const;
     void initSetBufferList(const QVariantList &buffers);
     void initSetBufferList(const QList<BufferId> &buffers);
@@ -138,6 +142,10 @@ private:
     QList<BufferId> _buffers;
     QSet<BufferId> _removedBuffers;
     QSet<BufferId> _temporarilyRemovedBuffers;
+
+    // lookup table for bufferPosition(), rebuilt lazily after the buffer list changed
+    mutable QHash<BufferId, int> _bufferPositions;
+    mutable bool _bufferPositionsValid;
 };
 
 
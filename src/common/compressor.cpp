@@ -38,7 +38,11 @@ Compressor::Compressor(QTcpSocket *socket, Compressor::CompressionLevel level, Q
     _socket(socket),
     _level(level),
     _inflater(0),
-    _deflater(0)
+    _deflater(0),
+    _rawBytesRead(0),
+    _rawBytesWritten(0),
+    _wireBytesRead(0),
+    _wireBytesWritten(0)
 {
     connect(socket, SIGNAL(readyRead()), SLOT(readData()));
 
@@ -147,6 +151,7 @@ qint64 Compressor::write(const char *data, qint64 count, WriteBufferHint flush)
     int pos = _writeBuffer.size();
     _writeBuffer.resize(pos + count);
     memcpy(_writeBuffer.data() + pos, data, count);
+    _rawBytesWritten += count;
 
     if (flush != NoFlush)
         writeData();
@@ -165,7 +170,10 @@ void Compressor::readData()
         return;
 
     if (compressionLevel() == NoCompression) {
-        _readBuffer.append(_socket->read(maxBufferSize - _readBuffer.size()));
+        QByteArray data = _socket->read(maxBufferSize - _readBuffer.size());
+        _wireBytesRead += data.size();
+        _rawBytesRead += data.size();
+        _readBuffer.append(data);
         emit readyRead();
         return;
     }
@@ -178,7 +186,9 @@ void Compressor::readData()
 
     while (_socket->bytesAvailable() && _readBuffer.size() + ioBufferSize < maxBufferSize && _inputBuffer.size() < ioBufferSize) {
         _readBuffer.resize(_readBuffer.size() + ioBufferSize);
+        int inputSize = _inputBuffer.size();
         _inputBuffer.append(_socket->read(ioBufferSize - _inputBuffer.size()));
+        _wireBytesRead += _inputBuffer.size() - inputSize;
 
         _inflater->next_in = reinterpret_cast<unsigned char *>(_inputBuffer.data());
         _inflater->avail_in = _inputBuffer.size();
@@ -188,6 +198,7 @@ void Compressor::readData()
         const unsigned char *orig_out = _inflater->next_out; // so we see if we have actually produced any output
 
         int status = inflate(_inflater, Z_SYNC_FLUSH); // get as much data as possible
+        _rawBytesRead += _inflater->next_out - orig_out;
 
         // adjust input and output buffers
         _readBuffer.resize(_inflater->next_out - reinterpret_cast<unsigned char *>(_readBuffer.data()));
@@ -224,7 +235,9 @@ void Compressor::readData()
 void Compressor::writeData()
 {
     if (compressionLevel() == NoCompression) {
-        _socket->write(_writeBuffer);
+        qint64 written = _socket->write(_writeBuffer);
+        if (written > 0)
+            _wireBytesWritten += written;
         _writeBuffer.clear();
         return;
     }
@@ -246,11 +259,13 @@ void Compressor::writeData()
         if (_deflater->avail_out == static_cast<unsigned int>(ioBufferSize))
             continue; // nothing to write here
 
-        if (!_socket->write(_outputBuffer.constData(), ioBufferSize - _deflater->avail_out)) {
+        qint64 written = _socket->write(_outputBuffer.constData(), ioBufferSize - _deflater->avail_out);
+        if (written <= 0) {
             qWarning() << "Error while writing to socket:" << _socket->errorString();
             emit error(DeviceError);
             return;
         }
+        _wireBytesWritten += written;
     } while (_deflater->avail_out == 0); // the output buffer being full is the only reason we should have to loop here!
 
     if (_deflater->avail_in > 0) {
@@ -266,8 +281,9 @@ void Compressor::writeData()
 
 void Compressor::flush()
 {
+    if (!_writeBuffer.isEmpty())
+        writeData();
+
     if (compressionLevel() == NoCompression && _socket->state() == QAbstractSocket::ConnectedState)
         _socket->flush();
-
-    // FIXME: missing impl for enabled compression; but then we're not using this method yet
 }
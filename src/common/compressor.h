@@ -66,6 +66,14 @@ public:
 
     void flush();
 
+    //! Uncompressed bytes handed to or produced by the compressor, respectively
+    qint64 rawBytesRead() const { return _rawBytesRead; }
+    qint64 rawBytesWritten() const { return _rawBytesWritten; }
+
+    //! Bytes actually read from and written to the socket
+    qint64 wireBytesRead() const { return _wireBytesRead; }
+    qint64 wireBytesWritten() const { return _wireBytesWritten; }
+
 signals:
     void readyRead();
     void error(Compressor::Error errorCode = StreamError);
@@ -89,6 +97,11 @@ private:
 
     z_streamp _inflater;
     z_streamp _deflater;
+
+    qint64 _rawBytesRead;
+    qint64 _rawBytesWritten;
+    qint64 _wireBytesRead;
+    qint64 _wireBytesWritten;
 };
 
 #endif
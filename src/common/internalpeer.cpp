@@ -50,6 +50,9 @@ InternalPeer::~InternalPeer()
 {
     if (_isOpen)
         emit disconnected();
+
+    QMutexLocker locker(&_messageQueueMutex);
+    qDeleteAll(_messageQueue);
 }
 
 
@@ -174,11 +177,51 @@ void InternalPeer::dispatch(EventType eventType, const T &msg)
     if(QThread::currentThread() == _peer->thread())
         _peer->handle(msg);
     else
-        QCoreApplication::postEvent(_peer, new PeerMessageEvent<T>(this, eventType, msg));
+        _peer->enqueueMessage(new PeerMessageEvent<T>(this, eventType, msg));
+}
+
+
+void InternalPeer::enqueueMessage(QEvent *messageEvent)
+{
+    QMutexLocker locker(&_messageQueueMutex);
+    _messageQueue.append(messageEvent);
+
+    // Only the first message needs to wake up the receiving thread, the rest will be picked up along with it
+    if (_messageQueue.count() == 1)
+        QCoreApplication::postEvent(this, new QEvent(QEvent::Type(ProcessMessagesEvent)));
+}
+
+
+void InternalPeer::processMessages()
+{
+    QList<QEvent *> messages;
+    {
+        QMutexLocker locker(&_messageQueueMutex);
+        messages.swap(_messageQueue);
+    }
+
+    QPointer<InternalPeer> self(this);
+    for (int i = 0; i < messages.count(); ++i) {
+        if (self)
+            handleMessage(messages[i]);
+        delete messages[i];
+    }
 }
 
 
 void InternalPeer::customEvent(QEvent *event)
+{
+    if (event->type() == QEvent::Type(ProcessMessagesEvent)) {
+        processMessages();
+        event->accept();
+        return;
+    }
+
+    handleMessage(event);
+}
+
+
+void InternalPeer::handleMessage(QEvent *event)
 {
     switch ((int)event->type()) {
         case SyncMessageEvent: {
@@ -21,6 +21,8 @@
 #ifndef INTERNALPEER_H
 #define INTERNALPEER_H
 
+#include <QMutex>
+
 #include "peer.h"
 #include "protocol.h"
 #include "signalproxy.h"
@@ -36,7 +38,8 @@ public:
         SyncMessageEvent = QEvent::User,
         RpcCallEvent,
         InitRequestEvent,
-        InitDataEvent
+        InitDataEvent,
+        ProcessMessagesEvent
     };
 
     InternalPeer(QObject *parent = 0);
@@ -87,10 +90,19 @@ private:
     template<class T>
     void dispatch(EventType eventType, const T &msg);
 
+    void enqueueMessage(QEvent *messageEvent);
+    void handleMessage(QEvent *messageEvent);
+    void processMessages();
+
 private:
     SignalProxy *_proxy;
     InternalPeer *_peer;
     bool _isOpen;
+
+    // Messages from a peer living in another thread. Rather than posting an event for each of them,
+    // they get queued here, and the whole queue is handed over in one go.
+    QMutex _messageQueueMutex;
+    QList<QEvent *> _messageQueue;
 };
 
 
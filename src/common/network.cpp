@@ -21,6 +21,7 @@
 #include <QTextCodec>
 
 #include "network.h"
+#include "peer.h"
 
 QTextCodec *Network::_defaultCodecForServer = 0;
 QTextCodec *Network::_defaultCodecForEncoding = 0;
@@ -43,6 +44,7 @@ Network::Network(const NetworkId &networkid, QObject *parent)
     _connectionState(Disconnected),
     _prefixes(QString()),
     _prefixModes(QString()),
+    _lazyIrcUsers(false),
     _useRandomServer(false),
     _useAutoIdentify(false),
     _useSasl(false),
@@ -235,7 +237,7 @@ IrcUser *Network::newIrcUser(const QString &hostmask, const QVariantMap &initDat
         }
 
         if (proxy())
-            proxy()->synchronize(ircuser);
+            proxy()->synchronize(ircuser, _lazyIrcUsers);
         else
             qWarning() << "unable to synchronize new IrcUser" << hostmask << "forgot to call Network::setProxy(SignalProxy *)?";
 
@@ -782,7 +784,19 @@ QVariantMap Network::initIrcUsersAndChannels() const
 {
     QVariantMap usersAndChannels;
 
-    if (_ircUsers.count()) {
+    // Clients that opted in to lazy synchronization only get the nicks; together with the channels' user modes,
+    // that's all they need for the nick lists. The full IrcUsers are requested separately once actually needed.
+    Peer *peer = proxy() ? proxy()->sourcePeer() : 0;
+    if (peer && peer->features() & Quassel::LazyIrcUsers) {
+        QVariantList nicks;
+        foreach(IrcUser *ircuser, _ircUsers)
+            nicks << ircuser->nick();
+        QVariantMap userMap;
+        userMap["nick"] = nicks;
+        usersAndChannels["Users"] = userMap;
+        usersAndChannels["LazyUsers"] = true;
+    }
+    else if (_ircUsers.count()) {
         QHash<QString, QVariantList> users;
         QHash<QString, IrcUser *>::const_iterator it = _ircUsers.begin();
         QHash<QString, IrcUser *>::const_iterator end = _ircUsers.end();
@@ -848,8 +862,15 @@ void Network::initSetIrcUsersAndChannels(const QVariantMap &usersAndChannels)
         }
     }
 
+    // In lazy mode we only get the nicks, and the IrcUsers will be initialized on demand
+    _lazyIrcUsers = usersAndChannels["LazyUsers"].toBool();
+
     // now create the individual IrcUsers
     for(int i = 0; i < count; i++) {
+        if (_lazyIrcUsers) {
+            newIrcUser(users["nick"].toList().at(i).toString());
+            continue;
+        }
         QVariantMap map;
         foreach(const QString &key, users.keys())
             map[key] = users[key].toList().at(i);
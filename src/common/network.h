@@ -228,6 +228,9 @@ public :
     inline QList<IrcUser *> ircUsers() const { return _ircUsers.values(); }
     inline quint32 ircUserCount() const { return _ircUsers.count(); }
 
+    //! Whether IrcUsers only get their full state on demand (see IrcUser::requestInit())
+    inline bool lazyIrcUsers() const { return _lazyIrcUsers; }
+
     IrcChannel *newIrcChannel(const QString &channelname, const QVariantMap &initData = QVariantMap());
     inline IrcChannel *newIrcChannel(const QByteArray &channelname) { return newIrcChannel(decodeServerString(channelname)); }
     IrcChannel *ircChannel(QString channelname) const;
@@ -480,6 +483,7 @@ private:
     mutable QString _prefixModes;
 
     QHash<QString, IrcUser *> _ircUsers; // stores all known nicks for the server
+    bool _lazyIrcUsers; // client only: IrcUsers are synchronized with deferred init
     QHash<QString, IrcChannel *> _ircChannels; // stores all known channels
     QHash<QString, QString> _supports; // stores results from RPL_ISUPPORT
 
@@ -23,6 +23,7 @@
 Peer::Peer(AuthHandler *authHandler, QObject *parent)
     : QObject(parent)
     , _authHandler(authHandler)
+    , _features(0)
 {
 
 }
@@ -34,6 +35,13 @@ AuthHandler *Peer::authHandler() const
 }
 
 
+void Peer::dispatchSyncBatch(const QList<Protocol::SyncMessage> &messages)
+{
+    foreach (const Protocol::SyncMessage &msg, messages)
+        dispatch(msg);
+}
+
+
 // PeerPtr is used in RPC signatures for enabling receivers to send replies
 // to a particular peer rather than broadcast to all connected ones.
 // To enable this, the SignalProxy transparently replaces the bogus value
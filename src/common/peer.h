@@ -27,8 +27,11 @@
 
 #include "authhandler.h"
 #include "protocol.h"
+#include "quassel.h"
 #include "signalproxy.h"
 
+class PeerMetrics;
+
 class Peer : public QObject
 {
     Q_OBJECT
@@ -44,12 +47,19 @@ public:
 
     AuthHandler *authHandler() const;
 
+    //! The features announced by the other side of this connection
+    inline Quassel::Features features() const { return _features; }
+    inline void setFeatures(Quassel::Features features) { _features = features; }
+
     virtual bool isOpen() const = 0;
     virtual bool isSecure() const = 0;
     virtual bool isLocal() const = 0;
 
     virtual int lag() const = 0;
 
+    //! Traffic statistics for this connection, or 0 if the peer doesn't collect any
+    virtual PeerMetrics *metrics() { return 0; }
+
 public slots:
     /* Handshake messages */
     virtual void dispatch(const Protocol::RegisterClient &) = 0;
@@ -69,6 +79,8 @@ public slots:
     virtual void dispatch(const Protocol::InitRequest &) = 0;
     virtual void dispatch(const Protocol::InitData &) = 0;
 
+    virtual void dispatchSyncBatch(const QList<Protocol::SyncMessage> &messages);
+
     virtual void close(const QString &reason = QString()) = 0;
 
 signals:
@@ -82,6 +94,7 @@ protected:
 
 private:
     QPointer<AuthHandler> _authHandler;
+    Quassel::Features _features;
 };
 
 // We need to special-case Peer* in attached signals/slots, so typedef it for the meta type system
@@ -0,0 +1,157 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2016 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <QSet>
+#include <QtAlgorithms>
+
+#include "peermetrics.h"
+
+namespace {
+
+// Number of round trip samples we keep for the percentiles
+const int maxRoundTripSamples = 100;
+
+QMutex *registryMutex()
+{
+    static QMutex mutex;
+    return &mutex;
+}
+
+QSet<PeerMetrics *> &registry()
+{
+    static QSet<PeerMetrics *> metrics;
+    return metrics;
+}
+
+}
+
+
+PeerMetrics::PeerMetrics()
+    : _deserializationNsecs(0),
+    _serializationNsecs(0),
+    _rawBytesIn(0),
+    _wireBytesIn(0),
+    _rawBytesOut(0),
+    _wireBytesOut(0),
+    _roundTripPos(0)
+{
+    QMutexLocker locker(registryMutex());
+    registry().insert(this);
+}
+
+
+PeerMetrics::~PeerMetrics()
+{
+    QMutexLocker locker(registryMutex());
+    registry().remove(this);
+}
+
+
+void PeerMetrics::setDescription(const QString &description)
+{
+    QMutexLocker locker(&_mutex);
+    _description = description;
+}
+
+
+void PeerMetrics::addFrame(Direction direction, const QByteArray &type, qint64 nsecs)
+{
+    QMutexLocker locker(&_mutex);
+    if (direction == Incoming) {
+        ++_framesIn[type];
+        _deserializationNsecs += nsecs;
+    }
+    else {
+        ++_framesOut[type];
+        _serializationNsecs += nsecs;
+    }
+}
+
+
+void PeerMetrics::setByteCounts(qint64 rawIn, qint64 wireIn, qint64 rawOut, qint64 wireOut)
+{
+    QMutexLocker locker(&_mutex);
+    _rawBytesIn = rawIn;
+    _wireBytesIn = wireIn;
+    _rawBytesOut = rawOut;
+    _wireBytesOut = wireOut;
+}
+
+
+void PeerMetrics::addRoundTripTime(int msecs)
+{
+    QMutexLocker locker(&_mutex);
+    if (_roundTripTimes.count() < maxRoundTripSamples)
+        _roundTripTimes.append(msecs);
+    else
+        _roundTripTimes[_roundTripPos] = msecs;
+    _roundTripPos = (_roundTripPos + 1) % maxRoundTripSamples;
+}
+
+
+int PeerMetrics::roundTripPercentile(const QVector<int> &sortedSamples, int percentile) const
+{
+    if (sortedSamples.isEmpty())
+        return -1;
+    int idx = (sortedSamples.count() - 1) * percentile / 100;
+    return sortedSamples.at(idx);
+}
+
+
+QVariantMap PeerMetrics::toVariantMap() const
+{
+    QMutexLocker locker(&_mutex);
+
+    QVariantMap metrics;
+    metrics["description"] = _description;
+    metrics["rawBytesIn"] = _rawBytesIn;
+    metrics["wireBytesIn"] = _wireBytesIn;
+    metrics["rawBytesOut"] = _rawBytesOut;
+    metrics["wireBytesOut"] = _wireBytesOut;
+    metrics["deserializationMsecs"] = _deserializationNsecs / 1000000;
+    metrics["serializationMsecs"] = _serializationNsecs / 1000000;
+
+    QVariantMap framesIn, framesOut;
+    QHash<QByteArray, quint64>::const_iterator it;
+    for (it = _framesIn.constBegin(); it != _framesIn.constEnd(); ++it)
+        framesIn[QString::fromLatin1(it.key())] = it.value();
+    for (it = _framesOut.constBegin(); it != _framesOut.constEnd(); ++it)
+        framesOut[QString::fromLatin1(it.key())] = it.value();
+    metrics["framesIn"] = framesIn;
+    metrics["framesOut"] = framesOut;
+
+    QVector<int> samples = _roundTripTimes;
+    qSort(samples.begin(), samples.end());
+    metrics["roundTripP50"] = roundTripPercentile(samples, 50);
+    metrics["roundTripP90"] = roundTripPercentile(samples, 90);
+    metrics["roundTripP99"] = roundTripPercentile(samples, 99);
+
+    return metrics;
+}
+
+
+QVariantList PeerMetrics::snapshots()
+{
+    QMutexLocker locker(registryMutex());
+    QVariantList result;
+    foreach(const PeerMetrics *metrics, registry())
+        result << metrics->toVariantMap();
+    return result;
+}
@@ -0,0 +1,81 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2016 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#ifndef PEERMETRICS_H
+#define PEERMETRICS_H
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QVariantMap>
+#include <QVector>
+
+//! Traffic and latency statistics for a single peer
+/** All methods are thread-safe, so the statistics of peers living in session threads can be read
+ *  from elsewhere (e.g. for the core's metrics endpoint). All live instances are registered in a
+ *  process-wide list, see snapshots().
+ */
+class PeerMetrics
+{
+public:
+    enum Direction {
+        Incoming,
+        Outgoing
+    };
+
+    PeerMetrics();
+    ~PeerMetrics();
+
+    void setDescription(const QString &description);
+
+    //! Count a message frame of the given type, along with the time it took to (de)serialize it
+    void addFrame(Direction direction, const QByteArray &type, qint64 nsecs);
+
+    //! Update the byte counters, before (raw) and after (wire) compression
+    void setByteCounts(qint64 rawIn, qint64 wireIn, qint64 rawOut, qint64 wireOut);
+
+    void addRoundTripTime(int msecs);
+
+    QVariantMap toVariantMap() const;
+
+    //! Returns toVariantMap() for each live PeerMetrics instance
+    static QVariantList snapshots();
+
+private:
+    int roundTripPercentile(const QVector<int> &sortedSamples, int percentile) const;
+
+    mutable QMutex _mutex;
+    QString _description;
+
+    QHash<QByteArray, quint64> _framesIn;
+    QHash<QByteArray, quint64> _framesOut;
+    qint64 _deserializationNsecs;
+    qint64 _serializationNsecs;
+
+    qint64 _rawBytesIn;
+    qint64 _wireBytesIn;
+    qint64 _rawBytesOut;
+    qint64 _wireBytesOut;
+
+    QVector<int> _roundTripTimes; // ring buffer of the most recent samples
+    int _roundTripPos;
+};
+
+#endif
@@ -20,6 +20,7 @@
 
 #include <QtEndian>
 #include <QDataStream>
+#include <QElapsedTimer>
 #include <QHostAddress>
 #include <QTcpSocket>
 
@@ -53,16 +54,44 @@ quint16 DataStreamPeer::enabledFeatures() const
 }
 
 
+// Name of the message type, as used for the frame counters in PeerMetrics
+QByteArray DataStreamPeer::frameType(const QVariantList &list) const
+{
+    if (!signalProxy())
+        return "Handshake";
+
+    switch (list.isEmpty() ? 0 : list.first().value<qint16>()) {
+        case Sync:
+            return "Sync";
+        case RpcCall:
+            return "RpcCall";
+        case InitRequest:
+            return "InitRequest";
+        case InitData:
+            return "InitData";
+        case HeartBeat:
+            return "HeartBeat";
+        case HeartBeatReply:
+            return "HeartBeatReply";
+        default:
+            return "Unknown";
+    }
+}
+
+
 void DataStreamPeer::processMessage(const QByteArray &msg)
 {
     QDataStream stream(msg);
     stream.setVersion(QDataStream::Qt_4_2);
     QVariantList list;
+    QElapsedTimer timer;
+    timer.start();
     stream >> list;
     if (stream.status() != QDataStream::Ok) {
         close("Peer sent corrupt data, closing down!");
         return;
     }
+    metrics()->addFrame(PeerMetrics::Incoming, frameType(list), timer.nsecsElapsed());
 
     // if no sigproxy is set, we're in handshake mode
     if (!signalProxy())
@@ -88,9 +117,12 @@ void DataStreamPeer::writeMessage(const QVariantMap &handshakeMsg)
 void DataStreamPeer::writeMessage(const QVariantList &sigProxyMsg)
 {
     QByteArray data;
+    QElapsedTimer timer;
+    timer.start();
     QDataStream msgStream(&data, QIODevice::WriteOnly);
     msgStream.setVersion(QDataStream::Qt_4_2);
     msgStream << sigProxyMsg;
+    metrics()->addFrame(PeerMetrics::Outgoing, frameType(sigProxyMsg), timer.nsecsElapsed());
 
     writeMessage(data);
 }
@@ -116,7 +148,7 @@ void DataStreamPeer::handleHandshakeMessage(const QVariantList &mapData)
     }
 
     if (msgType == "ClientInit") {
-        handle(RegisterClient(m["ClientVersion"].toString(), m["ClientDate"].toString(), false)); // UseSsl obsolete
+        handle(RegisterClient(m["ClientVersion"].toString(), m["ClientDate"].toString(), false, m["ClientFeatures"].toUInt())); // UseSsl obsolete
     }
 
     else if (msgType == "ClientInitReject") {
@@ -168,6 +200,7 @@ void DataStreamPeer::dispatch(const RegisterClient &msg) {
     m["MsgType"] = "ClientInit";
     m["ClientVersion"] = msg.clientVersion;
     m["ClientDate"] = msg.buildDate;
+    m["ClientFeatures"] = msg.clientFeatures;
 
     writeMessage(m);
 }
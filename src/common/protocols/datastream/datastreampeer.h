@@ -75,6 +75,7 @@ private:
     void writeMessage(const QVariantMap &handshakeMsg);
     void writeMessage(const QVariantList &sigProxyMsg);
     void processMessage(const QByteArray &msg);
+    QByteArray frameType(const QVariantList &list) const;
 
     void handleHandshakeMessage(const QVariantList &mapData);
     void handlePackedFunc(const QVariantList &packedFunc);
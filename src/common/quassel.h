@@ -72,8 +72,10 @@ public:
         HideInactiveNetworks = 0x0008,
         PasswordChange = 0x0010,
         CapNegotiation = 0x0020,           /// IRCv3 capability negotiation, account tracking
+        LazyIrcUsers = 0x0040,             /// Network init data only carries nicks, IrcUsers are fetched on demand
+        ChunkedBacklog = 0x0080,           /// Backlog can be streamed in chunks (BacklogManager::requestBacklogChunked)
 
-        NumFeatures = 0x0020
+        NumFeatures = 0x0080
     };
     Q_DECLARE_FLAGS(Features, Feature)
 
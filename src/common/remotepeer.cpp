@@ -43,7 +43,8 @@ RemotePeer::RemotePeer(::AuthHandler *authHandler, QTcpSocket *socket, Compresso
     _heartBeatTimer(new QTimer(this)),
     _heartBeatCount(0),
     _lag(0),
-    _msgSize(0)
+    _msgSize(0),
+    _writeBatch(false)
 {
     socket->setParent(this);
     connect(socket, SIGNAL(stateChanged(QAbstractSocket::SocketState)), SLOT(onSocketStateChanged(QAbstractSocket::SocketState)));
@@ -60,6 +61,8 @@ RemotePeer::RemotePeer(::AuthHandler *authHandler, QTcpSocket *socket, Compresso
     connect(_compressor, SIGNAL(error(Compressor::Error)), SLOT(onCompressionError(Compressor::Error)));
 
     connect(_heartBeatTimer, SIGNAL(timeout()), SLOT(sendHeartBeat()));
+
+    _metrics.setDescription(socket->peerAddress().toString());
 }
 
 
@@ -146,6 +149,19 @@ QTcpSocket *RemotePeer::socket() const
 }
 
 
+PeerMetrics *RemotePeer::metrics()
+{
+    return &_metrics;
+}
+
+
+void RemotePeer::updateByteCounts()
+{
+    _metrics.setByteCounts(_compressor->rawBytesRead(), _compressor->wireBytesRead(),
+                           _compressor->rawBytesWritten(), _compressor->wireBytesWritten());
+}
+
+
 bool RemotePeer::isSecure() const
 {
     if (socket()) {
@@ -194,6 +210,7 @@ void RemotePeer::onReadyRead()
     QByteArray msg;
     while (readMessage(msg))
         processMessage(msg);
+    updateByteCounts();
 }
 
 
@@ -239,7 +256,21 @@ void RemotePeer::writeMessage(const QByteArray &msg)
 {
     quint32 size = qToBigEndian<quint32>(msg.size());
     _compressor->write((const char*)&size, 4, Compressor::NoFlush);
-    _compressor->write(msg.constData(), msg.size());
+    _compressor->write(msg.constData(), msg.size(), _writeBatch ? Compressor::NoFlush : Compressor::Flush);
+    if (!_writeBatch)
+        updateByteCounts();
+}
+
+
+// Write all messages into the compressor's buffer first, so the batch gets compressed
+// and sent to the socket in one go rather than flushing the deflater for every single message.
+void RemotePeer::dispatchSyncBatch(const QList<SyncMessage> &messages)
+{
+    _writeBatch = true;
+    Peer::dispatchSyncBatch(messages);
+    _writeBatch = false;
+    _compressor->flush();
+    updateByteCounts();
 }
 
 
@@ -252,7 +283,9 @@ void RemotePeer::handle(const HeartBeat &heartBeat)
 void RemotePeer::handle(const HeartBeatReply &heartBeatReply)
 {
     _heartBeatCount = 0;
-    emit lagUpdated(heartBeatReply.timestamp.msecsTo(QDateTime::currentDateTime().toUTC()) / 2);
+    int roundTripTime = heartBeatReply.timestamp.msecsTo(QDateTime::currentDateTime().toUTC());
+    _metrics.addRoundTripTime(roundTripTime);
+    emit lagUpdated(roundTripTime / 2);
 }
 
 
@@ -25,6 +25,7 @@
 
 #include "compressor.h"
 #include "peer.h"
+#include "peermetrics.h"
 #include "protocol.h"
 #include "signalproxy.h"
 
@@ -60,6 +61,10 @@ public:
 
     QTcpSocket *socket() const;
 
+    PeerMetrics *metrics();
+
+    void dispatchSyncBatch(const QList<Protocol::SyncMessage> &messages);
+
 public slots:
     void close(const QString &reason = QString());
 
@@ -93,6 +98,7 @@ private slots:
 
 private:
     bool readMessage(QByteArray &msg);
+    void updateByteCounts();
 
 private:
     QTcpSocket *_socket;
@@ -102,6 +108,8 @@ private:
     int _heartBeatCount;
     int _lag;
     quint32 _msgSize;
+    bool _writeBatch;
+    PeerMetrics _metrics;
 };
 
 #endif
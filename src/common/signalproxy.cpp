@@ -23,6 +23,7 @@
 #include <QMetaMethod>
 #include <QMetaProperty>
 #include <QThread>
+#include <QTimer>
 
 #ifdef HAVE_SSL
     #include <QSslSocket>
@@ -31,6 +32,7 @@
 #include "signalproxy.h"
 
 #include "peer.h"
+#include "peermetrics.h"
 #include "protocol.h"
 #include "syncableobject.h"
 #include "util.h"
@@ -225,6 +227,11 @@ void SignalProxy::init()
     _heartBeatInterval = 0;
     _maxHeartBeatCount = 0;
     _signalRelay = new SignalRelay(this);
+    _sourcePeer = 0;
+    _syncCoalescingInterval = 0;
+    _syncCoalescingTimer = new QTimer(this);
+    _syncCoalescingTimer->setSingleShot(true);
+    connect(_syncCoalescingTimer, SIGNAL(timeout()), SLOT(flushSyncQueues()));
     setHeartBeatInterval(30);
     setMaxHeartBeatCount(2);
     _secure = false;
@@ -261,6 +268,19 @@ void SignalProxy::setMaxHeartBeatCount(int max)
 }
 
 
+void SignalProxy::setSyncCoalescingInterval(int msecs)
+{
+    if (_syncCoalescingInterval == msecs)
+        return;
+
+    _syncCoalescingInterval = msecs;
+    if (msecs <= 0)
+        flushSyncQueues();
+    else
+        _syncCoalescingTimer->setInterval(msecs);
+}
+
+
 bool SignalProxy::addPeer(Peer *peer)
 {
     if (!peer)
@@ -331,6 +351,7 @@ void SignalProxy::removePeer(Peer *peer)
     disconnect(peer, 0, this, 0);
     peer->setSignalProxy(0);
 
+    _syncQueues.remove(peer);
     _peers.remove(peer);
     emit peerRemoved(peer);
 
@@ -438,7 +459,7 @@ bool SignalProxy::attachSlot(const QByteArray &sigName, QObject *recv, const cha
 }
 
 
-void SignalProxy::synchronize(SyncableObject *obj)
+void SignalProxy::synchronize(SyncableObject *obj, bool deferInit)
 {
     createExtendedMetaObject(obj, true);
 
@@ -453,7 +474,7 @@ void SignalProxy::synchronize(SyncableObject *obj)
     else {
         if (obj->isInitialized())
             emit objectInitialized(obj);
-        else
+        else if (!deferInit)
             requestInit(obj);
     }
 
@@ -507,8 +528,10 @@ template<class T>
 void SignalProxy::dispatch(const T &protoMessage)
 {
     foreach (Peer *peer, _peers) {
-        if (peer->isOpen())
+        if (peer->isOpen()) {
+            flushSyncQueue(peer);
             peer->dispatch(protoMessage);
+        }
         else
             QCoreApplication::postEvent(this, new ::RemovePeerEvent(peer));
     }
@@ -518,13 +541,104 @@ void SignalProxy::dispatch(const T &protoMessage)
 template<class T>
 void SignalProxy::dispatch(Peer *peer, const T &protoMessage)
 {
-    if (peer && peer->isOpen())
+    if (peer && peer->isOpen()) {
+        flushSyncQueue(peer);
         peer->dispatch(protoMessage);
+    }
+    else
+        QCoreApplication::postEvent(this, new ::RemovePeerEvent(peer));
+}
+
+
+void SignalProxy::dispatchSync(const SyncMessage &syncMessage)
+{
+    if (_syncCoalescingInterval <= 0) {
+        dispatch(syncMessage);
+        return;
+    }
+
+    foreach (Peer *peer, _peers) {
+        if (peer->isOpen())
+            queueSyncMessage(peer, syncMessage);
+        else
+            QCoreApplication::postEvent(this, new ::RemovePeerEvent(peer));
+    }
+}
+
+
+void SignalProxy::dispatchSync(Peer *peer, const SyncMessage &syncMessage)
+{
+    if (_syncCoalescingInterval <= 0) {
+        dispatch(peer, syncMessage);
+        return;
+    }
+
+    if (peer && peer->isOpen())
+        queueSyncMessage(peer, syncMessage);
     else
         QCoreApplication::postEvent(this, new ::RemovePeerEvent(peer));
 }
 
 
+void SignalProxy::queueSyncMessage(Peer *peer, const SyncMessage &syncMessage)
+{
+    SyncQueue &queue = _syncQueues[peer];
+
+    // A setter call supersedes earlier calls to the same setter on the same object, as long as all but the last
+    // argument (i.e. the value being set) are equal. We drop the earlier call rather than updating it in place,
+    // so the new value still reaches the peer after everything that was queued in between.
+    if (syncMessage.slotName.startsWith("set")) {
+        QByteArray key;
+        QDataStream keyStream(&key, QIODevice::WriteOnly);
+        keyStream << syncMessage.className << syncMessage.objectName << syncMessage.slotName;
+        for (int i = 0; i < syncMessage.params.count() - 1; i++)
+            keyStream << syncMessage.params[i];
+
+        QHash<QByteArray, int>::iterator it = queue.setterIndex.find(key);
+        if (it != queue.setterIndex.end()) {
+            queue.messages[it.value()].slotName.clear(); // mark as superseded
+            it.value() = queue.messages.count();
+        }
+        else
+            queue.setterIndex.insert(key, queue.messages.count());
+    }
+    queue.messages.append(syncMessage);
+
+    if (!_syncCoalescingTimer->isActive())
+        _syncCoalescingTimer->start();
+}
+
+
+void SignalProxy::flushSyncQueue(Peer *peer)
+{
+    if (_syncQueues.isEmpty())
+        return;
+
+    QHash<Peer *, SyncQueue>::iterator it = _syncQueues.find(peer);
+    if (it == _syncQueues.end())
+        return;
+
+    QList<SyncMessage> messages;
+    messages.reserve(it->messages.count());
+    foreach (const SyncMessage &syncMessage, it->messages) {
+        if (!syncMessage.slotName.isEmpty())
+            messages.append(syncMessage);
+    }
+    _syncQueues.erase(it);
+
+    if (peer->isOpen())
+        peer->dispatchSyncBatch(messages);
+}
+
+
+void SignalProxy::flushSyncQueues()
+{
+    _syncCoalescingTimer->stop();
+    foreach (Peer *peer, _syncQueues.keys())
+        flushSyncQueue(peer);
+}
+
+
 void SignalProxy::handle(Peer *peer, const SyncMessage &syncMessage)
 {
     if (!_syncSlave.contains(syncMessage.className) || !_syncSlave[syncMessage.className].contains(syncMessage.objectName)) {
@@ -564,6 +678,7 @@ void SignalProxy::handle(Peer *peer, const SyncMessage &syncMessage)
         if (eMeta->argTypes(receiverId).count() > 1)
             returnParams << syncMessage.params;
         returnParams << returnValue;
+        flushSyncQueue(peer);
         peer->dispatch(SyncMessage(syncMessage.className, syncMessage.objectName, eMeta->methodName(receiverId), returnParams));
     }
 
@@ -587,7 +702,11 @@ void SignalProxy::handle(Peer *peer, const InitRequest &initRequest)
     }
 
     SyncableObject *obj = _syncSlave[initRequest.className][initRequest.objectName];
-    peer->dispatch(InitData(initRequest.className, initRequest.objectName, initData(obj)));
+    flushSyncQueue(peer);
+    _sourcePeer = peer;
+    QVariantMap data = initData(obj);
+    _sourcePeer = 0;
+    peer->dispatch(InitData(initRequest.className, initRequest.objectName, data));
 }
 
 
@@ -737,32 +856,36 @@ void SignalProxy::customEvent(QEvent *event)
 }
 
 
-void SignalProxy::sync_call__(const SyncableObject *obj, SignalProxy::ProxyMode modeType, const char *funcname, va_list ap)
+void SignalProxy::sync_call__(const SyncableObject *obj, SignalProxy::ProxyMode modeType, const SyncCallSite &callSite, void **argv)
 {
-    // qDebug() << obj << modeType << "(" << _proxyMode << ")" << funcname;
+    // qDebug() << obj << modeType << "(" << _proxyMode << ")" << callSite.slotName();
     if (modeType != _proxyMode)
         return;
 
     ExtendedMetaObject *eMeta = extendedMetaObject(obj);
 
+    int methodId = callSite.metaObject() == eMeta->metaObject()
+                   ? callSite.methodId()
+                   : eMeta->methodId(callSite.slotName());
+
     QVariantList params;
 
-    const QList<int> &argTypes = eMeta->argTypes(eMeta->methodId(QByteArray(funcname)));
+    const QList<int> &argTypes = eMeta->argTypes(methodId);
 
     for (int i = 0; i < argTypes.size(); i++) {
         if (argTypes[i] == 0) {
-            qWarning() << Q_FUNC_INFO << "received invalid data for argument number" << i << "of signal" << QString("%1::%2").arg(eMeta->metaObject()->className()).arg(funcname);
+            qWarning() << Q_FUNC_INFO << "received invalid data for argument number" << i << "of signal" << QString("%1::%2").arg(eMeta->metaObject()->className()).arg(callSite.slotName().constData());
             qWarning() << "        - make sure all your data types are known by the Qt MetaSystem";
             return;
         }
-        params << QVariant(argTypes[i], va_arg(ap, void *));
+        params << QVariant(argTypes[i], argv[i]);
     }
 
     if (argTypes.size() >= 1 && argTypes[0] == qMetaTypeId<PeerPtr>() && proxyMode() == SignalProxy::Server) {
         Peer *peer = params[0].value<PeerPtr>();
-        dispatch(peer, SyncMessage(eMeta->metaObject()->className(), obj->objectName(), QByteArray(funcname), params));
+        dispatchSync(peer, SyncMessage(eMeta->metaObject()->className(), obj->objectName(), callSite.slotName(), params));
     } else
-        dispatch(SyncMessage(eMeta->metaObject()->className(), obj->objectName(), QByteArray(funcname), params));
+        dispatchSync(SyncMessage(eMeta->metaObject()->className(), obj->objectName(), callSite.slotName(), params));
 }
 
 
@@ -794,6 +917,16 @@ void SignalProxy::dumpProxyStats()
     qDebug() << "          attached Slots:" << _attachedSlots.count();
     qDebug() << " number of synced Slaves:" << slaveCount;
     qDebug() << "number of Classes cached:" << _extendedMetaObjects.count();
+
+    int queuedSyncCount = 0;
+    foreach(const SyncQueue &queue, _syncQueues)
+        queuedSyncCount += queue.messages.count();
+    qDebug() << "    queued sync messages:" << queuedSyncCount;
+
+    foreach(Peer *peer, _peers) {
+        if (peer->metrics())
+            qDebug() << "            peer metrics:" << peer->metrics()->toVariantMap();
+    }
 }
 
 
@@ -816,29 +949,36 @@ void SignalProxy::updateSecureState()
 // ==================================================
 SignalProxy::ExtendedMetaObject::ExtendedMetaObject(const QMetaObject *meta, bool checkConflicts)
     : _meta(meta),
-    _updatedRemotelyId(_meta->indexOfSignal("updatedRemotely()"))
+    _updatedRemotelyId(_meta->indexOfSignal("updatedRemotely()")),
+    _methodIds(syncMethodIds(meta, checkConflicts))
 {
-    for (int i = 0; i < _meta->methodCount(); i++) {
-        if (_meta->method(i).methodType() != QMetaMethod::Slot)
+}
+
+
+QHash<QByteArray, int> SignalProxy::ExtendedMetaObject::syncMethodIds(const QMetaObject *meta, bool checkConflicts)
+{
+    QHash<QByteArray, int> methodIds;
+    for (int i = 0; i < meta->methodCount(); i++) {
+        if (meta->method(i).methodType() != QMetaMethod::Slot)
             continue;
 
 #if QT_VERSION >= 0x050000
-        if (_meta->method(i).methodSignature().contains('*'))
+        if (meta->method(i).methodSignature().contains('*'))
 #else
-        if (QByteArray(_meta->method(i).signature()).contains('*'))
+        if (QByteArray(meta->method(i).signature()).contains('*'))
 #endif
             continue;  // skip methods with ptr params
 
-        QByteArray method = methodName(_meta->method(i));
+        QByteArray method = methodName(meta->method(i));
         if (method.startsWith("init"))
             continue;  // skip initializers
 
-        if (_methodIds.contains(method)) {
+        if (methodIds.contains(method)) {
             /* funny... moc creates for methods containing default parameters multiple metaMethod with separate methodIds.
                we don't care... we just need the full fledged version
              */
-            const QMetaMethod &current = _meta->method(_methodIds[method]);
-            const QMetaMethod &candidate = _meta->method(i);
+            const QMetaMethod &current = meta->method(methodIds[method]);
+            const QMetaMethod &candidate = meta->method(i);
             if (current.parameterTypes().count() > candidate.parameterTypes().count()) {
                 int minCount = candidate.parameterTypes().count();
                 QList<QByteArray> commonParams = current.parameterTypes().mid(0, minCount);
@@ -849,22 +989,23 @@ SignalProxy::ExtendedMetaObject::ExtendedMetaObject(const QMetaObject *meta, boo
                 int minCount = current.parameterTypes().count();
                 QList<QByteArray> commonParams = candidate.parameterTypes().mid(0, minCount);
                 if (commonParams == current.parameterTypes()) {
-                    _methodIds[method] = i; // use the new one
+                    methodIds[method] = i; // use the new one
                     continue;
                 }
             }
             if (checkConflicts) {
                 qWarning() << "class" << meta->className() << "contains overloaded methods which is currently not supported!";
 #if QT_VERSION >= 0x050000
-                qWarning() << " - " << _meta->method(i).methodSignature() << "conflicts with" << _meta->method(_methodIds[method]).methodSignature();
+                qWarning() << " - " << meta->method(i).methodSignature() << "conflicts with" << meta->method(methodIds[method]).methodSignature();
 #else
-                qWarning() << " - " << _meta->method(i).signature() << "conflicts with" << _meta->method(_methodIds[method]).signature();
+                qWarning() << " - " << meta->method(i).signature() << "conflicts with" << meta->method(methodIds[method]).signature();
 #endif
             }
             continue;
         }
-        _methodIds[method] = i;
+        methodIds[method] = i;
     }
+    return methodIds;
 }
 
 
@@ -977,6 +1118,17 @@ QString SignalProxy::ExtendedMetaObject::methodBaseName(const QMetaMethod &metho
 }
 
 
+// ==================================================
+//  SyncCallSite
+// ==================================================
+SignalProxy::SyncCallSite::SyncCallSite(const QMetaObject *meta, const char *funcname)
+    : _meta(meta),
+    _slotName(funcname),
+    _methodId(ExtendedMetaObject::syncMethodIds(meta).value(_slotName, -1))
+{
+}
+
+
 SignalProxy::ExtendedMetaObject::MethodDescriptor::MethodDescriptor(const QMetaMethod &method)
     : _methodName(SignalProxy::ExtendedMetaObject::methodName(method)),
     _returnType(QMetaType::type(method.typeName()))
@@ -28,6 +28,7 @@
 
 struct QMetaObject;
 class QIODevice;
+class QTimer;
 
 class Peer;
 class SyncableObject;
@@ -60,15 +61,29 @@ public:
     void setMaxHeartBeatCount(int max);
     inline int maxHeartBeatCount() const { return _maxHeartBeatCount; }
 
+    //! Delay outgoing sync calls by up to \a msecs in order to coalesce them per peer.
+    /** Within that window, a later call to a setter (a slot named set*) on the same object supersedes
+     *  earlier ones with the same leading arguments, and everything that's left is written as one batch.
+     *  A value of 0 (the default) disables coalescing.
+     */
+    void setSyncCoalescingInterval(int msecs);
+    inline int syncCoalescingInterval() const { return _syncCoalescingInterval; }
+
     bool addPeer(Peer *peer);
 
     bool attachSignal(QObject *sender, const char *signal, const QByteArray &sigName = QByteArray());
     bool attachSlot(const QByteArray &sigName, QObject *recv, const char *slot);
 
-    void synchronize(SyncableObject *obj);
+    //! Start synchronizing the given object
+    /** In client mode, the initial state of the object is requested right away, unless \a deferInit is set.
+     *  In the latter case, it is up to the user of the object to call SyncableObject::requestInit() once its
+     *  state is actually needed.
+     */
+    void synchronize(SyncableObject *obj, bool deferInit = false);
     void stopSynchronize(SyncableObject *obj);
 
     class ExtendedMetaObject;
+    class SyncCallSite;
     ExtendedMetaObject *extendedMetaObject(const QMetaObject *meta) const;
     ExtendedMetaObject *createExtendedMetaObject(const QMetaObject *meta, bool checkConflicts = false);
     inline ExtendedMetaObject *extendedMetaObject(const QObject *obj) const { return extendedMetaObject(metaObject(obj)); }
@@ -78,6 +93,10 @@ public:
     void dumpProxyStats();
     void dumpSyncMap(SyncableObject *object);
     inline int peerCount() const { return _peers.size(); }
+    inline QSet<Peer *> peers() const { return _peers; }
+
+    //! The peer whose request is currently being handled, if any
+    inline Peer *sourcePeer() const { return _sourcePeer; }
 
 public slots:
     void detachObject(QObject *obj);
@@ -86,13 +105,14 @@ public slots:
 
 protected:
     void customEvent(QEvent *event);
-    void sync_call__(const SyncableObject *obj, ProxyMode modeType, const char *funcname, va_list ap);
+    void sync_call__(const SyncableObject *obj, ProxyMode modeType, const SyncCallSite &callSite, void **argv);
     void renameObject(const SyncableObject *obj, const QString &newname, const QString &oldname);
 
 private slots:
     void removePeerBySender();
     void objectRenamed(const QByteArray &classname, const QString &newname, const QString &oldname);
     void updateSecureState();
+    void flushSyncQueues();
 
 signals:
     void peerRemoved(Peer *peer);
@@ -122,6 +142,11 @@ private:
     template<class T>
     void dispatch(Peer *peer, const T &protoMessage);
 
+    void dispatchSync(const Protocol::SyncMessage &syncMessage);
+    void dispatchSync(Peer *peer, const Protocol::SyncMessage &syncMessage);
+    void queueSyncMessage(Peer *peer, const Protocol::SyncMessage &syncMessage);
+    void flushSyncQueue(Peer *peer);
+
     void handle(Peer *peer, const Protocol::SyncMessage &syncMessage);
     void handle(Peer *peer, const Protocol::RpcCall &rpcCall);
     void handle(Peer *peer, const Protocol::InitRequest &initRequest);
@@ -140,6 +165,7 @@ private:
     static void disconnectDevice(QIODevice *dev, const QString &reason = QString());
 
     QSet<Peer *> _peers;
+    Peer *_sourcePeer;
 
     // containg a list of argtypes for fast access
     QHash<const QMetaObject *, ExtendedMetaObject *> _extendedMetaObjects;
@@ -156,6 +182,15 @@ private:
     typedef QHash<QString, SyncableObject *> ObjectId;
     QHash<QByteArray, ObjectId> _syncSlave;
 
+    // sync calls waiting to be coalesced, per peer
+    struct SyncQueue {
+        QList<Protocol::SyncMessage> messages;
+        QHash<QByteArray, int> setterIndex; // setter key -> position of the latest call in messages
+    };
+    QHash<Peer *, SyncQueue> _syncQueues;
+    QTimer *_syncCoalescingTimer;
+    int _syncCoalescingInterval;
+
     ProxyMode _proxyMode;
     int _heartBeatInterval;
     int _maxHeartBeatCount;
@@ -215,6 +250,9 @@ public:
     static QByteArray methodName(const QMetaMethod &method);
     static QString methodBaseName(const QMetaMethod &method);
 
+    //! Maps the names of all sync slots of \a meta to their method IDs
+    static QHash<QByteArray, int> syncMethodIds(const QMetaObject *meta, bool checkConflicts = false);
+
 private:
     const MethodDescriptor &methodDescriptor(int methodId);
 
@@ -226,4 +264,28 @@ private:
     QHash<int, int> _receiveMap; // if slot x is called then hand over the result to slot y
 };
 
+
+// ==================================================
+//  SyncCallSite
+// ==================================================
+//! Holds what we need to know about a particular SYNC() or REQUEST() call
+/** Each call site creates one of these as a function-local static, so the name lookup of the synced slot
+ *  only happens once rather than for every call. The method ID is only valid for \a meta; calls from objects
+ *  with a different sync meta object (e.g. in SyncableObject::update()) fall back to looking up the slot name.
+ */
+class SignalProxy::SyncCallSite
+{
+public:
+    SyncCallSite(const QMetaObject *meta, const char *funcname);
+
+    inline const QMetaObject *metaObject() const { return _meta; }
+    inline const QByteArray &slotName() const { return _slotName; }
+    inline int methodId() const { return _methodId; }
+
+private:
+    const QMetaObject *_meta;
+    QByteArray _slotName;
+    int _methodId;
+};
+
 #endif
@@ -31,6 +31,7 @@ INIT_SYNCABLE_OBJECT(SyncableObject)
 SyncableObject::SyncableObject(QObject *parent)
     : QObject(parent),
     _initialized(false),
+    _initRequested(false),
     _allowClientUpdates(false)
 {
 }
@@ -39,6 +40,7 @@ SyncableObject::SyncableObject(QObject *parent)
 SyncableObject::SyncableObject(const QString &objectName, QObject *parent)
     : QObject(parent),
     _initialized(false),
+    _initRequested(false),
     _allowClientUpdates(false)
 {
     setObjectName(objectName);
@@ -48,6 +50,7 @@ SyncableObject::SyncableObject(const QString &objectName, QObject *parent)
 SyncableObject::SyncableObject(const SyncableObject &other, QObject *parent)
     : QObject(parent),
     _initialized(other._initialized),
+    _initRequested(false),
     _allowClientUpdates(other._allowClientUpdates)
 {
 }
@@ -88,6 +91,18 @@ void SyncableObject::setInitialized()
 }
 
 
+void SyncableObject::requestInit()
+{
+    if (_initialized || _initRequested)
+        return;
+
+    _initRequested = true;
+    foreach(SignalProxy *proxy, _signalProxies) {
+        proxy->requestInit(this);
+    }
+}
+
+
 QVariantMap SyncableObject::toVariantMap()
 {
     QVariantMap properties;
@@ -206,18 +221,6 @@ void SyncableObject::requestUpdate(const QVariantMap &properties)
 }
 
 
-void SyncableObject::sync_call__(SignalProxy::ProxyMode modeType, const char *funcname, ...) const
-{
-    //qDebug() << Q_FUNC_INFO << modeType << funcname;
-    foreach(SignalProxy *proxy, _signalProxies) {
-        va_list ap;
-        va_start(ap, funcname);
-        proxy->sync_call__(this, modeType, funcname, ap);
-        va_end(ap);
-    }
-}
-
-
 void SyncableObject::synchronize(SignalProxy *proxy)
 {
     if (_signalProxies.contains(proxy))
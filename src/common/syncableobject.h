@@ -31,18 +31,21 @@
 #define SYNCABLE_OBJECT static const int _classNameOffset__;
 #define INIT_SYNCABLE_OBJECT(x) const int x ::_classNameOffset__ = QByteArray(staticMetaObject.className()).length() + 2;
 
+// Every call site looks up its sync method only once, see SignalProxy::SyncCallSite
+#define SYNC_CALL__(mode, funcname, ...) { static const SignalProxy::SyncCallSite syncCallSite__(syncMetaObject(), funcname); sync_call__(mode, syncCallSite__, __VA_ARGS__); }
+
 #ifdef Q_CC_MSVC
-#    define SYNC(...) sync_call__(SignalProxy::Server, (__FUNCTION__ + _classNameOffset__), __VA_ARGS__);
-#    define REQUEST(...) sync_call__(SignalProxy::Client, (__FUNCTION__ + _classNameOffset__), __VA_ARGS__);
+#    define SYNC(...) SYNC_CALL__(SignalProxy::Server, (__FUNCTION__ + _classNameOffset__), __VA_ARGS__)
+#    define REQUEST(...) SYNC_CALL__(SignalProxy::Client, (__FUNCTION__ + _classNameOffset__), __VA_ARGS__)
 #else
-#    define SYNC(...) sync_call__(SignalProxy::Server, __func__, __VA_ARGS__);
-#    define REQUEST(...) sync_call__(SignalProxy::Client, __func__, __VA_ARGS__);
+#    define SYNC(...) SYNC_CALL__(SignalProxy::Server, __func__, __VA_ARGS__)
+#    define REQUEST(...) SYNC_CALL__(SignalProxy::Client, __func__, __VA_ARGS__)
 #endif //Q_CC_MSVC
 
-#define SYNC_OTHER(x, ...) sync_call__(SignalProxy::Server, #x, __VA_ARGS__);
-#define REQUEST_OTHER(x, ...) sync_call__(SignalProxy::Client, #x, __VA_ARGS__);
+#define SYNC_OTHER(x, ...) SYNC_CALL__(SignalProxy::Server, #x, __VA_ARGS__)
+#define REQUEST_OTHER(x, ...) SYNC_CALL__(SignalProxy::Client, #x, __VA_ARGS__)
 
-#define ARG(x) const_cast<void *>(reinterpret_cast<const void *>(&x))
+#define ARG(x) x
 #define NO_ARG 0
 
 class SyncableObject : public QObject
@@ -78,6 +81,12 @@ public:
 
     virtual const QMetaObject *syncMetaObject() const { return metaObject(); }
 
+    //! Request the object's state from the remote side, unless we already have it
+    /** Only needed for objects that have been synchronized with deferred initialization.
+     *  \sa SignalProxy::synchronize()
+     */
+    void requestInit();
+
     inline void setAllowClientUpdates(bool allow) { _allowClientUpdates = allow; }
     inline bool allowClientUpdates() const { return _allowClientUpdates; }
 
@@ -87,7 +96,18 @@ public slots:
     virtual void update(const QVariantMap &properties);
 
 protected:
-    void sync_call__(SignalProxy::ProxyMode modeType, const char *funcname, ...) const;
+    //! Sends a sync call to all attached SignalProxies; used by the SYNC() and REQUEST() macros
+    /** The arguments are passed by address, and interpreted according to the parameter types of the
+     *  synced slot. Surplus arguments (such as NO_ARG) are ignored.
+     */
+    template<typename... Args>
+    void sync_call__(SignalProxy::ProxyMode modeType, const SignalProxy::SyncCallSite &callSite, const Args &... args) const
+    {
+        void *argv[] = { const_cast<void *>(static_cast<const void *>(&args))..., 0 };
+        foreach(SignalProxy *proxy, _signalProxies) {
+            proxy->sync_call__(this, modeType, callSite, argv);
+        }
+    }
 
     void renameObject(const QString &newName);
     SyncableObject &operator=(const SyncableObject &other);
@@ -104,6 +124,7 @@ private:
     bool setInitValue(const QString &property, const QVariant &value);
 
     bool _initialized;
+    bool _initRequested;
     bool _allowClientUpdates;
 
     QList<SignalProxy *> _signalProxies;
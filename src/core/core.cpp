@@ -26,6 +26,7 @@
 #include "coresettings.h"
 #include "logger.h"
 #include "internalpeer.h"
+#include "metricsserver.h"
 #include "network.h"
 #include "postgresqlstorage.h"
 #include "quassel.h"
@@ -213,6 +214,9 @@ void Core::init()
 
     if (Quassel::isOptionSet("oidentd"))
         _oidentdConfigGenerator = new OidentdConfigGenerator(this);
+
+    if (Quassel::isOptionSet("metrics-port"))
+        new MetricsServer(Quassel::optionValue("metrics-port").toUShort(), this);
 }
 
 
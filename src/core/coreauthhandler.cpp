@@ -171,6 +171,8 @@ void CoreAuthHandler::handle(const RegisterClient &msg)
         return;
     }
 
+    _peer->setFeatures(Quassel::Features(msg.clientFeatures));
+
     QVariantList backends;
     bool configured = Core::isConfigured();
     if (!configured)
@@ -29,6 +29,8 @@ CoreBacklogManager::CoreBacklogManager(CoreSession *coreSession)
     : BacklogManager(coreSession),
     _coreSession(coreSession)
 {
+    _chunkTimer.setInterval(0);
+    connect(&_chunkTimer, SIGNAL(timeout()), this, SLOT(sendNextBacklogChunk()));
 }
 
 
@@ -115,3 +117,79 @@ QVariantList CoreBacklogManager::requestBacklogAll(MsgId first, MsgId last, int
 
     return backlog;
 }
+
+
+// Chunked requests are queued and served one chunk per event loop iteration, in the order they arrived.
+// Clients request the buffer they're showing first, so its backlog arrives before everything else.
+void CoreBacklogManager::requestBacklogChunked(PeerPtr peer, BufferId bufferId, MsgId first, MsgId last, int limit, int additional)
+{
+    ChunkedBacklogRequest request;
+    request.peer = peer;
+    request.bufferId = bufferId;
+    request.first = first;
+    request.last = last;
+    request.remaining = limit;
+    request.additional = limit != 0 ? additional : 0;
+    request.sendingAdditional = false;
+    _chunkedRequests << request;
+
+    if (!_chunkTimer.isActive())
+        _chunkTimer.start();
+}
+
+
+void CoreBacklogManager::sendNextBacklogChunk()
+{
+    // drop requests of clients that have gone away in the meantime
+    while (!_chunkedRequests.isEmpty() && !_chunkedRequests.first().peer)
+        _chunkedRequests.removeFirst();
+
+    if (_chunkedRequests.isEmpty()) {
+        _chunkTimer.stop();
+        return;
+    }
+
+    ChunkedBacklogRequest &request = _chunkedRequests.first();
+    int limit = request.remaining < 0 ? backlogChunkSize : qMin(request.remaining, backlogChunkSize);
+
+    QList<Message> msgList;
+    if (limit > 0)
+        msgList = Core::requestMsgs(coreSession()->user(), request.bufferId, request.first, request.last, limit);
+
+    QVariantList backlog;
+    QList<Message>::const_iterator msgIter = msgList.constBegin();
+    QList<Message>::const_iterator msgListEnd = msgList.constEnd();
+    while (msgIter != msgListEnd) {
+        backlog << qVariantFromValue(*msgIter);
+        ++msgIter;
+    }
+
+    if (!msgList.isEmpty()) {
+        request.last = qMin(msgList.first().msgId(), msgList.last().msgId());
+        request.oldestSent = request.last;
+    }
+    if (request.remaining > 0)
+        request.remaining -= msgList.count();
+
+    bool last = msgList.count() < limit || request.remaining == 0;
+
+    if (last && !request.sendingAdditional && request.additional) {
+        // same rule as in requestBacklog(): additional messages are only sent if they continue seamlessly
+        MsgId oldestMessage = request.oldestSent.isValid() ? request.oldestSent : request.first;
+        MsgId additionalLast = request.first != -1 ? request.first : oldestMessage;
+        if (additionalLast == oldestMessage) {
+            request.first = -1;
+            request.last = additionalLast;
+            request.remaining = request.additional;
+            request.sendingAdditional = true;
+            last = false;
+        }
+    }
+
+    PeerPtr peer = request.peer;
+    BufferId bufferId = request.bufferId;
+    if (last)
+        _chunkedRequests.removeFirst();
+
+    SYNC_OTHER(receiveBacklogChunk, ARG(peer), ARG(bufferId), ARG(backlog), ARG(last))
+}
@@ -21,6 +21,9 @@
 #ifndef COREBACKLOGMANAGER_H
 #define COREBACKLOGMANAGER_H
 
+#include <QPointer>
+#include <QTimer>
+
 #include "backlogmanager.h"
 
 class CoreSession;
@@ -38,9 +41,29 @@ public:
 public slots:
     virtual QVariantList requestBacklog(BufferId bufferId, MsgId first = -1, MsgId last = -1, int limit = -1, int additional = 0);
     virtual QVariantList requestBacklogAll(MsgId first = -1, MsgId last = -1, int limit = -1, int additional = 0);
+    virtual void requestBacklogChunked(PeerPtr peer, BufferId bufferId, MsgId first = -1, MsgId last = -1, int limit = -1, int additional = 0);
+
+private slots:
+    void sendNextBacklogChunk();
 
 private:
+    //! Number of messages read from storage and sent per chunk
+    static const int backlogChunkSize = 500;
+
+    struct ChunkedBacklogRequest {
+        QPointer<Peer> peer;
+        BufferId bufferId;
+        MsgId first;
+        MsgId last;         //!< exclusive upper bound of the next chunk, -1 while starting at the newest message
+        MsgId oldestSent;
+        int remaining;      //!< messages left in the current phase, -1 for no limit
+        int additional;
+        bool sendingAdditional;
+    };
+
     CoreSession *_coreSession;
+    QList<ChunkedBacklogRequest> _chunkedRequests;
+    QTimer _chunkTimer;
 };
 
 
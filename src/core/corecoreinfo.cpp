@@ -22,6 +22,8 @@
 
 #include "core.h"
 #include "coresession.h"
+#include "peer.h"
+#include "peermetrics.h"
 #include "quassel.h"
 #include "signalproxy.h"
 
@@ -40,5 +42,12 @@ QVariantMap CoreCoreInfo::coreData() const
     data["quasselBuildDate"] = Quassel::buildInfo().commitDate; // "BuildDate" for compatibility
     data["startTime"] = Core::instance()->startTime();
     data["sessionConnectedClients"] = _coreSession->signalProxy()->peerCount();
+
+    QVariantList peerMetrics;
+    foreach(Peer *peer, _coreSession->signalProxy()->peers()) {
+        if (peer->metrics())
+            peerMetrics << peer->metrics()->toVariantMap();
+    }
+    data["peerMetrics"] = peerMetrics;
     return data;
 }
@@ -80,6 +80,7 @@ CoreSession::CoreSession(UserId uid, bool restoreState, QObject *parent)
     SignalProxy *p = signalProxy();
     p->setHeartBeatInterval(30);
     p->setMaxHeartBeatCount(60); // 30 mins until we throw a dead socket out
+    p->setSyncCoalescingInterval(50); // coalesce property storms (e.g. /who replies) into batches
 
     connect(p, SIGNAL(peerRemoved(Peer*)), SLOT(removeClient(Peer*)));
 
@@ -0,0 +1,99 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2016 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <QHostAddress>
+#include <QTcpSocket>
+
+#include "metricsserver.h"
+
+#include "logger.h"
+#include "peermetrics.h"
+
+MetricsServer::MetricsServer(quint16 port, QObject *parent)
+    : QTcpServer(parent)
+{
+    connect(this, SIGNAL(newConnection()), SLOT(onNewConnection()));
+
+    if (listen(QHostAddress::LocalHost, port))
+        quInfo() << qPrintable(tr("Serving peer metrics on %1:%2").arg(serverAddress().toString()).arg(serverPort()));
+    else
+        quWarning() << qPrintable(tr("Could not open port %1 for peer metrics: %2").arg(port).arg(errorString()));
+}
+
+
+void MetricsServer::onNewConnection()
+{
+    while (hasPendingConnections()) {
+        QTcpSocket *socket = nextPendingConnection();
+        connect(socket, SIGNAL(readyRead()), SLOT(onReadyRead()));
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+    }
+}
+
+
+void MetricsServer::onReadyRead()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    if (!socket)
+        return;
+
+    // We don't care about the request itself, just wait for the end of its header
+    if (!socket->canReadLine())
+        return;
+    socket->readAll();
+
+    QByteArray body = metricsText();
+    QByteArray response = "HTTP/1.0 200 OK\r\n"
+                          "Content-Type: text/plain; version=0.0.4\r\n"
+                          "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                          "Connection: close\r\n\r\n";
+    socket->disconnect(this);
+    socket->write(response + body);
+    socket->disconnectFromHost();
+}
+
+
+QByteArray MetricsServer::metricsText()
+{
+    static const char *counters[] = {
+        "rawBytesIn", "wireBytesIn", "rawBytesOut", "wireBytesOut",
+        "deserializationMsecs", "serializationMsecs",
+        "roundTripP50", "roundTripP90", "roundTripP99"
+    };
+
+    QByteArray text;
+    foreach(const QVariant &variant, PeerMetrics::snapshots()) {
+        QVariantMap metrics = variant.toMap();
+        QByteArray peer = metrics["description"].toString().toUtf8();
+        QByteArray label = "{peer=\"" + peer + "\"}";
+
+        for (size_t i = 0; i < sizeof(counters)/sizeof(counters[0]); ++i)
+            text += QByteArray("quassel_peer_") + counters[i] + label + ' ' + metrics[counters[i]].toByteArray() + '\n';
+
+        QVariantMap framesIn = metrics["framesIn"].toMap();
+        for (QVariantMap::const_iterator it = framesIn.constBegin(); it != framesIn.constEnd(); ++it)
+            text += "quassel_peer_framesIn{peer=\"" + peer + "\",type=\"" + it.key().toUtf8() + "\"} " + it.value().toByteArray() + '\n';
+
+        QVariantMap framesOut = metrics["framesOut"].toMap();
+        for (QVariantMap::const_iterator it = framesOut.constBegin(); it != framesOut.constEnd(); ++it)
+            text += "quassel_peer_framesOut{peer=\"" + peer + "\",type=\"" + it.key().toUtf8() + "\"} " + it.value().toByteArray() + '\n';
+    }
+    return text;
+}
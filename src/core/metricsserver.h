@@ -18,33 +18,31 @@
  *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
  ***************************************************************************/
 
-#ifndef NICKVIEWFILTER_H
-#define NICKVIEWFILTER_H
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
 
-#include <QSortFilterProxyModel>
+#include <QTcpServer>
 
-#include "types.h"
+class QTcpSocket;
 
-class NetworkModel;
-
-// This is proxymodel is purely for the sorting right now
-class NickViewFilter : public QSortFilterProxyModel
+//! Serves the traffic statistics of all connected peers as plain text
+/** The server only listens on the loopback interface. Any request is answered with a minimal
+ *  HTTP response containing one line per metric (in the Prometheus text format), after which
+ *  the connection is closed.
+ */
+class MetricsServer : public QTcpServer
 {
     Q_OBJECT
 
 public:
-    NickViewFilter(const BufferId &bufferId, NetworkModel *parent = 0);
-
-    virtual QVariant data(const QModelIndex &index, int role) const;
-    QVariant icon(const QModelIndex &index) const;
+    MetricsServer(quint16 port, QObject *parent = 0);
 
-protected:
-    virtual bool filterAcceptsRow(int source_row, const QModelIndex &source_parent) const;
-    QVariant styleData(const QModelIndex &index, int role) const;
+private slots:
+    void onNewConnection();
+    void onReadyRead();
 
 private:
-    BufferId _bufferId;
+    static QByteArray metricsText();
 };
 
-
 #endif
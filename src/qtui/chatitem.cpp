@@ -127,13 +127,38 @@ QTextLayout *ChatItem::layout() const
     if (_cachedLayout)
         return _cachedLayout;
 
-    _cachedLayout = new QTextLayout;
-    initLayout(_cachedLayout);
+    _cachedLayout = ChatLayoutService::instance()->takeLayout(layoutKey());
+    if (!_cachedLayout) {
+        _cachedLayout = new QTextLayout;
+        initLayout(_cachedLayout);
+    }
     chatView()->setHasCache(chatLine());
     return _cachedLayout;
 }
 
 
+ChatLayoutService::LayoutKey ChatItem::layoutKey() const
+{
+    ChatLayoutService::LayoutKey key;
+    key.msgId = data(MessageModel::MsgIdRole).value<MsgId>();
+    key.column = column();
+    key.width = qRound64(width() * 64);
+    key.textHash = qHash(data(MessageModel::DisplayRole).toString());
+    key.messageLabel = data(ChatLineModel::MsgLabelRole).toUInt();
+    return key;
+}
+
+
+void ChatItem::releaseLayout()
+{
+    if (!_cachedLayout)
+        return;
+
+    ChatLayoutService::instance()->storeLayout(layoutKey(), _cachedLayout);
+    _cachedLayout = 0;
+}
+
+
 void ChatItem::clearCache()
 {
     delete _cachedLayout;
@@ -402,18 +427,24 @@ QList<QRectF> ChatItem::findWords(const QString &searchWord, Qt::CaseSensitivity
     }
 
     foreach(int idx, indexList) {
-        QTextLine line = layout()->lineForTextPosition(idx);
-        qreal x = line.cursorToX(idx);
-        qreal width = line.cursorToX(idx + searchWord.count()) - x;
-        qreal height = line.height();
-        qreal y = height * line.lineNumber();
-        resultList << QRectF(x, y, width, height);
+        resultList << textRect(idx, searchWord.count());
     }
 
     return resultList;
 }
 
 
+QRectF ChatItem::textRect(int start, int length) const
+{
+    QTextLine line = layout()->lineForTextPosition(start);
+    qreal x = line.cursorToX(start);
+    qreal width = line.cursorToX(start + length) - x;
+    qreal height = line.height();
+    qreal y = height * line.lineNumber();
+    return QRectF(x, y, width, height);
+}
+
+
 void ChatItem::handleClick(const QPointF &pos, ChatScene::ClickMode clickMode)
 {
     // single clicks are already handled by the scene (for clearing the selection)
@@ -589,7 +620,7 @@ ContentsChatItemPrivate *ContentsChatItem::privateData() const
 {
     if (!_data) {
         ContentsChatItem *that = const_cast<ContentsChatItem *>(this);
-        that->_data = new ContentsChatItemPrivate(ClickableList::fromString(data(ChatLineModel::DisplayRole).toString()), that);
+        that->_data = new ContentsChatItemPrivate(data(ChatLineModel::ClickableListRole).value<ClickableList>(), that);
     }
     return _data;
 }
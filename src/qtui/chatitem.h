@@ -24,6 +24,7 @@
 #include <QAction>
 #include <QObject>
 
+#include "chatlayoutservice.h"
 #include "chatlinemodel.h"
 #include "chatscene.h"
 #include "clickable.h"
@@ -80,6 +81,8 @@ public:
     bool isPosOverSelection(const QPointF &pos) const;
 
     QList<QRectF> findWords(const QString &searchWord, Qt::CaseSensitivity caseSensitive);
+    //! The rect (relative to the item) covering length characters from start, which must be on a single line
+    QRectF textRect(int start, int length) const;
 
     virtual void addActionsToMenu(QMenu *menu, const QPointF &itemPos);
     virtual void handleClick(const QPointF &pos, ChatScene::ClickMode);
@@ -91,6 +94,12 @@ public:
      */
     virtual void clearCache();
 
+    //! Hands the cached QTextLayout over to ChatLayoutService
+    /** Unlike clearCache(), this keeps the layout around for a while, so it can be reused if the item
+     *  becomes visible again. Only call this while the item's row is still in the model.
+     */
+    void releaseLayout();
+
 protected:
     enum SelectionMode {
         NoSelection,
@@ -106,6 +115,7 @@ protected:
     virtual void hoverMoveEvent(QGraphicsSceneHoverEvent *) {}
 
     QTextLayout *layout() const;
+    ChatLayoutService::LayoutKey layoutKey() const;
 
     virtual void initLayout(QTextLayout *layout) const;
     virtual void doLayout(QTextLayout *) const;
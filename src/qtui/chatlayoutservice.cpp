@@ -0,0 +1,230 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2016 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "chatlayoutservice.h"
+
+#include <QAbstractProxyModel>
+#include <QCoreApplication>
+#include <QEvent>
+#include <QPointer>
+#include <QRunnable>
+#include <QThread>
+
+#include "qtui.h"
+#include "qtuistyle.h"
+
+// Number of messages handled by a single worker job
+const int wrapListBatchSize = 50;
+// We don't queue more than this, so scrolling quickly through a huge buffer doesn't pile up work nobody needs anymore
+const int maxPendingMessages = 2000;
+// Number of ChatItem layouts we keep for reuse
+const int maxCachedLayouts = 1000;
+
+struct WrapListEntry {
+    MsgId msgId;
+    QString text;
+    QList<QTextLayout::FormatRange> formatRanges;
+    ChatLineModel::WrapList wrapList;
+};
+
+
+class WrapListBatchEvent : public QEvent
+{
+public:
+    WrapListBatchEvent(ChatLineModel *model, quint64 styleGeneration, const QList<WrapListEntry> &entries)
+        : QEvent(QEvent::User), model(model), styleGeneration(styleGeneration), entries(entries) {}
+
+    QPointer<ChatLineModel> model;
+    quint64 styleGeneration;
+    QList<WrapListEntry> entries;
+};
+
+
+//! Computes the wrap lists for a batch of messages in a worker thread
+/** The text and formats are gathered in the GUI thread, since UiStyle's format cache isn't thread-safe.
+ */
+class ChatLayoutService::WrapListJob : public QRunnable
+{
+public:
+    WrapListJob(ChatLayoutService *service, ChatLineModel *model, quint64 styleGeneration, const QList<WrapListEntry> &entries)
+        : _service(service),
+        _model(model),
+        _styleGeneration(styleGeneration),
+        _entries(entries)
+    {
+    }
+
+    void run()
+    {
+        QList<WrapListEntry>::iterator iter = _entries.begin();
+        while (iter != _entries.end()) {
+            iter->wrapList = ChatLineModelItem::computeWrapList(iter->text, iter->formatRanges);
+            iter->formatRanges.clear();
+            ++iter;
+        }
+        QCoreApplication::postEvent(_service, new WrapListBatchEvent(_model, _styleGeneration, _entries));
+    }
+
+private:
+    ChatLayoutService *_service;
+    ChatLineModel *_model;
+    quint64 _styleGeneration;
+    QList<WrapListEntry> _entries;
+};
+
+
+ChatLayoutService *ChatLayoutService::_instance = 0;
+
+ChatLayoutService *ChatLayoutService::instance()
+{
+    if (!_instance)
+        _instance = new ChatLayoutService(QCoreApplication::instance());
+    return _instance;
+}
+
+
+ChatLayoutService::ChatLayoutService(QObject *parent)
+    : QObject(parent),
+    _styleGeneration(0),
+    _layoutCache(maxCachedLayouts)
+{
+    // leave a core for the GUI thread
+    _threadPool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+
+    connect(QtUi::style(), SIGNAL(changed()), SLOT(styleChanged()));
+}
+
+
+ChatLayoutService::~ChatLayoutService()
+{
+    // running jobs post their results to us
+    _threadPool.waitForDone();
+    _instance = 0;
+}
+
+
+// Maps row through the proxy models on top of the ChatLineModel
+const ChatLineModel *ChatLayoutService::sourceModel(const QAbstractItemModel *model, int *row) const
+{
+    QModelIndex index = model->index(*row, ChatLineModel::ContentsColumn);
+    const QAbstractProxyModel *proxyModel;
+    while ((proxyModel = qobject_cast<const QAbstractProxyModel *>(index.model())))
+        index = proxyModel->mapToSource(index);
+
+    *row = index.row();
+    return qobject_cast<const ChatLineModel *>(index.model());
+}
+
+
+bool ChatLayoutService::hasWrapList(const QAbstractItemModel *model, int row) const
+{
+    const ChatLineModel *chatLineModel = sourceModel(model, &row);
+    // we can't do anything about other models, so don't make anyone wait for us
+    return !chatLineModel || chatLineModel->hasWrapList(row);
+}
+
+
+void ChatLayoutService::prefetch(const QAbstractItemModel *model, int start, int end)
+{
+    start = qMax(start, 0);
+    end = qMin(end, model->rowCount() - 1);
+
+    ChatLineModel *chatLineModel = 0;
+    QList<WrapListEntry> batch;
+    for (int row = start; row <= end && _pendingMsgIds.count() < maxPendingMessages; row++) {
+        int sourceRow = row;
+        const ChatLineModel *source = sourceModel(model, &sourceRow);
+        if (!source || source->hasWrapList(sourceRow))
+            continue;
+
+        WrapListEntry entry;
+        entry.msgId = source->index(sourceRow, 0).data(MessageModel::MsgIdRole).value<MsgId>();
+        if (_pendingMsgIds.contains(entry.msgId))
+            continue;
+
+        if (source != chatLineModel && !batch.isEmpty()) {
+            _threadPool.start(new WrapListJob(this, chatLineModel, _styleGeneration, batch));
+            batch.clear();
+        }
+        chatLineModel = const_cast<ChatLineModel *>(source);
+        chatLineModel->wrapListInput(sourceRow, &entry.text, &entry.formatRanges);
+        _pendingMsgIds.insert(entry.msgId);
+        batch << entry;
+
+        if (batch.count() >= wrapListBatchSize) {
+            _threadPool.start(new WrapListJob(this, chatLineModel, _styleGeneration, batch));
+            batch.clear();
+        }
+    }
+    if (!batch.isEmpty())
+        _threadPool.start(new WrapListJob(this, chatLineModel, _styleGeneration, batch));
+}
+
+
+void ChatLayoutService::customEvent(QEvent *event)
+{
+    if (event->type() != QEvent::User)
+        return;
+
+    event->accept();
+
+    WrapListBatchEvent *batchEvent = static_cast<WrapListBatchEvent *>(event);
+    if (batchEvent->styleGeneration != _styleGeneration)
+        return; // computed with an outdated style, and already removed from the pending set
+
+    foreach(const WrapListEntry &entry, batchEvent->entries) {
+        _pendingMsgIds.remove(entry.msgId);
+        if (batchEvent->model)
+            batchEvent->model->setWrapList(entry.msgId, entry.text, entry.wrapList);
+    }
+    emit wrapListsReady();
+}
+
+
+QTextLayout *ChatLayoutService::takeLayout(const LayoutKey &key)
+{
+    return _layoutCache.take(key);
+}
+
+
+void ChatLayoutService::storeLayout(const LayoutKey &key, QTextLayout *layout)
+{
+    if (!key.isValid()) {
+        delete layout;
+        return;
+    }
+    _layoutCache.insert(key, layout);
+}
+
+
+void ChatLayoutService::styleChanged()
+{
+    // the ChatLineModel drops its wrap lists as well, so everything needs to be redone
+    _styleGeneration++;
+    _pendingMsgIds.clear();
+    _layoutCache.clear();
+    emit wrapListsReady();
+}
+
+
+uint qHash(const ChatLayoutService::LayoutKey &key)
+{
+    return qHash(key.msgId) ^ qHash(key.column) ^ qHash(key.width) ^ key.textHash ^ key.messageLabel;
+}
@@ -0,0 +1,108 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2016 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#ifndef CHATLAYOUTSERVICE_H_
+#define CHATLAYOUTSERVICE_H_
+
+#include <QCache>
+#include <QObject>
+#include <QSet>
+#include <QTextLayout>
+#include <QThreadPool>
+
+#include "chatlinemodel.h"
+
+class QAbstractItemModel;
+
+//! Computes text layout information for ChatLines ahead of time
+/** Wrap lists (the word positions ContentsChatItem wraps at) are expensive to compute, and the
+ *  ChatScene needs them for every row it measures. This computes them in worker threads for the rows
+ *  near the viewport, so they are ready by the time the rows are shown or measured.
+ *
+ *  It also keeps the QTextLayouts of ChatItems that went out of view for a while, so scrolling back
+ *  and forth doesn't lay out the same text over and over again.
+ */
+class ChatLayoutService : public QObject
+{
+    Q_OBJECT
+
+public:
+    //! Identifies a laid out ChatItem; layouts are only reused if all of this matches
+    struct LayoutKey {
+        MsgId msgId;
+        int column;
+        qint64 width;
+        uint textHash;
+        quint32 messageLabel;
+
+        LayoutKey() : column(-1), width(0), textHash(0), messageLabel(0) {}
+        inline bool isValid() const { return column >= 0; }
+        inline bool operator==(const LayoutKey &other) const
+        {
+            return msgId == other.msgId && column == other.column && width == other.width
+                && textHash == other.textHash && messageLabel == other.messageLabel;
+        }
+    };
+
+    static ChatLayoutService *instance();
+
+    //! Computes the missing wrap lists of the given rows in the background
+    /** \param model The model the rows belong to, usually a MessageFilter on top of the ChatLineModel
+     */
+    void prefetch(const QAbstractItemModel *model, int start, int end);
+
+    //! Whether data(WrapListRole) for the given row can be answered without computing the wrap list
+    bool hasWrapList(const QAbstractItemModel *model, int row) const;
+
+    //! Hands out a cached layout matching key, if there is one. The caller takes ownership.
+    QTextLayout *takeLayout(const LayoutKey &key);
+    //! Keeps layout around for reuse. The service takes ownership.
+    void storeLayout(const LayoutKey &key, QTextLayout *layout);
+
+signals:
+    //! Emitted when a batch of wrap lists has been installed into the ChatLineModel
+    void wrapListsReady();
+
+protected:
+    virtual void customEvent(QEvent *event);
+
+private slots:
+    void styleChanged();
+
+private:
+    class WrapListJob;
+
+    ChatLayoutService(QObject *parent = 0);
+    ~ChatLayoutService();
+
+    const ChatLineModel *sourceModel(const QAbstractItemModel *model, int *row) const;
+
+    static ChatLayoutService *_instance;
+
+    QThreadPool _threadPool;
+    QSet<MsgId> _pendingMsgIds;
+    quint64 _styleGeneration;
+    QCache<LayoutKey, QTextLayout> _layoutCache;
+};
+
+
+uint qHash(const ChatLayoutService::LayoutKey &key);
+
+#endif
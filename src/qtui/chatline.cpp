@@ -97,8 +97,10 @@ ChatItem *ChatLine::itemAt(const QPointF &pos)
 
 void ChatLine::clearCache()
 {
-    _timestampItem.clearCache();
-    _senderItem.clearCache();
+    // the layouts are still valid, so we keep them around in case the line comes into view again
+    _timestampItem.releaseLayout();
+    _senderItem.releaseLayout();
+    _contentsItem.releaseLayout();
     _contentsItem.clearCache();
 }
 
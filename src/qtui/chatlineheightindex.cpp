@@ -0,0 +1,135 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2016 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "chatlineheightindex.h"
+
+ChatLineHeightIndex::ChatLineHeightIndex()
+    : _staleCount(0),
+    _total(0)
+{
+    _tree.append(0);
+}
+
+
+qreal ChatLineHeightIndex::offset(int row) const
+{
+    qreal result = 0;
+    for (int i = qMin(row, count()); i > 0; i -= i & -i)
+        result += _tree.at(i);
+    return result;
+}
+
+
+int ChatLineHeightIndex::rowAt(qreal offset) const
+{
+    int n = count();
+    int step = 1;
+    while (step <= n / 2)
+        step <<= 1;
+
+    int pos = 0;
+    for (; step > 0; step >>= 1) {
+        int next = pos + step;
+        if (next <= n && _tree.at(next) <= offset) {
+            pos = next;
+            offset -= _tree.at(next);
+        }
+    }
+    return pos;
+}
+
+
+void ChatLineHeightIndex::insert(int row, const QVector<qreal> &heights)
+{
+    _heights.insert(row, heights.count(), 0);
+    _stale.insert(row, heights.count(), false);
+    for (int i = 0; i < heights.count(); i++)
+        _heights[row + i] = heights.at(i);
+    rebuild();
+}
+
+
+void ChatLineHeightIndex::remove(int row, int count)
+{
+    for (int i = row; i < row + count; i++) {
+        if (_stale.at(i))
+            _staleCount--;
+    }
+    _heights.remove(row, count);
+    _stale.remove(row, count);
+    rebuild();
+}
+
+
+void ChatLineHeightIndex::clear()
+{
+    _heights.clear();
+    _stale.clear();
+    _staleCount = 0;
+    rebuild();
+}
+
+
+qreal ChatLineHeightIndex::setHeight(int row, qreal height)
+{
+    if (_stale.at(row)) {
+        _stale[row] = false;
+        _staleCount--;
+    }
+
+    qreal delta = height - _heights.at(row);
+    if (delta == 0)
+        return 0;
+
+    _heights[row] = height;
+    for (int i = row + 1; i <= count(); i += i & -i)
+        _tree[i] += delta;
+    _total += delta;
+    return delta;
+}
+
+
+void ChatLineHeightIndex::setStale(int first, int last)
+{
+    for (int i = first; i <= last; i++) {
+        if (!_stale.at(i)) {
+            _stale[i] = true;
+            _staleCount++;
+        }
+    }
+}
+
+
+void ChatLineHeightIndex::rebuild()
+{
+    int n = count();
+    _tree.resize(n + 1);
+    _tree[0] = 0;
+    _total = 0;
+    for (int i = 1; i <= n; i++) {
+        _tree[i] = _heights.at(i - 1);
+        _total += _tree.at(i);
+    }
+    for (int i = 1; i <= n; i++) {
+        int parent = i + (i & -i);
+        if (parent <= n)
+            _tree[parent] += _tree.at(i);
+    }
+}
@@ -0,0 +1,74 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2016 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#ifndef CHATLINEHEIGHTINDEX_H_
+#define CHATLINEHEIGHTINDEX_H_
+
+#include <QVector>
+
+//! Keeps the heights of all rows of a ChatScene and answers position queries in O(log n)
+/** Heights are stored in a Fenwick tree, so both the offset of a row and the row at a given offset
+ *  can be found without walking all rows. Changing a single height is O(log n), inserting or removing
+ *  rows rebuilds the tree in O(n).
+ *  Rows can be marked as stale, in which case their height is only an estimate that still needs to be
+ *  measured (e.g. after the scene width changed).
+ */
+class ChatLineHeightIndex
+{
+public:
+    ChatLineHeightIndex();
+
+    inline int count() const { return _heights.count(); }
+    inline qreal height(int row) const { return _heights.at(row); }
+    inline qreal totalHeight() const { return _total; }
+
+    //! The summed up height of all rows before the given one
+    qreal offset(int row) const;
+
+    //! The row containing the given offset
+    /** Offsets beyond the last row return count().
+     */
+    int rowAt(qreal offset) const;
+
+    void insert(int row, const QVector<qreal> &heights);
+    void remove(int row, int count);
+    void clear();
+
+    //! Sets the (measured) height of a row and clears its stale flag
+    /** \return The difference to the previous height
+     */
+    qreal setHeight(int row, qreal height);
+
+    inline bool isStale(int row) const { return _stale.at(row); }
+    inline int staleCount() const { return _staleCount; }
+    void setStale(int first, int last);
+
+private:
+    void rebuild();
+
+    QVector<qreal> _heights;
+    QVector<qreal> _tree; // 1-based
+    QVector<bool> _stale;
+    int _staleCount;
+    qreal _total;
+};
+
+
+#endif
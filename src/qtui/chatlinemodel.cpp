@@ -18,12 +18,21 @@
  *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
  ***************************************************************************/
 
+#include <algorithm>
+
+#include <QTimer>
+
 #include "chatlinemodel.h"
 #include "qtui.h"
 #include "qtuistyle.h"
 
+// Number of items we keep derived data (styled contents, wrap list) for; the least recently used
+// ones beyond that are dropped and recomputed on demand
+const int maxDerivedDataItems = 10000;
+
 ChatLineModel::ChatLineModel(QObject *parent)
-    : MessageModel(parent)
+    : MessageModel(parent),
+    _sweepScheduled(false)
 {
     qRegisterMetaType<WrapList>("ChatLineModel::WrapList");
     qRegisterMetaTypeStreamOperators<WrapList>("ChatLineModel::WrapList");
@@ -36,15 +45,144 @@ ChatLineModel::ChatLineModel(QObject *parent)
 //   return new ChatLineModelItem(msg);
 // }
 
+QVariant ChatLineModel::data(const QModelIndex &index, int role) const
+{
+    QVariant result = MessageModel::data(index, role);
+
+    if (!_sweepScheduled && ChatLineModelItem::newlyStyledCount() > maxDerivedDataItems / 2) {
+        _sweepScheduled = true;
+        QTimer::singleShot(0, const_cast<ChatLineModel *>(this), SLOT(dropStaleDerivedData()));
+    }
+    return result;
+}
+
+
+void ChatLineModel::insertStyledMessages(const QList<UiStyle::StyledMessage> &messages)
+{
+    QList<Message> msgs;
+    msgs.reserve(messages.count());
+    for (int i = 0; i < messages.count(); i++) {
+        msgs << messages.at(i);
+        _styledBatch[messages.at(i).msgId()] = &messages.at(i);
+    }
+    insertMessages(msgs);
+    _styledBatch.clear();
+}
+
+
 void ChatLineModel::insertMessages__(int pos, const QList<Message> &messages)
 {
     for (int i = 0; i < messages.count(); i++) {
-        _messageList.insert(pos, ChatLineModelItem(messages[i]));
+        _messageList.insert(pos, ChatLineModelItem(intern(messages[i])));
+        if (!_styledBatch.isEmpty()) {
+            // day change messages share the msgId of their predecessor
+            const UiStyle::StyledMessage *styledMsg = _styledBatch.value(messages.at(i).msgId());
+            if (styledMsg && styledMsg->type() == messages.at(i).type())
+                _messageList[pos].adoptStyle(*styledMsg);
+        }
         pos++;
     }
 }
 
 
+void ChatLineModel::removeAllMessages()
+{
+    _messageList.clear();
+    _bufferInfoPool.clear();
+    _senderPool.clear();
+}
+
+
+// Makes the message share its BufferInfo and sender strings with previous messages
+Message ChatLineModel::intern(const Message &msg)
+{
+    BufferInfo bufferInfo = msg.bufferInfo();
+    if (bufferInfo.bufferId().isValid()) {
+        QHash<BufferId, BufferInfo>::iterator it = _bufferInfoPool.find(bufferInfo.bufferId());
+        if (it == _bufferInfoPool.end() || it->bufferName() != bufferInfo.bufferName())
+            _bufferInfoPool[bufferInfo.bufferId()] = bufferInfo;
+        else
+            bufferInfo = *it;
+    }
+    QString sender = *_senderPool.insert(msg.sender());
+
+    Message result(msg.timestamp(), bufferInfo, msg.type(), msg.contents(), sender, msg.flags());
+    result.setMsgId(msg.msgId());
+    return result;
+}
+
+
+void ChatLineModel::dropStaleDerivedData()
+{
+    _sweepScheduled = false;
+    ChatLineModelItem::resetNewlyStyledCount();
+
+    QVector<quint32> stamps;
+    for (int i = 0; i < _messageList.count(); i++) {
+        if (_messageList.at(i).lastUsed())
+            stamps << _messageList.at(i).lastUsed();
+    }
+    if (stamps.count() <= maxDerivedDataItems)
+        return;
+
+    // Keep the most recently used half, so we don't have to sweep again right away
+    int dropCount = stamps.count() - maxDerivedDataItems / 2;
+    std::nth_element(stamps.begin(), stamps.begin() + dropCount, stamps.end());
+    quint32 threshold = stamps.at(dropCount);
+    for (int i = 0; i < _messageList.count(); i++) {
+        quint32 lastUsed = _messageList.at(i).lastUsed();
+        if (lastUsed && lastUsed < threshold)
+            _messageList[i].dropDerivedData();
+    }
+}
+
+
+void ChatLineModel::setWrapList(MsgId msgId, const QString &text, const WrapList &wrapList)
+{
+    // messages are sorted by id, but a day change shares the id of the message before it
+    int start = 0;
+    int end = _messageList.count();
+    while (start < end) {
+        int pivot = (start + end) / 2;
+        if (_messageList.at(pivot).msgId() < msgId)
+            start = pivot + 1;
+        else
+            end = pivot;
+    }
+    for (int row = start; row < _messageList.count() && _messageList.at(row).msgId() == msgId; row++)
+        _messageList[row].setWrapList(text, wrapList);
+}
+
+
+QString ChatLineModel::memoryReport() const
+{
+    qint64 messageBytes = 0;
+    qint64 derivedBytes = 0;
+    int derivedCount = 0;
+    for (int i = 0; i < _messageList.count(); i++) {
+        const ChatLineModelItem &item = _messageList.at(i);
+        messageBytes += sizeof(ChatLineModelItem) + item.message().contents().capacity() * sizeof(QChar);
+        if (item.lastUsed()) {
+            derivedBytes += item.derivedMemoryUsage();
+            derivedCount++;
+        }
+    }
+
+    qint64 poolBytes = 0;
+    foreach(const QString &sender, _senderPool)
+        poolBytes += sender.capacity() * sizeof(QChar);
+    foreach(const BufferInfo &bufferInfo, _bufferInfoPool)
+        poolBytes += bufferInfo.bufferName().capacity() * sizeof(QChar);
+
+    return tr("Messages: %1 (%2 KiB)\n"
+              "Styled messages: %3 (%4 KiB)\n"
+              "Interned senders: %5, buffers: %6 (%7 KiB)")
+           .arg(_messageList.count()).arg(messageBytes / 1024)
+           .arg(derivedCount).arg(derivedBytes / 1024)
+           .arg(_senderPool.count()).arg(_bufferInfoPool.count()).arg(poolBytes / 1024);
+}
+
+
 Message ChatLineModel::takeMessageAt(int i)
 {
     Message msg = _messageList[i].message();
@@ -55,9 +193,8 @@ Message ChatLineModel::takeMessageAt(int i)
 
 void ChatLineModel::styleChanged()
 {
-    foreach(ChatLineModelItem item, _messageList) {
-        item.invalidateWrapList();
-    }
+    for (int i = 0; i < _messageList.count(); i++)
+        _messageList[i].invalidateWrapList();
     emit dataChanged(index(0, 0), index(rowCount()-1, columnCount()-1));
 }
 
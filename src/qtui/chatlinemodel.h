@@ -23,7 +23,9 @@
 
 #include "messagemodel.h"
 
+#include <QHash>
 #include <QList>
+#include <QSet>
 #include "chatlinemodelitem.h"
 
 class ChatLineModel : public MessageModel
@@ -34,7 +36,8 @@ public:
     enum ChatLineRole {
         WrapListRole = MessageModel::UserRole,
         MsgLabelRole,
-        SelectedBackgroundRole
+        SelectedBackgroundRole,
+        ClickableListRole
     };
 
     ChatLineModel(QObject *parent = 0);
@@ -42,6 +45,23 @@ public:
     typedef ChatLineModelItem::Word Word;
     typedef ChatLineModelItem::WrapList WrapList;
     virtual inline const MessageModelItem *messageItemAt(int i) const { return &_messageList[i]; }
+
+    virtual QVariant data(const QModelIndex &index, int role) const;
+
+    //! Whether the wrap list of the given row is available without computing it
+    inline bool hasWrapList(int row) const { return _messageList.at(row).hasWrapList(); }
+    //! Gathers what's needed for computing the wrap list of the given row outside of the GUI thread
+    inline void wrapListInput(int row, QString *text, QList<QTextLayout::FormatRange> *formatRanges) const { _messageList.at(row).wrapListInput(text, formatRanges); }
+    //! Installs a wrap list computed by ChatLayoutService for the message with the given id and contents
+    void setWrapList(MsgId msgId, const QString &text, const WrapList &wrapList);
+
+    //! Inserts messages whose contents have already been styled, e.g. in a worker thread
+    /** Works like MessageModel::insertMessages(), but the new items take over the styled contents.
+     */
+    void insertStyledMessages(const QList<UiStyle::StyledMessage> &messages);
+
+    //! Human-readable estimate of the memory used by the model, for the debug console
+    QString memoryReport() const;
 protected:
 //   virtual MessageModelItem *createMessageModelItem(const Message &);
 
@@ -52,17 +72,31 @@ protected:
     virtual inline MessageModelItem *firstMessageItem() { return &_messageList.first(); }
     virtual inline const MessageModelItem *lastMessageItem() const { return &_messageList.last(); }
     virtual inline MessageModelItem *lastMessageItem() { return &_messageList.last(); }
-    virtual inline void insertMessage__(int pos, const Message &msg) { _messageList.insert(pos, ChatLineModelItem(msg)); }
+    virtual inline void insertMessage__(int pos, const Message &msg) { _messageList.insert(pos, ChatLineModelItem(intern(msg))); }
     virtual void insertMessages__(int pos, const QList<Message> &);
     virtual inline void removeMessageAt(int i) { _messageList.removeAt(i); }
-    virtual inline void removeAllMessages() { _messageList.clear(); }
+    virtual void removeAllMessages();
     virtual Message takeMessageAt(int i);
 
 protected slots:
     virtual void styleChanged();
 
+private slots:
+    void dropStaleDerivedData();
+
 private:
+    Message intern(const Message &msg);
+
     QList<ChatLineModelItem> _messageList;
+
+    // Pools for sharing the string data of BufferInfos and senders between messages
+    QHash<BufferId, BufferInfo> _bufferInfoPool;
+    QSet<QString> _senderPool;
+
+    // The batch insertStyledMessages() is currently inserting, by msgId
+    QHash<MsgId, const UiStyle::StyledMessage *> _styledBatch;
+
+    mutable bool _sweepScheduled;
 };
 
 
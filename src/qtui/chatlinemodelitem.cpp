@@ -40,18 +40,33 @@ typedef struct {
 unsigned char *ChatLineModelItem::TextBoundaryFinderBuffer = (unsigned char *)malloc(512 * sizeof(HB_CharAttributes_Dummy));
 int ChatLineModelItem::TextBoundaryFinderBufferSize = 512 * (sizeof(HB_CharAttributes_Dummy) / sizeof(unsigned char));
 
+quint32 ChatLineModelItem::_useCounter = 0;
+int ChatLineModelItem::_newlyStyledCount = 0;
+
 // ****************************************
 // the actual ChatLineModelItem
 // ****************************************
 ChatLineModelItem::ChatLineModelItem(const Message &msg)
     : MessageModelItem(),
-    _styledMsg(msg)
+    _styledMsg(msg),
+    _lastUsed(0),
+    _hasClickables(false)
 {
     if (!msg.sender().contains('!'))
         _styledMsg.setFlags(msg.flags() |= Message::ServerMsg);
 }
 
 
+void ChatLineModelItem::adoptStyle(const UiStyle::StyledMessage &styledMsg)
+{
+    if (!styledMsg.isStyled())
+        return;
+
+    _styledMsg.adoptStyle(styledMsg);
+    touch();
+}
+
+
 bool ChatLineModelItem::setData(int column, const QVariant &value, int role)
 {
     switch (role) {
@@ -133,22 +148,57 @@ QVariant ChatLineModelItem::contentsData(int role) const
     switch (role) {
     case ChatLineModel::DisplayRole:
     case ChatLineModel::EditRole:
+        touch();
         return _styledMsg.plainContents();
     case ChatLineModel::BackgroundRole:
         return backgroundBrush(UiStyle::Contents);
     case ChatLineModel::SelectedBackgroundRole:
         return backgroundBrush(UiStyle::Contents, true);
     case ChatLineModel::FormatRole:
+        touch();
         return QVariant::fromValue<UiStyle::FormatList>(_styledMsg.contentsFormatList());
     case ChatLineModel::WrapListRole:
+        touch();
         if (_wrapList.isEmpty())
             computeWrapList();
         return QVariant::fromValue<ChatLineModel::WrapList>(_wrapList);
+    case ChatLineModel::ClickableListRole:
+        touch();
+        if (!_hasClickables) {
+            _clickables = ClickableList::fromString(_styledMsg.plainContents());
+            _hasClickables = true;
+        }
+        return QVariant::fromValue<ClickableList>(_clickables);
     }
     return QVariant();
 }
 
 
+// Marks the derived data as recently used, so ChatLineModel's LRU sweep keeps it around
+void ChatLineModelItem::touch() const
+{
+    if (!_lastUsed)
+        ++_newlyStyledCount;
+    _lastUsed = ++_useCounter;
+}
+
+
+void ChatLineModelItem::dropDerivedData()
+{
+    _wrapList = WrapList();
+    _clickables = ClickableList();
+    _hasClickables = false;
+    _styledMsg.clearStyle();
+    _lastUsed = 0;
+}
+
+
+int ChatLineModelItem::derivedMemoryUsage() const
+{
+    return _styledMsg.styleMemoryUsage() + _wrapList.capacity() * sizeof(Word) + _clickables.count() * sizeof(Clickable);
+}
+
+
 quint32 ChatLineModelItem::messageLabel() const
 {
     quint32 label = _styledMsg.senderHash() << 16;
@@ -171,49 +221,88 @@ QVariant ChatLineModelItem::backgroundBrush(UiStyle::FormatType subelement, bool
 
 void ChatLineModelItem::computeWrapList() const
 {
-    QString text = _styledMsg.plainContents();
+    _wrapList = computeWrapList(_styledMsg.plainContents(),
+        QtUi::style()->toTextLayoutList(_styledMsg.contentsFormatList(), _styledMsg.plainContents().length(), messageLabel()),
+        TextBoundaryFinderBuffer, TextBoundaryFinderBufferSize);
+}
+
+
+bool ChatLineModelItem::hasWrapList() const
+{
+    touch();
+    return !_wrapList.isEmpty() || _styledMsg.plainContents().isEmpty();
+}
+
+
+void ChatLineModelItem::wrapListInput(QString *text, QList<QTextLayout::FormatRange> *formatRanges) const
+{
+    touch();
+    *text = _styledMsg.plainContents();
+    *formatRanges = QtUi::style()->toTextLayoutList(_styledMsg.contentsFormatList(), text->length(), messageLabel());
+}
+
+
+void ChatLineModelItem::setWrapList(const QString &text, const WrapList &wrapList)
+{
+    if (!_wrapList.isEmpty() || text != _styledMsg.plainContents())
+        return;
+    touch();
+    _wrapList = wrapList;
+}
+
+
+// QTextBoundaryFinder has inconsistent behavior in Qt version up to and including 4.6.3 (at least).
+// It doesn't point to the position we should break, but to the character before that.
+// Unfortunately Qt decided to fix this by changing the behavior of QTBF, so now we have to add a version
+// check. At the time of this writing, I'm still trying to get this reverted upstream...
+//
+// cf. https://bugs.webkit.org/show_bug.cgi?id=31076 and Qt commit e6ac173
+//
+// This is determined once on startup, since computeWrapList() also runs in worker threads.
+static bool boundaryFinderNeedsWorkaround()
+{
+    QStringList versions = QString(qVersion()).split('.');
+    if (versions.count() == 3 && versions.at(0).toInt() == 4) {
+        if (versions.at(1).toInt() <= 6 && versions.at(2).toInt() <= 3)
+            return true;
+    }
+    return false;
+}
+
+
+static const bool needBoundaryFinderWorkaround = boundaryFinderNeedsWorkaround();
+
+ChatLineModelItem::WrapList ChatLineModelItem::computeWrapList(const QString &text, const QList<QTextLayout::FormatRange> &formatRanges,
+    unsigned char *boundaryFinderBuffer, int boundaryFinderBufferSize)
+{
+    WrapList wrapList;
     int length = text.length();
     if (!length)
-        return;
+        return wrapList;
 
-    QList<ChatLineModel::Word> wplist; // use a temp list which we'll later copy into a QVector for efficiency
-    QTextBoundaryFinder finder(QTextBoundaryFinder::Line, _styledMsg.plainContents().unicode(), length,
-        TextBoundaryFinderBuffer, TextBoundaryFinderBufferSize);
+    QList<Word> wplist; // use a temp list which we'll later copy into a QVector for efficiency
+    QTextBoundaryFinder finder(QTextBoundaryFinder::Line, text.unicode(), length,
+        boundaryFinderBuffer, boundaryFinderBufferSize);
 
     int idx;
     int oldidx = 0;
-    ChatLineModel::Word word;
+    Word word;
     word.start = 0;
     qreal wordstartx = 0;
 
-    QTextLayout layout(_styledMsg.plainContents());
+    QTextLayout layout(text);
     QTextOption option;
     option.setWrapMode(QTextOption::NoWrap);
     layout.setTextOption(option);
 
-    layout.setAdditionalFormats(QtUi::style()->toTextLayoutList(_styledMsg.contentsFormatList(), length, messageLabel()));
+    layout.setAdditionalFormats(formatRanges);
     layout.beginLayout();
     QTextLine line = layout.createLine();
     line.setNumColumns(length);
     layout.endLayout();
 
     while ((idx = finder.toNextBoundary()) >= 0 && idx <= length) {
-        // QTextBoundaryFinder has inconsistent behavior in Qt version up to and including 4.6.3 (at least).
-        // It doesn't point to the position we should break, but to the character before that.
-        // Unfortunately Qt decided to fix this by changing the behavior of QTBF, so now we have to add a version
-        // check. At the time of this writing, I'm still trying to get this reverted upstream...
-        //
-        // cf. https://bugs.webkit.org/show_bug.cgi?id=31076 and Qt commit e6ac173
-        static int needWorkaround = -1;
-        if (needWorkaround < 0) {
-            needWorkaround = 0;
-            QStringList versions = QString(qVersion()).split('.');
-            if (versions.count() == 3 && versions.at(0).toInt() == 4) {
-                if (versions.at(1).toInt() <= 6 && versions.at(2).toInt() <= 3)
-                    needWorkaround = 1;
-            }
-        }
-        if (needWorkaround == 1) {
+        if (needBoundaryFinderWorkaround) {
             if (idx < length)
                 idx++;
         }
@@ -240,8 +329,9 @@ void ChatLineModelItem::computeWrapList() const
     }
 
     // A QVector needs less space than a QList
-    _wrapList.resize(wplist.count());
+    wrapList.resize(wplist.count());
     for (int i = 0; i < wplist.count(); i++) {
-        _wrapList[i] = wplist.at(i);
+        wrapList[i] = wplist.at(i);
     }
+    return wrapList;
 }
@@ -21,6 +21,9 @@
 #ifndef CHATLINEMODELITEM_H_
 #define CHATLINEMODELITEM_H_
 
+#include <QTextLayout>
+
+#include "clickable.h"
 #include "messagemodel.h"
 
 #include "uistyle.h"
@@ -43,6 +46,21 @@ public:
 
     virtual inline void invalidateWrapList() { _wrapList.clear(); }
 
+    //! Takes over the styled contents of styledMsg (e.g. styled by QtUiMessageProcessor's workers), if it has any
+    void adoptStyle(const UiStyle::StyledMessage &styledMsg);
+
+    //! Drops the data derived from the message (styled contents, wrap list, clickables); it is recomputed on demand
+    void dropDerivedData();
+    //! Usage stamp of the derived data, 0 if the item currently holds none
+    inline quint32 lastUsed() const { return _lastUsed; }
+
+    //! Approximate heap memory used by the derived data
+    int derivedMemoryUsage() const;
+
+    //! Number of items that have created derived data since the last call to resetNewlyStyledCount()
+    static inline int newlyStyledCount() { return _newlyStyledCount; }
+    static inline void resetNewlyStyledCount() { _newlyStyledCount = 0; }
+
     /// Used to store information about words to be used for wrapping
     struct Word {
         quint16 start;
@@ -52,6 +70,20 @@ public:
     };
     typedef QVector<Word> WrapList;
 
+    //! Whether data(WrapListRole) can be answered without computing anything expensive
+    bool hasWrapList() const;
+    //! The text and formats computeWrapList() needs, so the wrap list can be computed in another thread
+    void wrapListInput(QString *text, QList<QTextLayout::FormatRange> *formatRanges) const;
+    //! Sets a wrap list computed elsewhere, if it still matches our contents and we don't have one yet
+    void setWrapList(const QString &text, const WrapList &wrapList);
+
+    //! Computes the word positions of text laid out with the given formats
+    /** This only touches its arguments, so it can be run in a worker thread as long as no
+     *  boundary finder buffer is passed (that one is shared by the GUI thread).
+     */
+    static WrapList computeWrapList(const QString &text, const QList<QTextLayout::FormatRange> &formatRanges,
+        unsigned char *boundaryFinderBuffer = 0, int boundaryFinderBufferSize = 0);
+
 private:
     QVariant timestampData(int role) const;
     QVariant senderData(int role) const;
@@ -61,12 +93,19 @@ private:
     quint32 messageLabel() const;
 
     void computeWrapList() const;
+    void touch() const;
 
     mutable WrapList _wrapList;
+    mutable ClickableList _clickables;
+    mutable bool _hasClickables;
     UiStyle::StyledMessage _styledMsg;
+    mutable quint32 _lastUsed;
 
     static unsigned char *TextBoundaryFinderBuffer;
     static int TextBoundaryFinderBufferSize;
+
+    static quint32 _useCounter;
+    static int _newlyStyledCount;
 };
 
 
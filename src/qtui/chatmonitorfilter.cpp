@@ -63,9 +63,15 @@ bool ChatMonitorFilter::filterAcceptsRow(int sourceRow, const QModelIndex &sourc
     Q_UNUSED(sourceParent)
 
     QModelIndex source_index = sourceModel()->index(sourceRow, 0);
-    BufferId bufferId = source_index.data(MessageModel::BufferIdRole).value<BufferId>();
+    const MessageModelItem *item = sourceItem(sourceRow);
 
-    Message::Flags flags = (Message::Flags)source_index.data(MessageModel::FlagsRole).toInt();
+    // Check the buffer restrictions first, those are the cheapest to evaluate
+    if (item && _operationMode == ChatViewSettings::OptIn && !_bufferIds.contains(item->bufferId())
+        && !(_showHighlights && item->msgFlags() & Message::Highlight))
+        return false;
+
+    BufferId bufferId = item ? item->bufferId() : source_index.data(MessageModel::BufferIdRole).value<BufferId>();
+    Message::Flags flags = item ? item->msgFlags() : (Message::Flags)source_index.data(MessageModel::FlagsRole).toInt();
     if ((flags & Message::Backlog) && (!_showBacklog || (!_includeRead &&
         (Client::networkModel()->lastSeenMsgId(bufferId) >= sourceModel()->data(source_index, MessageModel::MsgIdRole).value<MsgId>()))))
         return false;
@@ -73,7 +79,7 @@ bool ChatMonitorFilter::filterAcceptsRow(int sourceRow, const QModelIndex &sourc
     if (!_showOwnMessages && flags & Message::Self)
         return false;
 
-    Message::Type type = (Message::Type)source_index.data(MessageModel::TypeRole).toInt();
+    Message::Type type = item ? item->msgType() : (Message::Type)source_index.data(MessageModel::TypeRole).toInt();
     if (!(type & (Message::Plain | Message::Notice | Message::Action)))
         return false;
 
@@ -88,9 +94,7 @@ bool ChatMonitorFilter::filterAcceptsRow(int sourceRow, const QModelIndex &sourc
         return false;
 
     // ignorelist handling
-    // only match if message is not flagged as server msg
-    if (!(flags & Message::ServerMsg) && Client::ignoreListManager()
-        && Client::ignoreListManager()->match(source_index.data(MessageModel::MessageRole).value<Message>(), Client::networkModel()->networkName(bufferId)))
+    if (isIgnored(sourceRow, source_index))
         return false;
     return true;
 }
@@ -39,7 +39,6 @@ protected:
 private slots:
     void showFieldsChanged(bool checked);
     void showSettingsPage();
-    virtual void coreConnectionStateChanged(bool connected);
 
 protected:
     inline ChatMonitorFilter *filter() const { return _filter; }
@@ -30,6 +30,10 @@
 #include <QPersistentModelIndex>
 #include <QUrl>
 
+#if QT_VERSION >= 0x050000
+#  include <QScreen>
+#endif
+
 #ifdef HAVE_KDE4
 #  include <KMenuBar>
 #else
@@ -41,6 +45,7 @@
 #endif
 
 #include "chatitem.h"
+#include "chatlayoutservice.h"
 #include "chatline.h"
 #include "chatlinemodelitem.h"
 #include "chatscene.h"
@@ -56,8 +61,23 @@
 #include "qtuistyle.h"
 #include "chatviewsettings.h"
 #include "webpreviewitem.h"
+#include "webpreviewservice.h"
 
 const qreal minContentsWidth = 200;
+// Inserted or relayouted ranges larger than this are estimated first and measured later on
+const int maxSyncMeasuredRows = 64;
+
+// Model changes are applied at most once per display frame
+static int frameInterval()
+{
+#if QT_VERSION >= 0x050000
+    QScreen *screen = QGuiApplication::primaryScreen();
+    if (screen && screen->refreshRate() > 0)
+        return qMax(1, qRound(1000 / screen->refreshRate()));
+#endif
+    return 16;
+}
+
 
 ChatScene::ChatScene(QAbstractItemModel *model, const QString &idString, qreal width, ChatView *parent)
     : QGraphicsScene(0, 0, width, 0, (QObject *)parent),
@@ -65,6 +85,14 @@ ChatScene::ChatScene(QAbstractItemModel *model, const QString &idString, qreal w
     _idString(idString),
     _model(model),
     _singleBufferId(BufferId()),
+    _topPos(0),
+    _measureLine(0),
+    _lastViewportRow(-1),
+    _updatingLines(false),
+    _linesUpdatePending(false),
+    _refineRow(-1),
+    _framePending(false),
+    _pendingAppendRow(-1),
     _sceneRect(0, 0, width, 0),
     _firstLineRow(-1),
     _viewportHeight(0),
@@ -111,6 +139,15 @@ ChatScene::ChatScene(QAbstractItemModel *model, const QString &idString, qreal w
 
     setHandleXLimits();
 
+    _updateLinesTimer.setSingleShot(true);
+    connect(&_updateLinesTimer, SIGNAL(timeout()), SLOT(updateLines()));
+    _refineTimer.setSingleShot(true);
+    connect(&_refineTimer, SIGNAL(timeout()), SLOT(refineLineHeights()));
+    _frameTimer.setSingleShot(true);
+    _frameTimer.setInterval(frameInterval());
+    connect(&_frameTimer, SIGNAL(timeout()), SLOT(frameTimeout()));
+    connect(ChatLayoutService::instance(), SIGNAL(wrapListsReady()), SLOT(wrapListsReady()));
+
     if (model->rowCount() > 0)
         rowsInserted(QModelIndex(), 0, model->rowCount() - 1);
 
@@ -125,6 +162,7 @@ ChatScene::ChatScene(QAbstractItemModel *model, const QString &idString, qreal w
 #ifdef HAVE_WEBKIT
     webPreview.timer.setSingleShot(true);
     connect(&webPreview.timer, SIGNAL(timeout()), this, SLOT(webPreviewNextStep()));
+    connect(WebPreviewService::instance(), SIGNAL(previewReady(const QUrl &)), this, SLOT(webPreviewReady(const QUrl &)));
 #endif
     _showWebPreview = defaultSettings.showWebPreview();
     defaultSettings.notify("ShowWebPreview", this, SLOT(showWebPreviewChanged()));
@@ -139,6 +177,7 @@ ChatScene::ChatScene(QAbstractItemModel *model, const QString &idString, qreal w
 
 ChatScene::~ChatScene()
 {
+    delete _measureLine;
 }
 
 
@@ -171,22 +210,36 @@ void ChatScene::resetColumnWidths()
     _secondColHandle->setXPos(secondColHandlePos);
 }
 
-ChatLine *ChatScene::chatLine(MsgId msgId, bool matchExact, bool ignoreDayChange) const
+ChatLine *ChatScene::chatLine(int row)
 {
-    if (!_lines.count())
+    if (row < 0 || row >= _lineHeights.count())
         return 0;
 
-    QList<ChatLine *>::ConstIterator start = _lines.begin();
-    QList<ChatLine *>::ConstIterator end = _lines.end();
-    QList<ChatLine *>::ConstIterator middle;
+    ChatLine *line = _lines.value(row);
+    if (!line) {
+        line = createLine(row);
+        // drop it again later, unless something gets attached to it
+        _updateLinesTimer.start();
+    }
+    return line;
+}
+
 
-    int n = int(end - start);
+int ChatScene::rowByMsgId(MsgId msgId, bool matchExact, bool ignoreDayChange) const
+{
+    int rowCount = _lineHeights.count();
+    if (!rowCount)
+        return -1;
+
+    int start = 0;
+    int n = rowCount;
     int half;
+    int middle;
 
     while (n > 0) {
         half = n >> 1;
         middle = start + half;
-        if ((*middle)->msgId() < msgId) {
+        if (model()->index(middle, 0).data(MessageModel::MsgIdRole).value<MsgId>() < msgId) {
             start = middle + 1;
             n -= half + 1;
         }
@@ -195,38 +248,39 @@ ChatLine *ChatScene::chatLine(MsgId msgId, bool matchExact, bool ignoreDayChange
         }
     }
 
-    if (start != end && (*start)->msgId() == msgId && (ignoreDayChange ? (*start)->msgType() != Message::DayChange : true))
-        return *start;
+    if (start != rowCount && model()->index(start, 0).data(MessageModel::MsgIdRole).value<MsgId>() == msgId
+        && (ignoreDayChange ? rowType(start) != Message::DayChange : true))
+        return start;
 
     if (matchExact)
-        return 0;
+        return -1;
 
-    if (start == _lines.begin()) // not (yet?) in our scene
-        return 0;
+    if (start == 0) // not (yet?) in our scene
+        return -1;
 
     // if we didn't find the exact msgId, take the next-lower one (this makes sense for lastSeen)
 
-    if (start == end) { // higher than last element
+    if (start == rowCount) { // higher than last element
         if (!ignoreDayChange)
-            return _lines.last();
+            return rowCount - 1;
 
-        for (int i = _lines.count() -1; i >= 0; i--) {
-            if (_lines.at(i)->msgType() != Message::DayChange)
-                return _lines.at(i);
+        for (int i = rowCount - 1; i >= 0; i--) {
+            if (rowType(i) != Message::DayChange)
+                return i;
         }
-        return 0;
+        return -1;
     }
 
-    // return the next-lower line
+    // return the next-lower row
     if (!ignoreDayChange)
-        return *(--start);
+        return start - 1;
 
     do {
-        if ((*(--start))->msgType() != Message::DayChange)
-            return *start;
+        if (rowType(--start) != Message::DayChange)
+            return start;
     }
-    while (start != _lines.begin());
-    return 0;
+    while (start != 0);
+    return -1;
 }
 
 
@@ -270,12 +324,11 @@ void ChatScene::setMarkerLine(MsgId msgId)
         msgId = Client::markerLine(singleBufferId());
 
     if (msgId.isValid()) {
-        ChatLine *line = chatLine(msgId, false, true);
-        if (line) {
-            markerLine()->setChatLine(line);
+        int row = rowByMsgId(msgId, false, true);
+        if (row >= 0) {
             // if this was the last line, we won't see it because it's outside the sceneRect
             // .. which is exactly what we want :)
-            markerLine()->setPos(line->pos() + QPointF(0, line->height()));
+            markerLine()->setPos(0, rowPos(row) + rowHeight(row));
 
             // DayChange messages might have been hidden outside the scene rect, don't make the markerline visible then!
             if (markerLine()->pos().y() >= sceneRect().y()) {
@@ -344,122 +397,73 @@ void ChatScene::rowsInserted(const QModelIndex &index, int start, int end)
 //           << eeidx.data(Qt::DisplayRole).toString();
 //   }
 
-    qreal h = 0;
-    qreal y = 0;
+    int count = end - start + 1;
+    bool atBottom = (start == _lineHeights.count());
     qreal width = _sceneRect.width();
-    bool atBottom = (start == _lines.count());
-    bool atTop = !atBottom && (start == 0);
 
-    if (start < _lines.count()) {
-        y = _lines.value(start)->y();
-    }
-    else if (atBottom && !_lines.isEmpty()) {
-        y = _lines.last()->y() + _lines.last()->height();
+    // renumber the lines after the inserted rows
+    if (!atBottom) {
+        QMap<int, ChatLine *> lines;
+        QMap<int, ChatLine *>::const_iterator iter = _lines.constBegin();
+        for (; iter != _lines.constEnd(); ++iter) {
+            int row = iter.key() < start ? iter.key() : iter.key() + count;
+            (*iter)->setRow(row);
+            lines.insert(row, *iter);
+        }
+        _lines = lines;
     }
 
-    qreal contentsWidth = width - secondColumnHandle()->sceneRight();
-    qreal senderWidth = secondColumnHandle()->sceneLeft() - firstColumnHandle()->sceneRight();
-    qreal timestampWidth = firstColumnHandle()->sceneLeft();
-    QPointF contentsPos(secondColumnHandle()->sceneRight(), 0);
-    QPointF senderPos(firstColumnHandle()->sceneRight(), 0);
-
-    if (atTop) {
-        for (int i = end; i >= start; i--) {
-            ChatLine *line = new ChatLine(i, model(),
-                width,
-                timestampWidth, senderWidth, contentsWidth,
-                senderPos, contentsPos);
-            h += line->height();
-            line->setPos(0, y-h);
-            _lines.insert(start, line);
-            addItem(line);
+    // we only measure the new rows here, ChatLines are created once they come into view
+    QVector<qreal> heights(count);
+    qreal h = 0;
+    if (count <= maxSyncMeasuredRows && isViewVisible()) {
+        for (int i = 0; i < count; i++) {
+            heights[i] = measureRow(start + i, width);
+            h += heights.at(i);
         }
+        _lineHeights.insert(start, heights);
     }
     else {
-        for (int i = start; i <= end; i++) {
-            ChatLine *line = new ChatLine(i, model(),
-                width,
-                timestampWidth, senderWidth, contentsWidth,
-                senderPos, contentsPos);
-            line->setPos(0, y+h);
-            h += line->height();
-            _lines.insert(i, line);
-            addItem(line);
-        }
+        // large batches (e.g. backlog) and rows of hidden views start out with a single line each.
+        // they are measured once they come into view, or later on in refineLineHeights().
+        QFontMetricsF *metrics = QtUi::style()->fontMetrics(UiStyle::PlainMsg | UiStyle::Contents, 0);
+        heights.fill(qMax(metrics->lineSpacing(), metrics->height()));
+        h = count * heights.at(0);
+        _lineHeights.insert(start, heights);
+        _lineHeights.setStale(start, end);
     }
 
-    // update existing items
-    for (int i = end+1; i < _lines.count(); i++) {
-        _lines[i]->setRow(i);
-    }
+    // prepending and inserting in the middle grow the scene upwards, so the lines below stay where they are
+    if (!atBottom)
+        _topPos -= h;
+
+    if (_lastViewportRow >= start)
+        _lastViewportRow += count;
+    if (_refineRow >= start)
+        _refineRow += count;
+    if (atBottom && _pendingAppendRow < 0)
+        _pendingAppendRow = start;
+    else if (_pendingAppendRow >= start)
+        _pendingAppendRow += count;
 
     // update selection
+    // newly inserted rows inside the selection are selected once they get a ChatLine
     if (_selectionStart >= 0) {
-        int offset = end - start + 1;
-        int oldStart = _selectionStart;
         if (_selectionStart >= start)
-            _selectionStart += offset;
-        if (_selectionEnd >= start) {
-            _selectionEnd += offset;
-            if (_selectionStart == oldStart)
-                for (int i = start; i < start + offset; i++)
-                    _lines[i]->setSelected(true);
-        }
+            _selectionStart += count;
+        if (_selectionEnd >= start)
+            _selectionEnd += count;
         if (_firstSelectionRow >= start)
-            _firstSelectionRow += offset;
-    }
-
-    // neither pre- or append means we have to do dirty work: move items...
-    if (!(atTop || atBottom)) {
-        ChatLine *line = 0;
-        for (int i = 0; i <= end; i++) {
-            line = _lines.at(i);
-            line->setPos(0, line->pos().y() - h);
-            if (line == markerLine()->chatLine())
-                markerLine()->setPos(line->pos() + QPointF(0, line->height()));
-        }
+            _firstSelectionRow += count;
     }
 
-    // check if all went right
-    Q_ASSERT(start == 0 || _lines.at(start - 1)->pos().y() + _lines.at(start - 1)->height() == _lines.at(start)->pos().y());
-//   if(start != 0) {
-//     if(_lines.at(start - 1)->pos().y() + _lines.at(start - 1)->height() != _lines.at(start)->pos().y()) {
-//       qDebug() << "lines:" << _lines.count() << "start:" << start << "end:" << end;
-//       qDebug() << "line[start - 1]:" << _lines.at(start - 1)->pos().y() << "+" << _lines.at(start - 1)->height() << "=" << _lines.at(start - 1)->pos().y() + _lines.at(start - 1)->height();
-//       qDebug() << "line[start]" << _lines.at(start)->pos().y();
-//       qDebug() << "needed moving:" << !(atTop || atBottom) << moveTop << moveStart << moveEnd << offset;
-//       Q_ASSERT(false)
-//     }
-//   }
-    Q_ASSERT(end + 1 == _lines.count() || _lines.at(end)->pos().y() + _lines.at(end)->height() == _lines.at(end + 1)->pos().y());
-//   if(end + 1 < _lines.count()) {
-//     if(_lines.at(end)->pos().y() + _lines.at(end)->height() != _lines.at(end + 1)->pos().y()) {
-//       qDebug() << "lines:" << _lines.count() << "start:" << start << "end:" << end;
-//       qDebug() << "line[end]:" << _lines.at(end)->pos().y() << "+" << _lines.at(end)->height() << "=" << _lines.at(end)->pos().y() + _lines.at(end)->height();
-//       qDebug() << "line[end+1]" << _lines.at(end + 1)->pos().y();
-//       qDebug() << "needed moving:" << !(atTop || atBottom) << moveTop << moveStart << moveEnd << offset;
-//       Q_ASSERT(false);
-//     }
-//   }
-
     if (!atBottom) {
-        if (start < _firstLineRow) {
-            int prevFirstLineRow = _firstLineRow + (end - start + 1);
-            for (int i = end + 1; i < prevFirstLineRow; i++) {
-                _lines.at(i)->show();
-            }
-        }
         // force new search for first proper line
         _firstLineRow = -1;
     }
-    updateSceneRect();
-    if (atBottom) {
-        emit lastLineChanged(_lines.last(), h);
-    }
 
-    // now move the marker line if necessary. we don't need to do anything if we appended lines though...
-    if (!_markerLineValid)
-        setMarkerLine();
+    // the scene rect, line positions and scrolling are updated with the next frame
+    scheduleFrame();
 }
 
 
@@ -467,10 +471,13 @@ void ChatScene::rowsAboutToBeRemoved(const QModelIndex &parent, int start, int e
 {
     Q_UNUSED(parent);
 
-    qreal h = 0; // total height of removed items;
-
+    int count = end - start + 1;
     bool atTop = (start == 0);
-    bool atBottom = (end == _lines.count() - 1);
+    bool atBottom = (end == _lineHeights.count() - 1);
+
+    // The model still contains the rows, so we must not create any lines until they are gone.
+    // Lines will be updated in rowsRemoved().
+    _updatingLines = true;
 
     // clear selection
     if (_selectingItem) {
@@ -479,22 +486,44 @@ void ChatScene::rowsAboutToBeRemoved(const QModelIndex &parent, int start, int e
             setSelectingItem(0);
     }
 
-    // remove items from scene
-    QList<ChatLine *>::iterator lineIter = _lines.begin() + start;
-    int lineCount = start;
-    while (lineIter != _lines.end() && lineCount <= end) {
-        if ((*lineIter) == markerLine()->chatLine())
-            markerLine()->setChatLine(0);
-        h += (*lineIter)->height();
-        delete *lineIter;
-        lineIter = _lines.erase(lineIter);
-        lineCount++;
-    }
-
-    // update rows of remaining chatlines
-    for (int i = start; i < _lines.count(); i++) {
-        _lines.at(i)->setRow(i);
+    // remove items from scene and renumber the remaining ones
+    QMap<int, ChatLine *> lines;
+    QMap<int, ChatLine *>::const_iterator iter = _lines.constBegin();
+    for (; iter != _lines.constEnd(); ++iter) {
+        int row = iter.key();
+        if (row < start) {
+            lines.insert(row, *iter);
+        }
+        else if (row > end) {
+            (*iter)->setRow(row - count);
+            lines.insert(row - count, *iter);
+        }
+        else {
+            delete *iter;
+        }
     }
+    _lines = lines;
+
+    qreal h = _lineHeights.offset(end + 1) - _lineHeights.offset(start); // total height of removed items
+    _lineHeights.remove(start, count);
+
+    // removing at the top keeps the lines below in place, removing at the bottom doesn't move anything.
+    // otherwise we move the smaller part.
+    if (atTop || (!atBottom && start < _lineHeights.count() - start))
+        _topPos += h;
+
+    if (_lastViewportRow > end)
+        _lastViewportRow -= count;
+    else if (_lastViewportRow >= start)
+        _lastViewportRow = start - 1;
+    if (_refineRow > end)
+        _refineRow -= count;
+    else if (_refineRow >= start)
+        _refineRow = start - 1;
+    if (_pendingAppendRow > end)
+        _pendingAppendRow -= count;
+    else if (_pendingAppendRow >= start)
+        _pendingAppendRow = start < _lineHeights.count() ? start : -1;
 
     // update selection
     if (_selectionStart >= 0) {
@@ -512,29 +541,6 @@ void ChatScene::rowsAboutToBeRemoved(const QModelIndex &parent, int start, int e
         }
     }
 
-    // neither removing at bottom or top means we have to move items...
-    if (!(atTop || atBottom)) {
-        qreal offset = h;
-        int moveStart = 0;
-        int moveEnd = _lines.count() - 1;
-        if (start < _lines.count() - start) {
-            // move top part
-            moveEnd = start - 1;
-        }
-        else {
-            // move bottom part
-            moveStart = start;
-            offset = -offset;
-        }
-        ChatLine *line = 0;
-        for (int i = moveStart; i <= moveEnd; i++) {
-            line = _lines.at(i);
-            line->setPos(0, line->pos().y() + offset);
-        }
-    }
-
-    Q_ASSERT(start == 0 || start >= _lines.count() || _lines.at(start - 1)->pos().y() + _lines.at(start - 1)->height() == _lines.at(start)->pos().y());
-
     // update sceneRect
     // when searching for the first non-date-line we have to take into account that our
     // model still contains the just removed lines so we cannot simply call updateSceneRect()
@@ -554,23 +560,73 @@ void ChatScene::rowsAboutToBeRemoved(const QModelIndex &parent, int start, int e
 
     if (needOffset)
         _firstLineRow -= end - start + 1;
-    updateSceneRect();
+
+    _updatingLines = false;
 }
 
 
 void ChatScene::rowsRemoved()
 {
-    // move the marker line if necessary
-    setMarkerLine();
+    // the lines are updated and the marker line is moved with the next frame
+    scheduleFrame();
 }
 
 
 void ChatScene::dataChanged(const QModelIndex &tl, const QModelIndex &br)
 {
+    if (!isViewVisible()) {
+        _lineHeights.setStale(tl.row(), br.row());
+        scheduleFrame();
+        return;
+    }
     layout(tl.row(), br.row(), _sceneRect.width());
 }
 
 
+bool ChatScene::isViewVisible() const
+{
+    return _chatView && _chatView->isVisible();
+}
+
+
+void ChatScene::scheduleFrame()
+{
+    _framePending = true;
+    if (!_frameTimer.isActive())
+        _frameTimer.start();
+}
+
+
+void ChatScene::frameTimeout()
+{
+    // hidden views keep their changes until they are shown again, see processPendingChanges()
+    if (isViewVisible())
+        processPendingChanges();
+}
+
+
+void ChatScene::processPendingChanges()
+{
+    if (!_framePending)
+        return;
+
+    _framePending = false;
+    _frameTimer.stop();
+
+    updateSceneRect();
+    positionLines();
+    setMarkerLine();
+    updateLines();
+
+    if (_pendingAppendRow >= 0) {
+        int lastRow = _lineHeights.count() - 1;
+        qreal h = _lineHeights.offset(lastRow + 1) - _lineHeights.offset(_pendingAppendRow);
+        _pendingAppendRow = -1;
+        emit lastLineChanged(_lines.value(lastRow), h);
+    }
+}
+
+
 void ChatScene::updateForViewport(qreal width, qreal height)
 {
     _viewportHeight = height;
@@ -582,7 +638,14 @@ void ChatScene::setWidth(qreal width)
 {
     if (width == _sceneRect.width())
         return;
-    layout(0, _lines.count()-1, width);
+    layout(0, _lineHeights.count()-1, width);
+}
+
+
+void ChatScene::setViewportRect(const QRectF &rect)
+{
+    _viewportRect = rect;
+    updateLines();
 }
 
 
@@ -590,37 +653,29 @@ void ChatScene::layout(int start, int end, qreal width)
 {
     // clock_t startT = clock();
 
-    // disabling the index while doing this complex updates is about
-    // 2 to 10 times faster!
-    //setItemIndexMethod(QGraphicsScene::NoIndex);
-
     if (end >= 0) {
-        int row = end;
-        qreal linePos = _lines.at(row)->scenePos().y() + _lines.at(row)->height();
-        qreal contentsWidth = width - secondColumnHandle()->sceneRight();
-        while (row >= start) {
-            _lines.at(row--)->setGeometryByWidth(width, contentsWidth, linePos);
+        // We only relayout the lines that exist and small ranges right away. Everything else is marked as stale
+        // and measured once it comes into view, or in the background (see refineLineHeights()).
+        _lineHeights.setStale(start, end);
+        if (end - start < maxSyncMeasuredRows) {
+            for (int row = end; row >= start; row--)
+                setRowHeight(row, measureRow(row, width));
         }
-
-        if (row >= 0) {
-            // remaining items don't need geometry changes, but maybe repositioning?
-            ChatLine *line = _lines.at(row);
-            qreal offset = linePos - (line->scenePos().y() + line->height());
-            if (offset != 0) {
-                while (row >= 0) {
-                    line = _lines.at(row--);
-                    line->setPos(0, line->scenePos().y() + offset);
-                }
+        else {
+            QMap<int, ChatLine *>::const_iterator iter = _lines.lowerBound(start);
+            while (iter != _lines.constEnd() && iter.key() <= end) {
+                setRowHeight(iter.key(), measureRow(iter.key(), width));
+                ++iter;
             }
         }
     }
 
-    //setItemIndexMethod(QGraphicsScene::BspTreeIndex);
-
     updateSceneRect(width);
+    positionLines();
     setHandleXLimits();
     setMarkerLine();
     emit layoutChanged();
+    updateLines();
 
 //   clock_t endT = clock();
 //   qDebug() << "resized" << _lines.count() << "in" << (float)(endT - startT) / CLOCKS_PER_SEC << "sec";
@@ -644,15 +699,13 @@ void ChatScene::firstHandlePositionChanged(qreal xpos)
     // 2 to 10 times faster!
     //setItemIndexMethod(QGraphicsScene::NoIndex);
 
-    QList<ChatLine *>::iterator lineIter = _lines.end();
-    QList<ChatLine *>::iterator lineIterBegin = _lines.begin();
     qreal timestampWidth = firstColumnHandle()->sceneLeft();
     qreal senderWidth = secondColumnHandle()->sceneLeft() - firstColumnHandle()->sceneRight();
     QPointF senderPos(firstColumnHandle()->sceneRight(), 0);
 
-    while (lineIter != lineIterBegin) {
-        --lineIter;
-        (*lineIter)->setFirstColumn(timestampWidth, senderWidth, senderPos);
+    // lines created later on pick up the new geometry by themselves
+    foreach(ChatLine *line, _lines) {
+        line->setFirstColumn(timestampWidth, senderWidth, senderPos);
     }
     //setItemIndexMethod(QGraphicsScene::BspTreeIndex);
 
@@ -680,21 +733,28 @@ void ChatScene::secondHandlePositionChanged(qreal xpos)
     // 2 to 10 times faster!
     //setItemIndexMethod(QGraphicsScene::NoIndex);
 
-    QList<ChatLine *>::iterator lineIter = _lines.end();
-    QList<ChatLine *>::iterator lineIterBegin = _lines.begin();
-    qreal linePos = _sceneRect.y() + _sceneRect.height();
     qreal senderWidth = secondColumnHandle()->sceneLeft() - firstColumnHandle()->sceneRight();
     qreal contentsWidth = _sceneRect.width() - secondColumnHandle()->sceneRight();
     QPointF contentsPos(secondColumnHandle()->sceneRight(), 0);
-    while (lineIter != lineIterBegin) {
-        --lineIter;
-        (*lineIter)->setSecondColumn(senderWidth, contentsWidth, contentsPos, linePos);
+
+    // the contents width changed, so all heights need to be measured again.
+    // rows without a ChatLine are handled lazily.
+    if (_lineHeights.count())
+        _lineHeights.setStale(0, _lineHeights.count() - 1);
+    QMap<int, ChatLine *>::const_iterator iter = _lines.constBegin();
+    for (; iter != _lines.constEnd(); ++iter) {
+        qreal linePos = 0;
+        (*iter)->setSecondColumn(senderWidth, contentsWidth, contentsPos, linePos);
+        setRowHeight(iter.key(), (*iter)->height());
     }
     //setItemIndexMethod(QGraphicsScene::BspTreeIndex);
 
     updateSceneRect();
+    positionLines();
     setHandleXLimits();
+    setMarkerLine();
     emit layoutChanged();
+    updateLines();
 
 //   clock_t endT = clock();
 //   qDebug() << "resized" << _lines.count() << "in" << (float)(endT - startT) / CLOCKS_PER_SEC << "sec";
@@ -721,7 +781,7 @@ void ChatScene::startGlobalSelection(ChatItem *item, const QPointF &itemPos)
     _selectionStart = _selectionEnd = _firstSelectionRow = item->row();
     _selectionStartCol = _selectionMinCol = item->column();
     _isSelecting = true;
-    _lines[_selectionStart]->setSelected(true, (ChatLineModel::ColumnType)_selectionMinCol);
+    setLinesSelected(_selectionStart, _selectionStart, true, (ChatLineModel::ColumnType)_selectionMinCol);
     updateSelection(item->mapToScene(itemPos));
 }
 
@@ -734,28 +794,18 @@ void ChatScene::updateSelection(const QPointF &pos)
     ChatLineModel::ColumnType minColumn = (ChatLineModel::ColumnType)qMin(curColumn, _selectionStartCol);
     if (minColumn != _selectionMinCol) {
         _selectionMinCol = minColumn;
-        for (int l = qMin(_selectionStart, _selectionEnd); l <= qMax(_selectionStart, _selectionEnd); l++) {
-            _lines[l]->setSelected(true, minColumn);
-        }
+        setLinesSelected(qMin(_selectionStart, _selectionEnd), qMax(_selectionStart, _selectionEnd), true, minColumn);
     }
     int newstart = qMin(curRow, _firstSelectionRow);
     int newend = qMax(curRow, _firstSelectionRow);
-    if (newstart < _selectionStart) {
-        for (int l = newstart; l < _selectionStart; l++)
-            _lines[l]->setSelected(true, minColumn);
-    }
-    if (newstart > _selectionStart) {
-        for (int l = _selectionStart; l < newstart; l++)
-            _lines[l]->setSelected(false);
-    }
-    if (newend > _selectionEnd) {
-        for (int l = _selectionEnd+1; l <= newend; l++)
-            _lines[l]->setSelected(true, minColumn);
-    }
-    if (newend < _selectionEnd) {
-        for (int l = newend+1; l <= _selectionEnd; l++)
-            _lines[l]->setSelected(false);
-    }
+    if (newstart < _selectionStart)
+        setLinesSelected(newstart, _selectionStart - 1, true, minColumn);
+    if (newstart > _selectionStart)
+        setLinesSelected(_selectionStart, newstart - 1, false);
+    if (newend > _selectionEnd)
+        setLinesSelected(_selectionEnd + 1, newend, true, minColumn);
+    if (newend < _selectionEnd)
+        setLinesSelected(newend + 1, _selectionEnd, false);
 
     _selectionStart = newstart;
     _selectionEnd = newend;
@@ -765,7 +815,7 @@ void ChatScene::updateSelection(const QPointF &pos)
             // _selectingItem has been removed already
             return;
         }
-        _lines[curRow]->setSelected(false);
+        setLinesSelected(curRow, curRow, false);
         _isSelecting = false;
         _selectionStart = -1;
         _selectingItem->continueSelecting(_selectingItem->mapFromScene(pos));
@@ -773,6 +823,17 @@ void ChatScene::updateSelection(const QPointF &pos)
 }
 
 
+// Rows without a ChatLine get their selection state when the line is created
+void ChatScene::setLinesSelected(int start, int end, bool selected, ChatLineModel::ColumnType minColumn)
+{
+    QMap<int, ChatLine *>::const_iterator iter = _lines.lowerBound(start);
+    while (iter != _lines.constEnd() && iter.key() <= end) {
+        (*iter)->setSelected(selected, minColumn);
+        ++iter;
+    }
+}
+
+
 bool ChatScene::isPosOverSelection(const QPointF &pos) const
 {
     ChatItem *chatItem = chatItemAt(pos);
@@ -1016,17 +1077,17 @@ QString ChatScene::selection() const
     if (hasGlobalSelection()) {
         int start = qMin(_selectionStart, _selectionEnd);
         int end = qMax(_selectionStart, _selectionEnd);
-        if (start < 0 || end >= _lines.count()) {
+        if (start < 0 || end >= _lineHeights.count()) {
             qDebug() << "Invalid selection range:" << start << end;
             return QString();
         }
         QString result;
         for (int l = start; l <= end; l++) {
             if (_selectionMinCol == ChatLineModel::TimestampColumn)
-                result += _lines[l]->item(ChatLineModel::TimestampColumn)->data(MessageModel::DisplayRole).toString() + " ";
+                result += model()->index(l, ChatLineModel::TimestampColumn).data(MessageModel::DisplayRole).toString() + " ";
             if (_selectionMinCol <= ChatLineModel::SenderColumn)
-                result += _lines[l]->item(ChatLineModel::SenderColumn)->data(MessageModel::DisplayRole).toString() + " ";
-            result += _lines[l]->item(ChatLineModel::ContentsColumn)->data(MessageModel::DisplayRole).toString() + "\n";
+                result += model()->index(l, ChatLineModel::SenderColumn).data(MessageModel::DisplayRole).toString() + " ";
+            result += model()->index(l, ChatLineModel::ContentsColumn).data(MessageModel::DisplayRole).toString() + "\n";
         }
         return result;
     }
@@ -1057,8 +1118,7 @@ bool ChatScene::isGloballySelecting() const
 void ChatScene::clearGlobalSelection()
 {
     if (hasGlobalSelection()) {
-        for (int l = qMin(_selectionStart, _selectionEnd); l <= qMax(_selectionStart, _selectionEnd); l++)
-            _lines[l]->setSelected(false);
+        setLinesSelected(qMin(_selectionStart, _selectionEnd), qMax(_selectionStart, _selectionEnd), false);
         _isSelecting = false;
         _selectionStart = -1;
     }
@@ -1112,48 +1172,39 @@ ChatLineModel::ColumnType ChatScene::columnByScenePos(qreal x) const
 
 int ChatScene::rowByScenePos(qreal y) const
 {
-    QList<QGraphicsItem *> itemList = items(QPointF(0, y));
+    if (y < _topPos)
+        return -1;
 
-    // ChatLine should be at the bottom of the list
-    for (int i = itemList.count()-1; i >= 0; i--) {
-        ChatLine *line = qgraphicsitem_cast<ChatLine *>(itemList.at(i));
-        if (line)
-            return line->row();
-    }
-    return -1;
+    int row = _lineHeights.rowAt(y - _topPos);
+    return row < _lineHeights.count() ? row : -1;
 }
 
 
 void ChatScene::updateSceneRect(qreal width)
 {
-    if (_lines.isEmpty()) {
+    if (!_lineHeights.count()) {
         updateSceneRect(QRectF(0, 0, width, 0));
         return;
     }
 
     // we hide day change messages at the top by making the scene rect smaller
-    // and by calling QGraphicsItem::hide() on all leading day change messages
+    // and by hiding the ChatLines of all leading day change messages (see positionLines())
     // the first one is needed to ensure proper scrollbar ranges
     // the second for cases where the viewport is larger then the set scenerect
     //  (in this case the items are shown anyways)
     if (_firstLineRow == -1) {
         int numRows = model()->rowCount();
         _firstLineRow = 0;
-        QModelIndex firstLineIdx;
         while (_firstLineRow < numRows) {
-            firstLineIdx = model()->index(_firstLineRow, 0);
-            if ((Message::Type)(model()->data(firstLineIdx, MessageModel::TypeRole).toInt()) != Message::DayChange)
+            if (rowType(_firstLineRow) != Message::DayChange)
                 break;
-            _lines.at(_firstLineRow)->hide();
             _firstLineRow++;
         }
     }
 
-    // the following call should be safe. If it crashes something went wrong during insert/remove
-    if (_firstLineRow < _lines.count()) {
-        ChatLine *firstLine = _lines.at(_firstLineRow);
-        ChatLine *lastLine = _lines.last();
-        updateSceneRect(QRectF(0, firstLine->pos().y(), width, lastLine->pos().y() + lastLine->height() - firstLine->pos().y()));
+    if (_firstLineRow < _lineHeights.count()) {
+        qreal top = rowPos(_firstLineRow);
+        updateSceneRect(QRectF(0, top, width, _topPos + _lineHeights.totalHeight() - top));
     }
     else {
         // empty scene rect
@@ -1170,6 +1221,239 @@ void ChatScene::updateSceneRect(const QRectF &rect)
 }
 
 
+/******** LINE MANAGEMENT *************************************************************************/
+
+Message::Type ChatScene::rowType(int row) const
+{
+    return (Message::Type)model()->index(row, 0).data(MessageModel::TypeRole).toInt();
+}
+
+
+ChatLine *ChatScene::createLine(int row)
+{
+    qreal width = _sceneRect.width();
+    qreal contentsWidth = width - secondColumnHandle()->sceneRight();
+    qreal senderWidth = secondColumnHandle()->sceneLeft() - firstColumnHandle()->sceneRight();
+    qreal timestampWidth = firstColumnHandle()->sceneLeft();
+    QPointF contentsPos(secondColumnHandle()->sceneRight(), 0);
+    QPointF senderPos(firstColumnHandle()->sceneRight(), 0);
+
+    ChatLine *line = new ChatLine(row, model(),
+        width,
+        timestampWidth, senderWidth, contentsWidth,
+        senderPos, contentsPos);
+    _lines.insert(row, line);
+    addItem(line);
+
+    if (hasGlobalSelection() && row >= qMin(_selectionStart, _selectionEnd) && row <= qMax(_selectionStart, _selectionEnd))
+        line->setSelected(true, (ChatLineModel::ColumnType)_selectionMinCol);
+
+    // a stale height stays in the index until the row is measured, so the line might overlap its neighbours until then
+    line->setPos(0, rowPos(row));
+    line->setVisible(row >= _firstLineRow);
+    return line;
+}
+
+
+bool ChatScene::isLinePinned(ChatLine *line) const
+{
+    // lines we're selecting in must stay. Items attached to lines (e.g. search highlights) are
+    // recreated by their owners when the line comes back, see linesChanged().
+    return _selectingItem && _selectingItem->chatLine() == line;
+}
+
+
+void ChatScene::updateLines()
+{
+    // there's no point in creating and measuring lines nobody sees
+    if (!isViewVisible()) {
+        scheduleFrame();
+        return;
+    }
+
+    // changing the geometry changes the scene rect, which in turn makes the view tell us about its new viewport
+    if (_updatingLines) {
+        _linesUpdatePending = true;
+        return;
+    }
+
+    _updatingLines = true;
+    int passes = 0;
+    do {
+        _linesUpdatePending = false;
+        updateLinesForViewport();
+    }
+    while (_linesUpdatePending && ++passes < 3);
+    _updatingLines = false;
+}
+
+
+void ChatScene::updateLinesForViewport()
+{
+    int rowCount = _lineHeights.count();
+    qreal width = _sceneRect.width();
+    qreal oldTopPos = _topPos;
+    qreal oldHeight = _lineHeights.totalHeight();
+
+    // we keep lines for an additional viewport height above and below the visible area
+    qreal margin = qMax(_viewportRect.height(), (qreal)100);
+    qreal top = _viewportRect.top() - margin;
+    qreal bottom = _viewportRect.bottom() + margin;
+
+    int firstRow = rowCount;
+    int lastRow = -1;
+    bool lineSetChanged = false;
+    if (rowCount && !_viewportRect.isEmpty() && bottom > _topPos && top < _topPos + _lineHeights.totalHeight()) {
+        lastRow = qMin(_lineHeights.rowAt(bottom - _topPos), rowCount - 1);
+        _lastViewportRow = lastRow;
+
+        // We go upwards from the bottom, and measuring a row keeps its bottom edge in place. Thus the rows we've
+        // already handled don't move, even if the heights of the rows above were only estimates.
+        for (firstRow = lastRow; firstRow >= 0; firstRow--) {
+            if (rowPos(firstRow + 1) <= top)
+                break;
+
+            ChatLine *line = _lines.value(firstRow);
+            bool created = !line;
+            if (created) {
+                line = createLine(firstRow);
+                lineSetChanged = true;
+            }
+            if (_lineHeights.isStale(firstRow))
+                setRowHeight(firstRow, created ? line->height() : measureRow(firstRow, width));
+        }
+        firstRow++;
+
+        // have the wrap lists of the rows we're likely to scroll to next computed in the background
+        int window = lastRow - firstRow + 1;
+        ChatLayoutService::instance()->prefetch(model(), firstRow - 2 * window, lastRow + 2 * window);
+    }
+
+    // drop lines that are out of reach. We leave some slack, so scrolling back and forth doesn't recreate them all the time.
+    QMap<int, ChatLine *>::iterator iter = _lines.begin();
+    while (iter != _lines.end()) {
+        int row = iter.key();
+        if ((row < firstRow || row > lastRow) && !isLinePinned(*iter)
+            && (lastRow < 0 || rowPos(row + 1) <= top - margin || rowPos(row) >= bottom + margin)) {
+            (*iter)->clearCache(); // keeps the layouts around for a while
+            delete *iter;
+            iter = _lines.erase(iter);
+            lineSetChanged = true;
+        }
+        else {
+            ++iter;
+        }
+    }
+
+    positionLines();
+    if (_topPos != oldTopPos || _lineHeights.totalHeight() != oldHeight) {
+        updateSceneRect();
+        setMarkerLine();
+        emit layoutChanged();
+    }
+    if (lineSetChanged)
+        emit linesChanged();
+
+    if (_lineHeights.staleCount() && !_refineTimer.isActive()) {
+        _refineRow = _lastViewportRow;
+        _refineTimer.start();
+    }
+}
+
+
+void ChatScene::positionLines()
+{
+    QMap<int, ChatLine *>::const_iterator iter = _lines.constBegin();
+    for (; iter != _lines.constEnd(); ++iter) {
+        (*iter)->setPos(0, rowPos(iter.key()));
+        (*iter)->setVisible(iter.key() >= _firstLineRow);
+    }
+}
+
+
+qreal ChatScene::measureRow(int row, qreal width)
+{
+    qreal contentsWidth = width - secondColumnHandle()->sceneRight();
+    ChatLine *line = _lines.value(row);
+    if (!line) {
+        if (!_measureLine) {
+            // this one never becomes part of the scene, so the column geometry doesn't matter
+            _measureLine = new ChatLine(row, model(), width, 0, 0, contentsWidth, QPointF(), QPointF());
+            return _measureLine->height();
+        }
+        line = _measureLine;
+        line->setRow(row);
+    }
+
+    // this also moves the line, so callers need to reposition it
+    qreal linePos = 0;
+    line->setGeometryByWidth(width, contentsWidth, linePos);
+    return line->height();
+}
+
+
+void ChatScene::setRowHeight(int row, qreal height)
+{
+    qreal delta = _lineHeights.setHeight(row, height);
+
+    // rows in and above the viewport grow upwards, rows below it downwards. this way what we see doesn't move.
+    if (_lastViewportRow < 0 || row <= _lastViewportRow)
+        _topPos -= delta;
+}
+
+
+void ChatScene::refineLineHeights()
+{
+    // we measure stale rows in chunks, so relayouting a huge scene doesn't block the UI
+    static const int chunkSize = 200;
+
+    // hidden views are refined once they are shown again, see processPendingChanges()
+    if (!isViewVisible()) {
+        scheduleFrame();
+        return;
+    }
+
+    ChatLayoutService *layoutService = ChatLayoutService::instance();
+    int rowCount = _lineHeights.count();
+    qreal width = _sceneRect.width();
+    int measured = 0;
+    bool waiting = false;
+    while (_lineHeights.staleCount() && measured < chunkSize) {
+        if (_refineRow < 0 || _refineRow >= rowCount)
+            _refineRow = rowCount - 1;
+        if (_lineHeights.isStale(_refineRow)) {
+            // computing the wrap list is the expensive part of measuring, so we leave that to the layout service.
+            // wrapListsReady() restarts us once it's done.
+            if (!layoutService->hasWrapList(model(), _refineRow)) {
+                layoutService->prefetch(model(), _refineRow - 2 * chunkSize, _refineRow);
+                waiting = true;
+                break;
+            }
+            setRowHeight(_refineRow, measureRow(_refineRow, width));
+            measured++;
+        }
+        _refineRow--;
+    }
+
+    if (measured) {
+        updateSceneRect();
+        positionLines();
+        setMarkerLine();
+        emit layoutChanged();
+    }
+
+    if (_lineHeights.staleCount() && !waiting)
+        _refineTimer.start();
+}
+
+
+void ChatScene::wrapListsReady()
+{
+    if (_lineHeights.staleCount() && !_refineTimer.isActive())
+        _refineTimer.start();
+}
+
+
 // ========================================
 //  Webkit Only stuff
 // ========================================
@@ -1205,6 +1489,8 @@ void ChatScene::loadWebPreview(ChatItem *parentItem, const QUrl &url, const QRec
     case WebPreview::NoPreview:
         webPreview.previewState = WebPreview::NewPreview;
         webPreview.timer.start(500);
+        // the service waits as long before it loads anything, and drops the request if we move on
+        WebPreviewService::instance()->request(webPreview.url);
         break;
     case WebPreview::NewPreview:
     case WebPreview::DelayPreview:
@@ -1270,12 +1556,20 @@ void ChatScene::webPreviewNextStep()
 }
 
 
+void ChatScene::webPreviewReady(const QUrl &url)
+{
+    if (webPreview.previewItem && webPreview.url == url)
+        static_cast<WebPreviewItem *>(webPreview.previewItem)->setPixmap(WebPreviewService::instance()->preview(url));
+}
+
+
 void ChatScene::clearWebPreview(ChatItem *parentItem)
 {
     // qDebug() << Q_FUNC_INFO << webPreview.previewState;
     switch (webPreview.previewState) {
     case WebPreview::NewPreview:
         webPreview.previewState = WebPreview::NoPreview; // we haven't loaded anything yet
+        WebPreviewService::instance()->cancel(webPreview.url);
         break;
     case WebPreview::ShowPreview:
         if (parentItem == 0 || webPreview.parentItem == parentItem) {
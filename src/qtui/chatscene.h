@@ -25,10 +25,12 @@
 #include <QClipboard>
 #include <QGraphicsItem>
 #include <QGraphicsScene>
+#include <QMap>
 #include <QSet>
 #include <QTimer>
 #include <QUrl>
 
+#include "chatlineheightindex.h"
 #include "chatlinemodel.h"
 #include "messagefilter.h"
 
@@ -86,23 +88,32 @@ public:
 
     ChatView *chatView() const;
     ChatItem *chatItemAt(const QPointF &pos) const;
-    inline ChatLine *chatLine(int row) const { return (row < _lines.count()) ? _lines.value(row) : 0; }
-    inline ChatLine *chatLine(const QModelIndex &index) const { return _lines.value(index.row()); }
+    //! Return the ChatLine for the given row
+    /** The scene only keeps ChatLines for the rows around the visible area. Lines for other rows are created
+     *  on demand and dropped again with the next viewport update, unless they have child items (e.g. search
+     *  highlights) attached.
+     */
+    ChatLine *chatLine(int row);
+    inline ChatLine *chatLine(const QModelIndex &index) { return chatLine(index.row()); }
+    //! The ChatLines that currently exist, by row. Lines are only kept for the rows in and around the viewport.
+    inline const QMap<int, ChatLine *> &chatLines() const { return _lines; }
 
-    //! Find the ChatLine belonging to a MsgId
-    /** Searches for the ChatLine belonging to a MsgId. If there are more than one ChatLine with the same msgId,
+    //! Find the row belonging to a MsgId
+    /** Searches for the row belonging to a MsgId. If there are more than one row with the same msgId,
      *  the first one is returned.
      *  Note that this method performs a binary search, hence it has as complexity of O(log n).
-     *  If matchExact is false, and we don't have an exact match for the given msgId, we return the visible line right
+     *  If matchExact is false, and we don't have an exact match for the given msgId, we return the visible row right
      *  above the requested one.
      *  \param msgId      The message ID to look for
      *  \param matchExact Whether we find only exact matches
      *  \param ignoreDayChange Whether we ignore day change messages
-     *  \return The ChatLine corresponding to the given MsgId
+     *  \return The row corresponding to the given MsgId, or -1 if there is none
      */
-    ChatLine *chatLine(MsgId msgId, bool matchExact = true, bool ignoreDayChange = true) const;
+    int rowByMsgId(MsgId msgId, bool matchExact = true, bool ignoreDayChange = true) const;
 
-    inline ChatLine *lastLine() const { return _lines.count() ? _lines.last() : 0; }
+    //! The scene position of the top edge of a row
+    inline qreal rowPos(int row) const { return _topPos + _lineHeights.offset(row); }
+    inline qreal rowHeight(int row) const { return _lineHeights.height(row); }
 
     inline MarkerLineItem *markerLine() const { return _markerLine; }
 
@@ -127,9 +138,17 @@ public:
 
 public slots:
     void updateForViewport(qreal width, qreal height);
+    //! Tell the scene which part of it is currently shown, so it can provide ChatLines for it
+    void setViewportRect(const QRectF &rect);
     void setWidth(qreal width);
     void layout(int start, int end, qreal width);
 
+    //! Applies the model changes collected since the last frame right away
+    /** Changes are normally applied once per frame, and not at all while the view is hidden.
+     *  The view calls this when it is shown.
+     */
+    void processPendingChanges();
+
     void resetColumnWidths();
 
     void setMarkerLineVisible(bool visible = true);
@@ -157,6 +176,7 @@ public slots:
 signals:
     void lastLineChanged(QGraphicsItem *item, qreal offset);
     void layoutChanged(); // indicates changes to the scenerect due to resizing of the contentsitems
+    void linesChanged(); // ChatLines have been created or deleted while following the viewport
     void mouseMoveWhileSelecting(const QPointF &scenePos);
 
 protected:
@@ -177,23 +197,57 @@ private slots:
     void secondHandlePositionChanged(qreal xpos);
 #ifdef HAVE_WEBKIT
     void webPreviewNextStep();
+    void webPreviewReady(const QUrl &url);
 #endif
     void showWebPreviewChanged();
 
     void rowsRemoved();
+    void wrapListsReady();
 
     void clickTimeout();
 
+    void updateLines();
+    void refineLineHeights();
+    void frameTimeout();
+
 private:
     void setHandleXLimits();
     void updateSelection(const QPointF &pos);
+    void setLinesSelected(int start, int end, bool selected, ChatLineModel::ColumnType minColumn = ChatLineModel::ContentsColumn);
+
+    Message::Type rowType(int row) const;
+    ChatLine *createLine(int row);
+    bool isLinePinned(ChatLine *line) const;
+    void updateLinesForViewport();
+    void positionLines();
+    qreal measureRow(int row, qreal width);
+    void setRowHeight(int row, qreal height);
+    bool isViewVisible() const;
+    void scheduleFrame();
 
     ChatView *_chatView;
     QString _idString;
     QAbstractItemModel *_model;
-    QList<ChatLine *> _lines;
     BufferId _singleBufferId;
 
+    // Only the rows around the viewport have a ChatLine; the geometry of all rows is kept in the height index.
+    // A row's scene position is _topPos plus the heights of all rows above it.
+    ChatLineHeightIndex _lineHeights;
+    qreal _topPos;
+    QMap<int, ChatLine *> _lines;
+    ChatLine *_measureLine; // not part of the scene, used for measuring rows without a ChatLine
+    QRectF _viewportRect;
+    int _lastViewportRow; // changed heights of rows up to this one grow upwards, so the viewport doesn't move
+    bool _updatingLines, _linesUpdatePending;
+    QTimer _updateLinesTimer;
+    QTimer _refineTimer;
+    int _refineRow;
+
+    // model changes only update the bookkeeping right away; geometry and scrolling follow once per frame
+    QTimer _frameTimer;
+    bool _framePending;
+    int _pendingAppendRow; // first row appended at the bottom since the last frame, -1 if none
+
     // calls to QChatScene::sceneRect() are very expensive. As we manage the scenerect ourselves
     // we store the size in a member variable.
     QRectF _sceneRect;
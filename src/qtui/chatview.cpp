@@ -84,10 +84,6 @@ void ChatView::init(MessageFilter *filter)
     _lastScrollbarPos = verticalScrollBar()->maximum();
 
     connect(Client::networkModel(), SIGNAL(markerLineSet(BufferId, MsgId)), SLOT(markerLineSet(BufferId, MsgId)));
-
-    // only connect if client is synched with a core
-    if (Client::isConnected())
-        connect(Client::ignoreListManager(), SIGNAL(ignoreListChanged()), this, SLOT(invalidateFilter()));
 }
 
 
@@ -163,6 +159,8 @@ bool ChatView::event(QEvent *event)
     if (event->type() == QEvent::Show) {
         if (_invalidateFilter)
             invalidateFilter();
+        // the scene doesn't lay out anything while we're hidden
+        scene()->processPendingChanges();
     }
 
     return QGraphicsView::event(event);
@@ -191,6 +189,7 @@ void ChatView::resizeEvent(QResizeEvent *event)
         _lastScrollbarPos = verticalScrollBar()->maximum();
         verticalScrollBar()->setValue(verticalScrollBar()->maximum());
     }
+    updateViewportRect();
     checkChatLineCaches();
 }
 
@@ -205,6 +204,14 @@ void ChatView::adjustSceneRect()
     // by some hopefully large enough value to avoid this problem.
 
     setSceneRect(scene()->sceneRect().adjusted(0, 0, -25, 0));
+    updateViewportRect();
+}
+
+
+// The scene only creates ChatLines for the part of it we show
+void ChatView::updateViewportRect()
+{
+    scene()->setViewportRect(mapToScene(viewport()->rect()).boundingRect());
 }
 
 
@@ -248,18 +255,23 @@ void ChatView::lastLineChanged(QGraphicsItem *chatLine, qreal offset)
 }
 
 
+// Number of viewport heights above the visible area in which scrolling up triggers a backlog request
+static const int backlogFetchAheadPages = 3;
+
 void ChatView::verticalScrollbarChanged(int newPos)
 {
     QAbstractSlider *vbar = verticalScrollBar();
     Q_ASSERT(vbar);
 
     // check for backlog request
+    // We fetch a few pages ahead of the viewport rather than only near the top of the whole (possibly short)
+    // scene, so the backlog is usually there by the time the user scrolls into it.
     if (newPos < _lastScrollbarPos) {
         int relativePos = 100;
         if (vbar->maximum() - vbar->minimum() != 0)
             relativePos = (newPos - vbar->minimum()) * 100 / (vbar->maximum() - vbar->minimum());
 
-        if (relativePos < 20) {
+        if (relativePos < 20 || newPos - vbar->minimum() < backlogFetchAheadPages * vbar->pageStep()) {
             scene()->requestBacklog();
         }
     }
@@ -394,6 +406,7 @@ void ChatView::zoomIn()
     _currentScaleFactor *= 1.2;
     scale(1.2, 1.2);
     scene()->setWidth(viewport()->width() / _currentScaleFactor - 2);
+    updateViewportRect();
 }
 
 
@@ -402,6 +415,7 @@ void ChatView::zoomOut()
     _currentScaleFactor /= 1.2;
     scale(1 / 1.2, 1 / 1.2);
     scene()->setWidth(viewport()->width() / _currentScaleFactor - 2);
+    updateViewportRect();
 }
 
 
@@ -410,6 +424,7 @@ void ChatView::zoomOriginal()
     scale(1/_currentScaleFactor, 1/_currentScaleFactor);
     _currentScaleFactor = 1;
     scene()->setWidth(viewport()->width() - 2);
+    updateViewportRect();
 }
 
 
@@ -431,6 +446,7 @@ void ChatView::invalidateFilter()
 void ChatView::scrollContentsBy(int dx, int dy)
 {
     QGraphicsView::scrollContentsBy(dx, dy);
+    updateViewportRect();
     checkChatLineCaches();
 }
 
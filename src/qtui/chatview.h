@@ -108,6 +108,7 @@ private slots:
 
 private:
     void init(MessageFilter *filter);
+    void updateViewportRect();
 
     AbstractBufferContainer *_bufferContainer;
     ChatScene *_scene;
@@ -21,40 +21,144 @@
 #include "chatviewsearchcontroller.h"
 
 #include <QAbstractItemModel>
+#include <QCoreApplication>
+#include <QEvent>
 #include <QPainter>
+#include <QRunnable>
 
 #include "chatitem.h"
 #include "chatline.h"
 #include "chatlinemodel.h"
 #include "chatscene.h"
 #include "messagemodel.h"
+#include "uistyle.h"
+
+// Keystrokes within this interval are searched for in one go
+const int searchDelay = 150;
+// Inserted rows are searched right away if there are at most this many; otherwise we start a new search
+const int maxSyncSearchRows = 64;
+
+class SearchResultEvent : public QEvent
+{
+public:
+    SearchResultEvent(quint64 searchId, int rowCount, int matchLength,
+        const QList<ChatViewSearchController::SearchMatch> &matches, const ChatViewSearchController::SearchIndex &index)
+        : QEvent(QEvent::User), searchId(searchId), rowCount(rowCount), matchLength(matchLength),
+        matches(matches), index(index) {}
+
+    quint64 searchId;
+    int rowCount; // of the index that has been searched
+    int matchLength;
+    QList<ChatViewSearchController::SearchMatch> matches;
+    ChatViewSearchController::SearchIndex index; // empty if the job didn't extract anything new
+};
+
+
+//! Searches the index in a worker thread
+/** Rows whose plain text hasn't been extracted yet are styled on the way, and the updated index is
+ *  handed back along with the matches, so the next search doesn't need to do that again.
+ */
+class ChatViewSearchController::SearchJob : public QRunnable
+{
+public:
+    SearchJob(ChatViewSearchController *controller)
+        : _controller(controller),
+        _searchId(controller->_searchId),
+        _index(controller->_index),
+        _searchString(controller->_searchString),
+        _caseSensitive(controller->caseSensitive()),
+        _searchSenders(controller->_searchSenders),
+        _searchMsgs(controller->_searchMsgs),
+        _searchOnlyRegularMsgs(controller->_searchOnlyRegularMsgs)
+    {
+    }
+
+    void run()
+    {
+        bool extracted = false;
+        QList<SearchMatch> matches;
+        for (int row = 0; row < _index.count(); row++) {
+            if (_searchOnlyRegularMsgs && !checkType(_index.at(row).message.type()))
+                continue;
+            if (_index.at(row).contents.isNull()) {
+                extract(_index[row]);
+                extracted = true;
+            }
+            findMatches(_index.at(row), row, _searchString, _caseSensitive, _searchSenders, _searchMsgs, &matches);
+        }
+        QCoreApplication::postEvent(_controller, new SearchResultEvent(_searchId, _index.count(), _searchString.length(),
+                matches, extracted ? _index : SearchIndex()));
+    }
+
+private:
+    ChatViewSearchController *_controller;
+    quint64 _searchId;
+    SearchIndex _index;
+    QString _searchString;
+    Qt::CaseSensitivity _caseSensitive;
+    bool _searchSenders;
+    bool _searchMsgs;
+    bool _searchOnlyRegularMsgs;
+};
+
+
+// Orders matches as they appear in the scene
+static bool matchLessThan(const ChatViewSearchController::SearchMatch &match1, const ChatViewSearchController::SearchMatch &match2)
+{
+    if (match1.row != match2.row)
+        return match1.row < match2.row;
+    if (match1.column != match2.column)
+        return match1.column < match2.column;
+    return match1.start < match2.start;
+}
+
+
+// Index of the first match in or after row
+static int lowerBoundForRow(const QList<ChatViewSearchController::SearchMatch> &matches, int row)
+{
+    ChatViewSearchController::SearchMatch key = { row, -1, -1 };
+    return qLowerBound(matches.constBegin(), matches.constEnd(), key, matchLessThan) - matches.constBegin();
+}
+
 
 ChatViewSearchController::ChatViewSearchController(QObject *parent)
     : QObject(parent),
     _scene(0),
-    _currentHighlight(0),
+    _searchId(0),
+    _searchRunning(false),
+    _matchLength(0),
+    _currentMatch(-1),
     _caseSensitive(false),
     _searchSenders(false),
     _searchMsgs(true),
     _searchOnlyRegularMsgs(true)
 {
+    _searchTimer.setSingleShot(true);
+    _searchTimer.setInterval(searchDelay);
+    connect(&_searchTimer, SIGNAL(timeout()), SLOT(startSearch()));
+
+    // a new search supersedes the running one anyway
+    _threadPool.setMaxThreadCount(1);
+}
+
+
+ChatViewSearchController::~ChatViewSearchController()
+{
+    // running jobs post their results to us
+    _threadPool.waitForDone();
 }
 
 
 void ChatViewSearchController::setSearchString(const QString &searchString)
 {
-    QString oldSearchString = _searchString;
+    if (searchString == _searchString)
+        return;
+
     _searchString = searchString;
-    if (_scene) {
-        if (!searchString.startsWith(oldSearchString) || oldSearchString.isEmpty()) {
-            // we can't reuse our all findings... cler the scene and do it all over
-            updateHighlights();
-        }
-        else {
-            // reuse all findings
-            updateHighlights(true);
-        }
-    }
+    if (searchString.isEmpty())
+        startSearch(); // clears the highlights right away
+    else
+        scheduleSearch();
 }
 
 
@@ -66,266 +170,411 @@ void ChatViewSearchController::setScene(ChatScene *scene)
 
     if (_scene) {
         disconnect(_scene, 0, this, 0);
-        disconnect(Client::messageModel(), 0, this, 0);
-        qDeleteAll(_highlightItems);
-        _highlightItems.clear();
+        disconnect(_scene->model(), 0, this, 0);
+        clearHighlights();
     }
 
     _scene = scene;
+    _index.clear();
     if (!scene)
         return;
 
     connect(_scene, SIGNAL(destroyed()), this, SLOT(sceneDestroyed()));
     connect(_scene, SIGNAL(layoutChanged()), this, SLOT(repositionHighlights()));
-    connect(Client::messageModel(), SIGNAL(finishedBacklogFetch(BufferId)), this, SLOT(updateHighlights()));
-    updateHighlights();
+    connect(_scene, SIGNAL(linesChanged()), this, SLOT(updateHighlightItems()));
+    connect(_scene->model(), SIGNAL(rowsInserted(const QModelIndex &, int, int)),
+        this, SLOT(rowsInserted(const QModelIndex &, int, int)));
+    connect(_scene->model(), SIGNAL(rowsAboutToBeRemoved(const QModelIndex &, int, int)),
+        this, SLOT(rowsAboutToBeRemoved(const QModelIndex &, int, int)));
+    startSearch();
 }
 
 
 void ChatViewSearchController::highlightNext()
 {
-    if (_highlightItems.isEmpty())
+    if (_matches.isEmpty())
         return;
 
-    if (_currentHighlight < _highlightItems.count()) {
-        _highlightItems.at(_currentHighlight)->setHighlighted(false);
-    }
-
-    _currentHighlight++;
-    if (_currentHighlight >= _highlightItems.count())
-        _currentHighlight = 0;
-    _highlightItems.at(_currentHighlight)->setHighlighted(true);
-    emit newCurrentHighlight(_highlightItems.at(_currentHighlight));
+    int match = _currentMatch + 1;
+    if (match >= _matches.count())
+        match = 0;
+    setCurrentMatch(match);
 }
 
 
 void ChatViewSearchController::highlightPrev()
 {
-    if (_highlightItems.isEmpty())
+    if (_matches.isEmpty())
         return;
 
-    if (_currentHighlight < _highlightItems.count()) {
-        _highlightItems.at(_currentHighlight)->setHighlighted(false);
+    int match = _currentMatch - 1;
+    if (match < 0)
+        match = _matches.count() - 1;
+    setCurrentMatch(match);
+}
+
+
+void ChatViewSearchController::scheduleSearch()
+{
+    _searchTimer.start();
+}
+
+
+void ChatViewSearchController::startSearch()
+{
+    _searchTimer.stop();
+    _searchId++; // results of a search that is still running are outdated now
+    _searchRunning = false;
+    _rowChanges.clear();
+
+    if (!_scene || searchString().isEmpty() || !(_searchSenders || _searchMsgs)) {
+        clearHighlights();
+        if (searchString().isEmpty())
+            _index.clear(); // search is over, no need to keep the plain texts around
+        return;
     }
 
-    _currentHighlight--;
-    if (_currentHighlight < 0)
-        _currentHighlight = _highlightItems.count() - 1;
-    _highlightItems.at(_currentHighlight)->setHighlighted(true);
-    emit newCurrentHighlight(_highlightItems.at(_currentHighlight));
+    if (_index.count() != _scene->model()->rowCount())
+        buildIndex();
+    _searchRunning = true;
+    _threadPool.start(new SearchJob(this));
 }
 
 
-void ChatViewSearchController::updateHighlights(bool reuse)
+void ChatViewSearchController::customEvent(QEvent *event)
 {
-    if (!_scene)
+    if (event->type() != QEvent::User)
         return;
 
-    if (reuse) {
-        QSet<ChatLine *> chatLines;
-        foreach(SearchHighlightItem *highlightItem, _highlightItems) {
-            ChatLine *line = qgraphicsitem_cast<ChatLine *>(highlightItem->parentItem());
-            if (line)
-                chatLines << line;
-        }
-        foreach(ChatLine *line, QList<ChatLine *>(chatLines.toList())) {
-            updateHighlights(line);
+    event->accept();
+
+    SearchResultEvent *result = static_cast<SearchResultEvent *>(event);
+    if (result->searchId != _searchId)
+        return; // we've started another search in the meantime
+
+    _searchRunning = false;
+    applyResult(result->matches, result->matchLength, result->rowCount, result->index);
+    _rowChanges.clear();
+}
+
+
+// Rows may have been inserted or removed while the job was running, so we replay these changes on its result
+void ChatViewSearchController::applyResult(const QList<SearchMatch> &matches, int matchLength, int rowCount, const SearchIndex &index)
+{
+    if (_rowChanges.isEmpty()) {
+        if (!index.isEmpty())
+            _index = index;
+        setMatches(matches, matchLength);
+        return;
+    }
+
+    // the row the job has searched for each current row, or -1 if it has been inserted since
+    QVector<int> searchedRow(rowCount);
+    for (int row = 0; row < rowCount; row++)
+        searchedRow[row] = row;
+    foreach(const RowChange &change, _rowChanges) {
+        if (change.count > 0)
+            searchedRow.insert(change.start, change.count, -1);
+        else
+            searchedRow.remove(change.start, -change.count);
+    }
+    Q_ASSERT(searchedRow.count() == _index.count());
+
+    QVector<int> currentRow(rowCount, -1);
+    for (int row = 0; row < searchedRow.count(); row++) {
+        if (searchedRow.at(row) >= 0)
+            currentRow[searchedRow.at(row)] = row;
+    }
+
+    // keep the plain texts the job has extracted
+    if (!index.isEmpty()) {
+        for (int row = 0; row < rowCount; row++) {
+            int current = currentRow.at(row);
+            if (current >= 0 && _index.at(current).contents.isNull())
+                _index[current] = index.at(row);
         }
     }
-    else {
-        QPointF oldHighlightPos;
-        if (!_highlightItems.isEmpty() && _currentHighlight < _highlightItems.count()) {
-            oldHighlightPos = _highlightItems[_currentHighlight]->scenePos();
+
+    // inserted rows have been searched by rowsInserted() already
+    QList<SearchMatch> newMatches;
+    foreach(SearchMatch match, matches) {
+        match.row = currentRow.at(match.row);
+        if (match.row >= 0)
+            newMatches.append(match);
+    }
+    foreach(const SearchMatch &match, _matches) {
+        if (searchedRow.at(match.row) < 0)
+            newMatches.append(match);
+    }
+    qSort(newMatches.begin(), newMatches.end(), matchLessThan);
+    setMatches(newMatches, matchLength);
+}
+
+
+// Only the messages are collected here, the plain texts are extracted by the first search that needs them
+void ChatViewSearchController::buildIndex()
+{
+    QAbstractItemModel *model = _scene->model();
+    _index = SearchIndex(model->rowCount());
+    for (int row = 0; row < _index.count(); row++)
+        _index[row].message = model->index(row, 0).data(MessageModel::MessageRole).value<Message>();
+}
+
+
+// Styling only uses thread-safe parts of UiStyle, so this can be called from the search job
+void ChatViewSearchController::extract(SearchIndexEntry &entry)
+{
+    UiStyle::StyledMessage styledMsg(entry.message);
+    entry.sender = styledMsg.decoratedSender();
+    entry.contents = styledMsg.plainContents();
+    if (entry.contents.isNull())
+        entry.contents = QLatin1String(""); // mark as extracted
+}
+
+
+void ChatViewSearchController::findMatches(const SearchIndexEntry &entry, int row, const QString &searchString, Qt::CaseSensitivity caseSensitive,
+    bool searchSenders, bool searchMsgs, QList<SearchMatch> *matches)
+{
+    if (searchSenders) {
+        int idx = entry.sender.indexOf(searchString, 0, caseSensitive);
+        while (idx != -1) {
+            SearchMatch match = { row, MessageModel::SenderColumn, idx };
+            matches->append(match);
+            idx = entry.sender.indexOf(searchString, idx + 1, caseSensitive);
         }
-        qDeleteAll(_highlightItems);
-        _highlightItems.clear();
-        Q_ASSERT(_highlightItems.isEmpty());
-
-        if (searchString().isEmpty() || !(_searchSenders || _searchMsgs))
-            return;
-
-        checkMessagesForHighlight();
-
-        if (!_highlightItems.isEmpty()) {
-            if (!oldHighlightPos.isNull()) {
-                int start = 0; int end = _highlightItems.count() - 1;
-                QPointF startPos;
-                QPointF endPos;
-                while (1) {
-                    startPos = _highlightItems[start]->scenePos();
-                    endPos = _highlightItems[end]->scenePos();
-                    if (startPos == oldHighlightPos) {
-                        _currentHighlight = start;
-                        break;
-                    }
-                    if (endPos == oldHighlightPos) {
-                        _currentHighlight = end;
-                        break;
-                    }
-                    if (end - start == 1) {
-                        _currentHighlight = start;
-                        break;
-                    }
-                    int pivot = (end + start) / 2;
-                    QPointF pivotPos = _highlightItems[pivot]->scenePos();
-                    if (startPos.y() == endPos.y()) {
-                        if (oldHighlightPos.x() <= pivotPos.x())
-                            end = pivot;
-                        else
-                            start = pivot;
-                    }
-                    else {
-                        if (oldHighlightPos.y() <= pivotPos.y())
-                            end = pivot;
-                        else
-                            start = pivot;
-                    }
-                }
-            }
-            else {
-                _currentHighlight = _highlightItems.count() - 1;
-            }
-            _highlightItems[_currentHighlight]->setHighlighted(true);
-            emit newCurrentHighlight(_highlightItems[_currentHighlight]);
+    }
+    if (searchMsgs) {
+        int idx = entry.contents.indexOf(searchString, 0, caseSensitive);
+        while (idx != -1) {
+            SearchMatch match = { row, MessageModel::ContentsColumn, idx };
+            matches->append(match);
+            idx = entry.contents.indexOf(searchString, idx + 1, caseSensitive);
         }
     }
 }
 
 
-void ChatViewSearchController::checkMessagesForHighlight(int start, int end)
+void ChatViewSearchController::rowsInserted(const QModelIndex &parent, int start, int end)
 {
+    Q_UNUSED(parent);
+
+    if (_index.isEmpty())
+        return; // nothing to keep up to date
+
     QAbstractItemModel *model = _scene->model();
-    Q_ASSERT(model);
+    int count = end - start + 1;
+    _index.insert(start, count, SearchIndexEntry());
+    for (int row = start; row <= end; row++)
+        _index[row].message = model->index(row, 0).data(MessageModel::MessageRole).value<Message>();
+    if (_searchRunning) {
+        RowChange change = { start, count };
+        _rowChanges.append(change);
+    }
+
+    // the matches below the new rows just move down
+    int first = lowerBoundForRow(_matches, start);
+    for (int i = first; i < _matches.count(); i++)
+        _matches[i].row += count;
 
-    if (end == -1) {
-        end = model->rowCount() - 1;
-        if (end == -1)
-            return;
+    if (count > maxSyncSearchRows) {
+        scheduleSearch();
+        return;
     }
 
-    QModelIndex index;
-    for (int row = start; row <= end; row++) {
-        if (_searchOnlyRegularMsgs) {
-            index = model->index(row, 0);
-            if (!checkType((Message::Type)index.data(MessageModel::TypeRole).toInt()))
+    // small batches (i.e. new messages) are searched right away
+    QList<SearchMatch> newMatches;
+    if (_searchSenders || _searchMsgs) {
+        for (int row = start; row <= end; row++) {
+            if (_searchOnlyRegularMsgs && !checkType(_index.at(row).message.type()))
                 continue;
+            extract(_index[row]);
+            findMatches(_index.at(row), row, searchString(), caseSensitive(), _searchSenders, _searchMsgs, &newMatches);
         }
-        highlightLine(_scene->chatLine(row));
     }
+    for (int i = 0; i < newMatches.count(); i++)
+        _matches.insert(first + i, newMatches.at(i));
+    if (_currentMatch >= first)
+        _currentMatch += newMatches.count();
+
+    // the scene creates lines for the new rows with its next frame, linesChanged() gives them their highlights
 }
 
 
-void ChatViewSearchController::updateHighlights(ChatLine *line)
+void ChatViewSearchController::rowsAboutToBeRemoved(const QModelIndex &parent, int start, int end)
 {
-    QList<ChatItem *> checkItems;
-    if (_searchSenders)
-        checkItems << line->item(MessageModel::SenderColumn);
+    Q_UNUSED(parent);
 
-    if (_searchMsgs)
-        checkItems << line->item(MessageModel::ContentsColumn);
+    if (_index.isEmpty())
+        return;
 
-    QHash<quint64, QHash<quint64, QRectF> > wordRects;
-    foreach(ChatItem *item, checkItems) {
-        foreach(QRectF wordRect, item->findWords(searchString(), caseSensitive())) {
-            wordRects[(quint64)(wordRect.x() + item->x())][(quint64)(wordRect.y())] = wordRect;
-        }
+    int count = end - start + 1;
+    _index.remove(start, count);
+    if (_searchRunning) {
+        RowChange change = { start, -count };
+        _rowChanges.append(change);
     }
 
-    bool deleteAll = false;
-    QAbstractItemModel *model = _scene->model();
-    Q_ASSERT(model);
-    if (_searchOnlyRegularMsgs) {
-        QModelIndex index = model->index(line->row(), 0);
-        if (!checkType((Message::Type)index.data(MessageModel::TypeRole).toInt()))
-            deleteAll = true;
-    }
+    // the highlight items of the removed rows go away with their lines
+    int first = lowerBoundForRow(_matches, start);
+    int last = lowerBoundForRow(_matches, end + 1);
+    _matches.erase(_matches.begin() + first, _matches.begin() + last);
+    for (int i = first; i < _matches.count(); i++)
+        _matches[i].row -= count;
+
+    if (_currentMatch >= last)
+        _currentMatch -= last - first;
+    else if (_currentMatch >= first)
+        _currentMatch = qMin(first, _matches.count() - 1);
+}
 
-    foreach(QGraphicsItem *child, line->childItems()) {
-        SearchHighlightItem *highlightItem = qgraphicsitem_cast<SearchHighlightItem *>(child);
-        if (!highlightItem)
-            continue;
 
-        if (!deleteAll && wordRects.contains((quint64)(highlightItem->pos().x())) && wordRects[(quint64)(highlightItem->pos().x())].contains((quint64)(highlightItem->pos().y()))) {
-            QRectF &wordRect = wordRects[(quint64)(highlightItem->pos().x())][(quint64)(highlightItem->pos().y())];
-            highlightItem->updateGeometry(wordRect.width(), wordRect.height());
-        }
-        else {
-            int pos = _highlightItems.indexOf(highlightItem);
-            if (pos == _currentHighlight) {
-                highlightPrev();
-            }
-            else if (pos < _currentHighlight) {
-                _currentHighlight--;
+void ChatViewSearchController::clearHighlights()
+{
+    if (_scene) {
+        foreach(ChatLine *line, _scene->chatLines()) {
+            foreach(QGraphicsItem *child, line->childItems()) {
+                if (qgraphicsitem_cast<SearchHighlightItem *>(child))
+                    delete child;
             }
-
-            _highlightItems.removeAt(pos);
-            delete highlightItem;
         }
     }
+    _matches.clear();
+    _currentMatch = -1;
 }
 
 
-void ChatViewSearchController::highlightLine(ChatLine *line)
+void ChatViewSearchController::setMatches(const QList<SearchMatch> &matches, int matchLength)
 {
-    QList<ChatItem *> checkItems;
-    if (_searchSenders)
-        checkItems << line->item(MessageModel::SenderColumn);
-
-    if (_searchMsgs)
-        checkItems << line->item(MessageModel::ContentsColumn);
+    // we try to keep the current highlight where it was
+    bool hadCurrentMatch = _currentMatch >= 0;
+    SearchMatch oldMatch = hadCurrentMatch ? _matches.at(_currentMatch) : SearchMatch();
+
+    clearHighlights();
+    _matches = matches;
+    _matchLength = matchLength;
+    if (_matches.isEmpty())
+        return;
 
-    foreach(ChatItem *item, checkItems) {
-        foreach(QRectF wordRect, item->findWords(searchString(), caseSensitive())) {
-            _highlightItems << new SearchHighlightItem(wordRect.adjusted(item->x(), 0, item->x(), 0), line);
-        }
+    int current = _matches.count() - 1;
+    if (hadCurrentMatch) {
+        current = qLowerBound(_matches.constBegin(), _matches.constEnd(), oldMatch, matchLessThan) - _matches.constBegin();
+        current = qMin(current, _matches.count() - 1);
     }
+
+    updateHighlightItems();
+    setCurrentMatch(current);
 }
 
 
-void ChatViewSearchController::repositionHighlights()
+void ChatViewSearchController::setCurrentMatch(int match)
 {
-    QSet<ChatLine *> chatLines;
-    foreach(SearchHighlightItem *item, _highlightItems) {
-        ChatLine *line = qgraphicsitem_cast<ChatLine *>(item->parentItem());
-        if (line)
-            chatLines << line;
+    if (_currentMatch >= 0) {
+        SearchHighlightItem *item = highlightItem(_matches.at(_currentMatch));
+        if (item)
+            item->setHighlighted(false);
     }
-    QList<ChatLine *> chatLineList(chatLines.toList());
-    foreach(ChatLine *line, chatLineList) {
-        repositionHighlights(line);
+
+    _currentMatch = match;
+
+    // the match might be far away from the viewport, so we may need to create its line first
+    const SearchMatch &current = _matches.at(match);
+    ChatLine *line = _scene->chatLine(current.row);
+    if (!line)
+        return;
+
+    updateHighlightItems(current.row, line, false);
+    SearchHighlightItem *item = highlightItem(current);
+    if (item) {
+        item->setHighlighted(true);
+        emit newCurrentHighlight(item);
     }
 }
 
 
-void ChatViewSearchController::repositionHighlights(ChatLine *line)
+SearchHighlightItem *ChatViewSearchController::highlightItem(const SearchMatch &match) const
 {
-    QList<SearchHighlightItem *> searchHighlights;
+    ChatLine *line = _scene->chatLines().value(match.row);
+    if (!line)
+        return 0;
+
     foreach(QGraphicsItem *child, line->childItems()) {
-        SearchHighlightItem *highlightItem = qgraphicsitem_cast<SearchHighlightItem *>(child);
-        if (highlightItem)
-            searchHighlights << highlightItem;
+        SearchHighlightItem *item = qgraphicsitem_cast<SearchHighlightItem *>(child);
+        if (item && item->column() == match.column && item->start() == match.start)
+            return item;
     }
+    return 0;
+}
+
 
-    if (searchHighlights.isEmpty())
+int ChatViewSearchController::firstMatchOfRow(int row) const
+{
+    int first = lowerBoundForRow(_matches, row);
+    if (first < _matches.count() && _matches.at(first).row == row)
+        return first;
+    return -1;
+}
+
+
+// We only have highlight items for the lines the scene currently has, i.e. the ones in and around the viewport
+void ChatViewSearchController::updateHighlightItems()
+{
+    if (!_scene || _matches.isEmpty())
         return;
 
-    QList<QPointF> wordPos;
-    if (_searchSenders) {
-        foreach(QRectF wordRect, line->senderItem()->findWords(searchString(), caseSensitive())) {
-            wordPos << QPointF(wordRect.x() + line->senderItem()->x(), wordRect.y());
-        }
-    }
-    if (_searchMsgs) {
-        foreach(QRectF wordRect, line->contentsItem()->findWords(searchString(), caseSensitive())) {
-            wordPos << QPointF(wordRect.x() + line->contentsItem()->x(), wordRect.y());
-        }
+    QMap<int, ChatLine *>::const_iterator iter = _scene->chatLines().constBegin();
+    for (; iter != _scene->chatLines().constEnd(); ++iter)
+        updateHighlightItems(iter.key(), *iter, false);
+}
+
+
+void ChatViewSearchController::repositionHighlights()
+{
+    if (!_scene || _matches.isEmpty())
+        return;
+
+    QMap<int, ChatLine *>::const_iterator iter = _scene->chatLines().constBegin();
+    for (; iter != _scene->chatLines().constEnd(); ++iter)
+        updateHighlightItems(iter.key(), *iter, true);
+}
+
+
+void ChatViewSearchController::updateHighlightItems(int row, ChatLine *line, bool reposition)
+{
+    int first = firstMatchOfRow(row);
+    if (first < 0)
+        return;
+
+    QList<SearchHighlightItem *> items;
+    foreach(QGraphicsItem *child, line->childItems()) {
+        SearchHighlightItem *item = qgraphicsitem_cast<SearchHighlightItem *>(child);
+        if (item)
+            items << item;
     }
+    // we always create the items for all matches of a line at once
+    if (!items.isEmpty() && !reposition)
+        return;
 
-    qSort(searchHighlights.begin(), searchHighlights.end(), SearchHighlightItem::firstInLine);
+    for (int i = first; i < _matches.count() && _matches.at(i).row == row; i++) {
+        const SearchMatch &match = _matches.at(i);
+        ChatItem *chatItem = line->item((ChatLineModel::ColumnType)match.column);
+        QRectF wordRect = chatItem->textRect(match.start, _matchLength).translated(chatItem->x(), 0);
 
-    Q_ASSERT(wordPos.count() == searchHighlights.count());
-    for (int i = 0; i < searchHighlights.count(); i++) {
-        searchHighlights.at(i)->setPos(wordPos.at(i));
+        SearchHighlightItem *item = 0;
+        foreach(SearchHighlightItem *existingItem, items) {
+            if (existingItem->column() == match.column && existingItem->start() == match.start) {
+                item = existingItem;
+                break;
+            }
+        }
+        if (item) {
+            item->setPos(wordRect.topLeft());
+            item->updateGeometry(wordRect.width(), wordRect.height());
+        }
+        else {
+            item = new SearchHighlightItem(wordRect, match.column, match.start, line);
+            if (i == _currentMatch)
+                item->setHighlighted(true);
+        }
     }
 }
 
@@ -336,7 +585,12 @@ void ChatViewSearchController::sceneDestroyed()
     _scene = 0;
     // the items will be automatically deleted when the scene is destroyed
     // so we just have to clear the list;
-    _highlightItems.clear();
+    _matches.clear();
+    _currentMatch = -1;
+    _index.clear();
+    _searchId++;
+    _searchRunning = false;
+    _rowChanges.clear();
 }
 
 
@@ -346,10 +600,7 @@ void ChatViewSearchController::setCaseSensitive(bool caseSensitive)
         return;
 
     _caseSensitive = caseSensitive;
-
-    // we can reuse the original search results if the new search
-    // parameters are a restriction of the original one
-    updateHighlights(caseSensitive);
+    startSearch();
 }
 
 
@@ -359,9 +610,7 @@ void ChatViewSearchController::setSearchSenders(bool searchSenders)
         return;
 
     _searchSenders = searchSenders;
-    // we can reuse the original search results if the new search
-    // parameters are a restriction of the original one
-    updateHighlights(!searchSenders);
+    startSearch();
 }
 
 
@@ -371,10 +620,7 @@ void ChatViewSearchController::setSearchMsgs(bool searchMsgs)
         return;
 
     _searchMsgs = searchMsgs;
-
-    // we can reuse the original search results if the new search
-    // parameters are a restriction of the original one
-    updateHighlights(!searchMsgs);
+    startSearch();
 }
 
 
@@ -384,19 +630,18 @@ void ChatViewSearchController::setSearchOnlyRegularMsgs(bool searchOnlyRegularMs
         return;
 
     _searchOnlyRegularMsgs = searchOnlyRegularMsgs;
-
-    // we can reuse the original search results if the new search
-    // parameters are a restriction of the original one
-    updateHighlights(searchOnlyRegularMsgs);
+    startSearch();
 }
 
 
 // ==================================================
 //  SearchHighlightItem
 // ==================================================
-SearchHighlightItem::SearchHighlightItem(QRectF wordRect, QGraphicsItem *parent)
+SearchHighlightItem::SearchHighlightItem(QRectF wordRect, int column, int start, QGraphicsItem *parent)
     : QObject(),
     QGraphicsItem(parent),
+    _column(column),
+    _start(start),
     _highlighted(false),
     _alpha(70),
     _timeLine(150)
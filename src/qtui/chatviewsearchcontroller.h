@@ -25,7 +25,10 @@
 #include <QHash>
 #include <QPointer>
 #include <QString>
+#include <QThreadPool>
 #include <QTimeLine>
+#include <QTimer>
+#include <QVector>
 
 #include "chatscene.h"
 #include "message.h"
@@ -40,11 +43,27 @@ class ChatViewSearchController : public QObject
 
 public:
     ChatViewSearchController(QObject *parent = 0);
+    ~ChatViewSearchController();
 
     inline const QString &searchString() const { return _searchString; }
 
     void setScene(ChatScene *scene);
 
+    //! A single occurrence of the search string
+    struct SearchMatch {
+        int row;
+        int column;
+        int start;
+    };
+
+    //! The plain text of a row, as far as it has been extracted already
+    struct SearchIndexEntry {
+        Message message;
+        QString sender;
+        QString contents; // null if not extracted yet
+    };
+    typedef QVector<SearchIndexEntry> SearchIndex;
+
 public slots:
     void setSearchString(const QString &searchString);
     void setCaseSensitive(bool caseSensitive);
@@ -55,21 +74,47 @@ public slots:
     void highlightNext();
     void highlightPrev();
 
+protected:
+    virtual void customEvent(QEvent *event);
+
 private slots:
     void sceneDestroyed();
-    void updateHighlights(bool reuse = false);
+    void startSearch();
+    void scheduleSearch();
+
+    void rowsInserted(const QModelIndex &parent, int start, int end);
+    void rowsAboutToBeRemoved(const QModelIndex &parent, int start, int end);
 
+    void updateHighlightItems();
     void repositionHighlights();
-    void repositionHighlights(ChatLine *line);
 
 signals:
     void newCurrentHighlight(QGraphicsItem *highlightItem);
 
 private:
+    class SearchJob;
+
+    //! Rows inserted into (count > 0) or removed from (count < 0) the index while a search job is running
+    struct RowChange {
+        int start;
+        int count;
+    };
+
+    void applyResult(const QList<SearchMatch> &matches, int matchLength, int rowCount, const SearchIndex &index);
+
     QString _searchString;
     ChatScene *_scene;
-    QList<SearchHighlightItem *> _highlightItems;
-    int _currentHighlight;
+
+    SearchIndex _index;
+    quint64 _searchId;
+    bool _searchRunning;
+    QList<RowChange> _rowChanges; // since the running search job took its copy of the index
+    QTimer _searchTimer;
+    QThreadPool _threadPool;
+
+    QList<SearchMatch> _matches;
+    int _matchLength; // length of the string the matches are for; the search string might have changed since
+    int _currentMatch;
 
     bool _caseSensitive;
     bool _searchSenders;
@@ -78,11 +123,19 @@ private:
 
     inline Qt::CaseSensitivity caseSensitive() const { return _caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive; }
 
-    inline bool checkType(Message::Type type) const { return type & (Message::Plain | Message::Notice | Message::Action); }
+    inline static bool checkType(Message::Type type) { return type & (Message::Plain | Message::Notice | Message::Action); }
 
-    void checkMessagesForHighlight(int start = 0, int end = -1);
-    void highlightLine(ChatLine *line);
-    void updateHighlights(ChatLine *line);
+    static void extract(SearchIndexEntry &entry);
+    static void findMatches(const SearchIndexEntry &entry, int row, const QString &searchString, Qt::CaseSensitivity caseSensitive,
+        bool searchSenders, bool searchMsgs, QList<SearchMatch> *matches);
+
+    void buildIndex();
+    void clearHighlights();
+    void setMatches(const QList<SearchMatch> &matches, int matchLength);
+    void setCurrentMatch(int match);
+    int firstMatchOfRow(int row) const;
+    void updateHighlightItems(int row, ChatLine *line, bool reposition);
+    SearchHighlightItem *highlightItem(const SearchMatch &match) const;
 };
 
 
@@ -97,7 +150,7 @@ class SearchHighlightItem : public QObject, public QGraphicsItem
 #endif
 
 public :
-        SearchHighlightItem(QRectF wordRect, QGraphicsItem *parent = 0);
+        SearchHighlightItem(QRectF wordRect, int column, int start, QGraphicsItem *parent = 0);
     virtual inline QRectF boundingRect() const { return _boundingRect; }
     void updateGeometry(qreal width, qreal height);
     virtual void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = 0);
@@ -106,6 +159,10 @@ public :
 
     void setHighlighted(bool highlighted);
 
+    //! The match this item marks, see ChatViewSearchController::SearchMatch
+    inline int column() const { return _column; }
+    inline int start() const { return _start; }
+
     static bool firstInLine(QGraphicsItem *item1, QGraphicsItem *item2);
 
 private slots:
@@ -113,6 +170,8 @@ private slots:
 
 private:
     QRectF _boundingRect;
+    int _column;
+    int _start;
     bool _highlighted;
     int _alpha;
     QTimeLine _timeLine;
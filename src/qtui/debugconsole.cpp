@@ -19,6 +19,7 @@
  ***************************************************************************/
 
 #include "debugconsole.h"
+#include "chatlinemodel.h"
 #include "client.h"
 #include "signalproxy.h"
 
@@ -45,6 +46,14 @@ void DebugConsole::on_evalButton_clicked()
 }
 
 
+void DebugConsole::on_statsButton_clicked()
+{
+    ChatLineModel *model = qobject_cast<ChatLineModel *>(Client::messageModel());
+    if (model)
+        ui.resultLabel->setText(model->memoryReport());
+}
+
+
 void DebugConsole::scriptResult(QString result)
 {
     ui.resultLabel->setText(result);
@@ -39,6 +39,7 @@ signals:
 
 private slots:
     void on_evalButton_clicked();
+    void on_statsButton_clicked();
 
 private:
     Ui::DebugConsole ui;
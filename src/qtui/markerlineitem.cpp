@@ -25,8 +25,7 @@
 
 MarkerLineItem::MarkerLineItem(qreal sceneWidth, QGraphicsItem *parent)
     : QGraphicsObject(parent),
-    _boundingRect(0, 0, sceneWidth, 1),
-    _chatLine(0)
+    _boundingRect(0, 0, sceneWidth, 1)
 {
     setVisible(false);
     setZValue(8);
@@ -35,14 +34,6 @@ MarkerLineItem::MarkerLineItem(qreal sceneWidth, QGraphicsItem *parent)
 }
 
 
-void MarkerLineItem::setChatLine(ChatLine *line)
-{
-    _chatLine = line;
-    if (!line)
-        setVisible(false);
-}
-
-
 void MarkerLineItem::styleChanged()
 {
     _brush = QtUi::style()->brush(UiStyle::MarkerLine);
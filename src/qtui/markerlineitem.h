@@ -25,8 +25,6 @@
 
 #include "chatscene.h"
 
-class ChatLine;
-
 class MarkerLineItem : public QGraphicsObject
 {
     Q_OBJECT
@@ -38,11 +36,7 @@ public:
     inline QRectF boundingRect() const { return _boundingRect; }
     void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = 0);
 
-    inline ChatLine *chatLine() const { return _chatLine; }
-
 public slots:
-    //! Set the ChatLine this MarkerLineItem is associated to
-    void setChatLine(ChatLine *line);
     void sceneRectChanged(const QRectF &);
 
 private slots:
@@ -51,7 +45,6 @@ private slots:
 private:
     QRectF _boundingRect;
     QBrush _brush;
-    ChatLine *_chatLine;
 };
 
 
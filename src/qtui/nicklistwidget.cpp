@@ -24,7 +24,7 @@
 #include "client.h"
 #include "networkmodel.h"
 #include "buffermodel.h"
-#include "nickviewfilter.h"
+#include "nicklistmodel.h"
 #include "qtuisettings.h"
 
 #include <QAction>
@@ -135,10 +135,7 @@ void NickListWidget::currentChanged(const QModelIndex &current, const QModelInde
     }
     else {
         view = new NickView(this);
-        NickViewFilter *filter = new NickViewFilter(newBufferId, Client::networkModel());
-        view->setModel(filter);
-        QModelIndex source_current = Client::bufferModel()->mapToSource(current);
-        view->setRootIndex(filter->mapFromSource(source_current));
+        view->setModel(new NickListModel(current.data(NetworkModel::BufferInfoRole).value<BufferInfo>(), this));
         nickViews[newBufferId] = view;
         ui.stackedWidget->addWidget(view);
         ui.stackedWidget->setCurrentWidget(view);
@@ -175,8 +172,6 @@ void NickListWidget::rowsAboutToBeRemoved(const QModelIndex &parent, int start,
             ui.stackedWidget->removeWidget(nickView);
             QAbstractItemModel *model = nickView->model();
             nickView->setModel(0);
-            if (QSortFilterProxyModel *filter = qobject_cast<QSortFilterProxyModel *>(model))
-                filter->setSourceModel(0);
             model->deleteLater();
             nickView->deleteLater();
         }
@@ -204,8 +199,6 @@ void NickListWidget::removeBuffer(BufferId bufferId)
     ui.stackedWidget->removeWidget(view);
     QAbstractItemModel *model = view->model();
     view->setModel(0);
-    if (QSortFilterProxyModel *filter = qobject_cast<QSortFilterProxyModel *>(model))
-        filter->setSourceModel(0);
     model->deleteLater();
     view->deleteLater();
 }
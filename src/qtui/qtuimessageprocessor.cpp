@@ -20,16 +20,89 @@
 
 #include "qtuimessageprocessor.h"
 
+#include <QCoreApplication>
+#include <QEvent>
+#include <QRunnable>
+#include <QSet>
+#include <QThread>
+
+#include "chatlinemodel.h"
 #include "client.h"
 #include "clientsettings.h"
 #include "identity.h"
 #include "messagemodel.h"
 #include "network.h"
+#include "uistyle.h"
+
+class PreprocessedBatchEvent : public QEvent
+{
+public:
+    PreprocessedBatchEvent(quint64 batchId, const QList<UiStyle::StyledMessage> &messages)
+        : QEvent(QEvent::User), batchId(batchId), messages(messages) {}
+
+    quint64 batchId;
+    QList<UiStyle::StyledMessage> messages; // with their contents already styled
+};
+
+
+//! Does the part of message processing that doesn't need any GUI state in a worker thread
+/** Everything the job needs is copied on creation, so it doesn't touch the processor while running.
+ */
+class QtUiMessageProcessor::PreprocessingJob : public QRunnable
+{
+public:
+    PreprocessingJob(QtUiMessageProcessor *processor, quint64 batchId, const QList<Message> &messages)
+        : _processor(processor),
+        _batchId(batchId),
+        _messages(messages),
+        _highlightRules(processor->_highlightRules),
+        _nicksCaseSensitive(processor->_nicksCaseSensitive)
+    {
+        QSet<NetworkId> networkIds;
+        foreach(const Message &msg, messages) {
+            NetworkId networkId = msg.bufferInfo().networkId();
+            if (networkIds.contains(networkId))
+                continue;
+            networkIds.insert(networkId);
+            QStringList nicks;
+            if (processor->highlightNicks(networkId, &nicks))
+                _highlightNicks[networkId] = nicks;
+        }
+    }
+
+    void run()
+    {
+        QList<UiStyle::StyledMessage> styledMessages;
+        styledMessages.reserve(_messages.count());
+        QList<Message>::iterator msgIter = _messages.begin();
+        while (msgIter != _messages.end()) {
+            Message &msg = *msgIter;
+            QHash<NetworkId, QStringList>::const_iterator nicks = _highlightNicks.constFind(msg.bufferInfo().networkId());
+            if (nicks != _highlightNicks.constEnd() && matchesHighlight(msg, *nicks, _highlightRules, _nicksCaseSensitive))
+                msg.setFlags(msg.flags() | Message::Highlight);
+            styledMessages << UiStyle::StyledMessage(msg);
+            styledMessages.last().prestyle();
+            ++msgIter;
+        }
+        QCoreApplication::postEvent(_processor, new PreprocessedBatchEvent(_batchId, styledMessages));
+    }
+
+private:
+    QtUiMessageProcessor *_processor;
+    quint64 _batchId;
+    QList<Message> _messages;
+    QList<HighlightRule> _highlightRules;
+    QHash<NetworkId, QStringList> _highlightNicks;
+    bool _nicksCaseSensitive;
+};
+
 
 QtUiMessageProcessor::QtUiMessageProcessor(QObject *parent)
     : AbstractMessageProcessor(parent),
     _processing(false),
-    _processMode(TimerBased)
+    _processMode(Concurrent),
+    _nextBatchId(0),
+    _nextInsertBatchId(0)
 {
     NotificationSettings notificationSettings;
     _nicksCaseSensitive = notificationSettings.nicksCaseSensitive();
@@ -41,6 +114,16 @@ QtUiMessageProcessor::QtUiMessageProcessor(QObject *parent)
 
     _processTimer.setInterval(0);
     connect(&_processTimer, SIGNAL(timeout()), this, SLOT(processNextMessage()));
+
+    // leave a core for the GUI thread
+    _threadPool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+}
+
+
+QtUiMessageProcessor::~QtUiMessageProcessor()
+{
+    // running jobs post their results to us
+    _threadPool.waitForDone();
 }
 
 
@@ -52,6 +135,11 @@ void QtUiMessageProcessor::reset()
         _currentBatch.clear();
         _processQueue.clear();
     }
+    else {
+        // drop everything still in flight; batches arriving later are ignored
+        _nextInsertBatchId = _nextBatchId;
+        _preprocessedBatches.clear();
+    }
 }
 
 
@@ -65,6 +153,12 @@ void QtUiMessageProcessor::process(Message &msg)
 
 void QtUiMessageProcessor::process(QList<Message> &msgs)
 {
+    if (processMode() == Concurrent) {
+        if (!msgs.isEmpty())
+            startPreprocessing(msgs);
+        return;
+    }
+
     QList<Message>::iterator msgIter = msgs.begin();
     QList<Message>::iterator msgIterEnd = msgs.end();
     while (msgIter != msgIterEnd) {
@@ -94,6 +188,51 @@ void QtUiMessageProcessor::startProcessing()
 }
 
 
+void QtUiMessageProcessor::startPreprocessing(const QList<Message> &msgs)
+{
+    _threadPool.start(new PreprocessingJob(this, _nextBatchId++, msgs));
+}
+
+
+void QtUiMessageProcessor::customEvent(QEvent *event)
+{
+    if (event->type() != QEvent::User)
+        return;
+
+    event->accept();
+
+    PreprocessedBatchEvent *batchEvent = static_cast<PreprocessedBatchEvent *>(event);
+    if (batchEvent->batchId < _nextInsertBatchId)
+        return; // we've been reset in the meantime
+
+    _preprocessedBatches[batchEvent->batchId] = batchEvent->messages;
+    insertPreprocessedBatches();
+}
+
+
+void QtUiMessageProcessor::insertPreprocessedBatches()
+{
+    while (!_preprocessedBatches.isEmpty() && _preprocessedBatches.constBegin().key() == _nextInsertBatchId) {
+        QList<UiStyle::StyledMessage> msgs = _preprocessedBatches.take(_nextInsertBatchId++);
+        QList<UiStyle::StyledMessage>::iterator msgIter = msgs.begin();
+        while (msgIter != msgs.end()) {
+            preProcess(*msgIter);
+            ++msgIter;
+        }
+        ChatLineModel *chatLineModel = qobject_cast<ChatLineModel *>(Client::messageModel());
+        if (chatLineModel) {
+            chatLineModel->insertStyledMessages(msgs);
+        }
+        else {
+            QList<Message> plainMsgs;
+            foreach(const UiStyle::StyledMessage &msg, msgs)
+                plainMsgs << msg;
+            Client::messageModel()->insertMessages(plainMsgs);
+        }
+    }
+}
+
+
 void QtUiMessageProcessor::processNextMessage()
 {
     if (_currentBatch.isEmpty()) {
@@ -111,63 +250,78 @@ void QtUiMessageProcessor::processNextMessage()
 
 void QtUiMessageProcessor::checkForHighlight(Message &msg)
 {
-    if (!((msg.type() & (Message::Plain | Message::Notice | Message::Action)) && !(msg.flags() & Message::Self)))
-        return;
+    QStringList nickList;
+    if (highlightNicks(msg.bufferInfo().networkId(), &nickList)
+        && matchesHighlight(msg, nickList, _highlightRules, _nicksCaseSensitive))
+        msg.setFlags(msg.flags() | Message::Highlight);
+}
 
+
+// Determines the nicks to highlight on for the given network. Returns false if we don't highlight
+// anything on this network (yet). This needs the Network and Identity objects, so it must be called
+// from the GUI thread.
+bool QtUiMessageProcessor::highlightNicks(NetworkId networkId, QStringList *nickList) const
+{
     // TODO: Cache this (per network)
-    const Network *net = Client::network(msg.bufferInfo().networkId());
-    if (net && !net->myNick().isEmpty()) {
-        QStringList nickList;
-        if (_highlightNick == NotificationSettings::CurrentNick) {
-            nickList << net->myNick();
-        }
-        else if (_highlightNick == NotificationSettings::AllNicks) {
-            const Identity *myIdentity = Client::identity(net->identity());
-            if (myIdentity)
-                nickList = myIdentity->nicks();
-            if (!nickList.contains(net->myNick()))
-                nickList.prepend(net->myNick());
-        }
-        foreach(QString nickname, nickList) {
-            QRegExp nickRegExp("(^|\\W)" + QRegExp::escape(nickname) + "(\\W|$)", _nicksCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
-            if (nickRegExp.indexIn(msg.contents()) >= 0) {
-                msg.setFlags(msg.flags() | Message::Highlight);
-                return;
-            }
-        }
+    const Network *net = Client::network(networkId);
+    if (!net || net->myNick().isEmpty())
+        return false;
 
-        for (int i = 0; i < _highlightRules.count(); i++) {
-            const HighlightRule &rule = _highlightRules.at(i);
-            if (!rule.isEnabled)
-                continue;
+    if (_highlightNick == NotificationSettings::CurrentNick) {
+        *nickList << net->myNick();
+    }
+    else if (_highlightNick == NotificationSettings::AllNicks) {
+        const Identity *myIdentity = Client::identity(net->identity());
+        if (myIdentity)
+            *nickList = myIdentity->nicks();
+        if (!nickList->contains(net->myNick()))
+            nickList->prepend(net->myNick());
+    }
+    return true;
+}
 
-            if (rule.chanName.size() > 0 && rule.chanName.compare(".*") != 0) {
-                if (rule.chanName.startsWith("!")) {
-                    QRegExp rx(rule.chanName.mid(1), Qt::CaseInsensitive);
-                    if (rx.exactMatch(msg.bufferInfo().bufferName()))
-                        continue;
-                }
-                else {
-                    QRegExp rx(rule.chanName, Qt::CaseInsensitive);
-                    if (!rx.exactMatch(msg.bufferInfo().bufferName()))
-                        continue;
-                }
-            }
 
-            QRegExp rx;
-            if (rule.isRegExp) {
-                rx = QRegExp(rule.name, rule.caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
+// Doesn't touch any shared state, so it is safe to call from worker threads
+bool QtUiMessageProcessor::matchesHighlight(const Message &msg, const QStringList &nickList, const QList<HighlightRule> &rules, bool nicksCaseSensitive)
+{
+    if (!((msg.type() & (Message::Plain | Message::Notice | Message::Action)) && !(msg.flags() & Message::Self)))
+        return false;
+
+    foreach(QString nickname, nickList) {
+        QRegExp nickRegExp("(^|\\W)" + QRegExp::escape(nickname) + "(\\W|$)", nicksCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
+        if (nickRegExp.indexIn(msg.contents()) >= 0)
+            return true;
+    }
+
+    for (int i = 0; i < rules.count(); i++) {
+        const HighlightRule &rule = rules.at(i);
+        if (!rule.isEnabled)
+            continue;
+
+        if (rule.chanName.size() > 0 && rule.chanName.compare(".*") != 0) {
+            if (rule.chanName.startsWith("!")) {
+                QRegExp rx(rule.chanName.mid(1), Qt::CaseInsensitive);
+                if (rx.exactMatch(msg.bufferInfo().bufferName()))
+                    continue;
             }
             else {
-                rx = QRegExp("(^|\\W)" + QRegExp::escape(rule.name) + "(\\W|$)", rule.caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
-            }
-            bool match = (rx.indexIn(msg.contents()) >= 0);
-            if (match) {
-                msg.setFlags(msg.flags() | Message::Highlight);
-                return;
+                QRegExp rx(rule.chanName, Qt::CaseInsensitive);
+                if (!rx.exactMatch(msg.bufferInfo().bufferName()))
+                    continue;
             }
         }
+
+        QRegExp rx;
+        if (rule.isRegExp) {
+            rx = QRegExp(rule.name, rule.caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
+        }
+        else {
+            rx = QRegExp("(^|\\W)" + QRegExp::escape(rule.name) + "(\\W|$)", rule.caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
+        }
+        if (rx.indexIn(msg.contents()) >= 0)
+            return true;
     }
+    return false;
 }
 
 
@@ -21,9 +21,12 @@
 #ifndef QTUIMESSAGEPROCESSOR_H_
 #define QTUIMESSAGEPROCESSOR_H_
 
+#include <QMap>
+#include <QThreadPool>
 #include <QTimer>
 
 #include "abstractmessageprocessor.h"
+#include "uistyle.h"
 
 class QtUiMessageProcessor : public AbstractMessageProcessor
 {
@@ -36,6 +39,7 @@ public:
     };
 
     QtUiMessageProcessor(QObject *parent);
+    ~QtUiMessageProcessor();
 
     inline bool isProcessing() const { return _processing; }
     inline Mode processMode() const { return _processMode; }
@@ -52,9 +56,17 @@ private slots:
     void highlightListChanged(const QVariant &variant);
     void highlightNickChanged(const QVariant &variant);
 
+protected:
+    virtual void customEvent(QEvent *event);
+
 private:
+    class PreprocessingJob;
+
     void checkForHighlight(Message &msg);
+    bool highlightNicks(NetworkId networkId, QStringList *nickList) const;
     void startProcessing();
+    void startPreprocessing(const QList<Message> &msgs);
+    void insertPreprocessedBatches();
 
     QList<QList<Message> > _processQueue;
     QList<Message> _currentBatch;
@@ -72,9 +84,17 @@ private:
             : name(name), isEnabled(enabled), caseSensitive(cs), isRegExp(regExp), chanName(chanName) {}
     };
 
+    static bool matchesHighlight(const Message &msg, const QStringList &nickList, const QList<HighlightRule> &rules, bool nicksCaseSensitive);
+
     QList<HighlightRule> _highlightRules;
     NotificationSettings::HighlightNickType _highlightNick;
     bool _nicksCaseSensitive;
+
+    // Batches are preprocessed concurrently, but need to be inserted in the order they arrived
+    QThreadPool _threadPool;
+    quint64 _nextBatchId;
+    quint64 _nextInsertBatchId;
+    QMap<quint64, QList<UiStyle::StyledMessage> > _preprocessedBatches;
 };
 
 
@@ -21,6 +21,7 @@
 #include "backlogsettingspage.h"
 
 #include "qtui.h"
+#include "backlogrequester.h"
 #include "backlogsettings.h"
 
 BacklogSettingsPage::BacklogSettingsPage(QWidget *parent)
@@ -28,10 +29,14 @@ BacklogSettingsPage::BacklogSettingsPage(QWidget *parent)
 {
     ui.setupUi(this);
     initAutoWidgets();
-    // not an auto widget, because we store index + 1
+    // not an auto widget, because we store the requester type, which doesn't match the index
+    ui.requesterType->setItemData(0, BacklogRequester::PerBufferFixed);
+    ui.requesterType->setItemData(1, BacklogRequester::PerBufferUnread);
+    ui.requesterType->setItemData(2, BacklogRequester::PerBufferLazy);
+    ui.requesterType->setItemData(3, BacklogRequester::GlobalUnread);
 
     // FIXME: global backlog requester disabled until issues ruled out
-    ui.requesterType->removeItem(2);
+    ui.requesterType->removeItem(3);
 
     connect(ui.requesterType, SIGNAL(currentIndexChanged(int)), this, SLOT(widgetHasChanged()));
 }
@@ -54,7 +59,7 @@ void BacklogSettingsPage::defaults()
 void BacklogSettingsPage::load()
 {
     BacklogSettings backlogSettings;
-    int index = backlogSettings.requesterType() - 1;
+    int index = qMax(0, ui.requesterType->findData(backlogSettings.requesterType()));
     ui.requesterType->setProperty("storedValue", index);
     ui.requesterType->setCurrentIndex(index);
 
@@ -65,7 +70,7 @@ void BacklogSettingsPage::load()
 void BacklogSettingsPage::save()
 {
     BacklogSettings backlogSettings;
-    backlogSettings.setRequesterType(ui.requesterType->currentIndex() + 1);
+    backlogSettings.setRequesterType(ui.requesterType->itemData(ui.requesterType->currentIndex()).toInt());
     ui.requesterType->setProperty("storedValue", ui.requesterType->currentIndex());
 
     SettingsPage::save();
@@ -22,32 +22,29 @@
 
 #ifdef HAVE_WEBKIT
 
-#include <QGraphicsProxyWidget>
 #include <QPainter>
-#include <QWebView>
-#include <QWebSettings>
+
+#include "webpreviewservice.h"
+
+const qreal frameWidth = 5;
 
 WebPreviewItem::WebPreviewItem(const QUrl &url)
     : QGraphicsItem(0), // needs to be a top level item as we otherwise cannot guarantee that it's on top of other chatlines
-    _boundingRect(0, 0, 400, 300)
+    _boundingRect(0, 0, WebPreviewService::thumbnailSize().width() + 2 * frameWidth, WebPreviewService::thumbnailSize().height() + 2 * frameWidth)
 {
-    qreal frameWidth = 5;
+    // the page is loaded by the service, we only show what it rendered
+    _pixmap = WebPreviewService::instance()->preview(url);
+    if (_pixmap.isNull())
+        WebPreviewService::instance()->request(url);
 
-    QWebView *webView = new QWebView;
-    webView->settings()->setAttribute(QWebSettings::JavascriptEnabled, false);
-    webView->load(url);
-    webView->setDisabled(true);
-    webView->resize(1000, 750);
-    QGraphicsProxyWidget *proxyItem = new QGraphicsProxyWidget(this);
-    proxyItem->setWidget(webView);
-    proxyItem->setAcceptHoverEvents(false);
+    setZValue(30);
+}
 
-    qreal xScale = (_boundingRect.width() - 2 * frameWidth) / webView->width();
-    qreal yScale = (_boundingRect.height() - 2 * frameWidth) / webView->height();
-    proxyItem->setTransform(QTransform::fromScale(xScale, yScale), true);
-    proxyItem->setPos(frameWidth, frameWidth);
 
-    setZValue(30);
+void WebPreviewItem::setPixmap(const QPixmap &pixmap)
+{
+    _pixmap = pixmap;
+    update();
 }
 
 
@@ -59,6 +56,10 @@ void WebPreviewItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *op
     painter->setBrush(Qt::black);
     painter->setRenderHints(QPainter::Antialiasing);
     painter->drawRoundedRect(boundingRect(), 10, 10);
+
+    // until the page is loaded, we only show the frame
+    if (!_pixmap.isNull())
+        painter->drawPixmap(QPointF(frameWidth, frameWidth), _pixmap);
 }
 
 
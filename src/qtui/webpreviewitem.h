@@ -24,7 +24,9 @@
 #ifdef HAVE_WEBKIT
 
 #include <QGraphicsItem>
+#include <QPixmap>
 
+//! Shows the thumbnail WebPreviewService rendered for a URL
 class WebPreviewItem : public QGraphicsItem
 {
 public:
@@ -32,8 +34,12 @@ public:
     virtual void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = 0);
     virtual inline QRectF boundingRect() const { return _boundingRect; }
 
+    //! Sets the thumbnail, for when it wasn't available yet on creation
+    void setPixmap(const QPixmap &pixmap);
+
 private:
     QRectF _boundingRect;
+    QPixmap _pixmap;
 };
 
 
@@ -0,0 +1,173 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2016 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "webpreviewservice.h"
+
+#ifdef HAVE_WEBKIT
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QImage>
+#include <QPainter>
+#include <QWebFrame>
+#include <QWebPage>
+#include <QWebSettings>
+
+// the mouse needs to stay on a URL this long before we load it
+const int defaultRequestDelay = 500;
+// loads taking longer than this are given up
+const int defaultLoadTimeout = 20000;
+// memory used by cached thumbnails, in KiB
+const int maxCacheSize = 16 * 1024;
+// pages are rendered at this size and scaled down to the thumbnail size
+const int pageWidth = 1000;
+const int pageHeight = 750;
+
+WebPreviewService *WebPreviewService::_instance = 0;
+
+WebPreviewService *WebPreviewService::instance()
+{
+    if (!_instance)
+        _instance = new WebPreviewService(QCoreApplication::instance());
+    return _instance;
+}
+
+
+WebPreviewService::WebPreviewService(QObject *parent)
+    : QObject(parent),
+    _page(new QWebPage(this)),
+    _cache(maxCacheSize)
+{
+    _page->settings()->setAttribute(QWebSettings::JavascriptEnabled, false);
+    _page->setViewportSize(QSize(pageWidth, pageHeight));
+    _page->mainFrame()->setScrollBarPolicy(Qt::Horizontal, Qt::ScrollBarAlwaysOff);
+    _page->mainFrame()->setScrollBarPolicy(Qt::Vertical, Qt::ScrollBarAlwaysOff);
+    connect(_page, SIGNAL(loadFinished(bool)), SLOT(loadFinished(bool)));
+
+    _requestTimer.setSingleShot(true);
+    _requestTimer.setInterval(defaultRequestDelay);
+    connect(&_requestTimer, SIGNAL(timeout()), SLOT(startLoad()));
+
+    _loadTimer.setSingleShot(true);
+    _loadTimer.setInterval(defaultLoadTimeout);
+    connect(&_loadTimer, SIGNAL(timeout()), SLOT(loadTimeout()));
+}
+
+
+QSize WebPreviewService::thumbnailSize()
+{
+    return QSize(390, 290);
+}
+
+
+QPixmap WebPreviewService::preview(const QUrl &url)
+{
+    // looking it up also marks it as recently used
+    QPixmap *pixmap = _cache.object(url.toString());
+    return pixmap ? *pixmap : QPixmap();
+}
+
+
+void WebPreviewService::request(const QUrl &url)
+{
+    if (url.isEmpty() || _cache.contains(url.toString()) || url == _loadingUrl)
+        return;
+    if (url == _pendingUrl && _requestTimer.isActive())
+        return; // don't delay it any further
+
+    // only the most recent request counts, so sweeping over a bunch of links doesn't load them all
+    _pendingUrl = url;
+    _requestTimer.start();
+}
+
+
+void WebPreviewService::cancel(const QUrl &url)
+{
+    if (url != _pendingUrl)
+        return;
+
+    _pendingUrl = QUrl();
+    _requestTimer.stop();
+}
+
+
+void WebPreviewService::startLoad()
+{
+    if (_pendingUrl.isEmpty())
+        return;
+
+    // we only ever load one page; whatever we were loading before isn't wanted anymore
+    stopLoad();
+    _loadingUrl = _pendingUrl;
+    _pendingUrl = QUrl();
+    _loadTimer.start();
+    _page->mainFrame()->load(_loadingUrl);
+}
+
+
+void WebPreviewService::stopLoad()
+{
+    if (_loadingUrl.isEmpty())
+        return;
+
+    _loadTimer.stop();
+    _loadingUrl = QUrl();
+    _page->triggerAction(QWebPage::Stop);
+}
+
+
+void WebPreviewService::loadFinished(bool ok)
+{
+    // loads we stopped ourselves may still report back after the next one started
+    if (_loadingUrl.isEmpty() || _page->mainFrame()->requestedUrl() != _loadingUrl)
+        return;
+
+    QUrl url = _loadingUrl;
+    _loadingUrl = QUrl();
+    _loadTimer.stop();
+
+    if (ok) {
+        QImage image(pageWidth, pageHeight, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::white);
+        QPainter painter(&image);
+        _page->mainFrame()->render(&painter);
+        painter.end();
+
+        QPixmap *pixmap = new QPixmap(QPixmap::fromImage(image.scaled(thumbnailSize(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation)));
+        int cost = qMax(1, pixmap->width() * pixmap->height() * pixmap->depth() / 8 / 1024);
+        _cache.insert(url.toString(), pixmap, cost);
+    }
+
+    // free what the page holds on to until the next load
+    _page->mainFrame()->setHtml(QString());
+
+    if (ok)
+        emit previewReady(url);
+}
+
+
+void WebPreviewService::loadTimeout()
+{
+    qWarning() << "Giving up on web preview of" << _loadingUrl.toString();
+    stopLoad();
+}
+
+
+#endif //#ifdef HAVE_WEBKIT
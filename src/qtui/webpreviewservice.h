@@ -0,0 +1,102 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2016 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#ifndef WEBPREVIEWSERVICE_H_
+#define WEBPREVIEWSERVICE_H_
+
+#ifdef HAVE_WEBKIT
+
+#include <QCache>
+#include <QObject>
+#include <QPixmap>
+#include <QTimer>
+#include <QUrl>
+
+class QWebPage;
+
+//! Loads web previews and keeps them as thumbnails
+/** Hovering over a URL only requests its preview. The request is only acted upon once the mouse
+ *  stayed for a while, and only one page is loaded at a time; a newer request replaces the one still
+ *  waiting or loading. Rendered thumbnails are kept in an LRU cache with a memory cap, so
+ *  hovering over the same URL again doesn't load the page again.
+ *
+ *  Nothing here is specific to real web servers, so pointing it at a local HTTP server works just as well.
+ */
+class WebPreviewService : public QObject
+{
+    Q_OBJECT
+
+public:
+    //! The service used by the UI; other instances are only needed for testing
+    static WebPreviewService *instance();
+
+    WebPreviewService(QObject *parent = 0);
+
+    //! The size of the thumbnails we render
+    static QSize thumbnailSize();
+
+    //! Returns the cached thumbnail of url, or a null pixmap if there is none (yet)
+    QPixmap preview(const QUrl &url);
+
+    //! Asks for url to be loaded, unless its thumbnail is cached already
+    /** previewReady() is emitted once the thumbnail is available.
+     */
+    void request(const QUrl &url);
+
+    //! Withdraws a request for url that hasn't been acted upon yet
+    void cancel(const QUrl &url);
+
+    //! The URL being loaded right now, if any
+    inline QUrl loadingUrl() const { return _loadingUrl; }
+
+    //! Memory used by the cached thumbnails, and the cap for it, in KiB
+    inline int cacheSize() const { return _cache.totalCost(); }
+    inline int maxCacheSize() const { return _cache.maxCost(); }
+
+    //! How long a request needs to be pending before we load it, in milliseconds
+    inline void setRequestDelay(int msecs) { _requestTimer.setInterval(msecs); }
+    //! How long we wait for a page before giving up, in milliseconds
+    inline void setLoadTimeout(int msecs) { _loadTimer.setInterval(msecs); }
+
+signals:
+    void previewReady(const QUrl &url);
+
+private slots:
+    void startLoad();
+    void loadFinished(bool ok);
+    void loadTimeout();
+
+private:
+    void stopLoad();
+
+    QWebPage *_page;
+    QUrl _pendingUrl;
+    QUrl _loadingUrl;
+    QTimer _requestTimer;
+    QTimer _loadTimer;
+    QCache<QString, QPixmap> _cache; // cost is in KiB
+
+    static WebPreviewService *_instance;
+};
+
+
+#endif //#ifdef HAVE_WEBKIT
+
+#endif
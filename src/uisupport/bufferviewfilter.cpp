@@ -48,7 +48,19 @@ BufferViewFilter::BufferViewFilter(QAbstractItemModel *model, BufferViewConfig *
     setConfig(config);
     setSourceModel(model);
 
-    setDynamicSortFilter(true);
+    // QSortFilterProxyModel's dynamic sorting relayouts the whole view whenever a row's data changes, which
+    // happens all the time due to activity updates. Our sort order doesn't depend on those, so we check
+    // changed rows ourselves and only sort or refilter if they actually need it.
+    setDynamicSortFilter(false);
+    connect(model, SIGNAL(dataChanged(const QModelIndex &, const QModelIndex &)),
+        this, SLOT(sourceDataChanged(const QModelIndex &, const QModelIndex &)));
+    connect(model, SIGNAL(rowsInserted(const QModelIndex &, int, int)),
+        this, SLOT(sourceRowsInserted(const QModelIndex &, int, int)));
+
+    // inserted rows are appended unsorted without dynamic sorting; they are sorted in with the next pass of the event loop
+    _resortTimer.setSingleShot(true);
+    _resortTimer.setInterval(0);
+    connect(&_resortTimer, SIGNAL(timeout()), this, SLOT(resort()));
 
     _enableEditMode.setCheckable(true);
     _enableEditMode.setChecked(_editMode);
@@ -221,7 +233,7 @@ bool BufferViewFilter::dropMimeData(const QMimeData *data, Qt::DropAction action
             if (row < rowCount(parent)) {
                 QModelIndex source_child = mapToSource(index(row, 0, parent));
                 BufferId beforeBufferId = sourceModel()->data(source_child, NetworkModel::BufferIdRole).value<BufferId>();
-                pos = config()->bufferList().indexOf(beforeBufferId);
+                pos = config()->bufferPosition(beforeBufferId);
                 if (_sortOrder == Qt::DescendingOrder)
                     pos++;
             }
@@ -232,8 +244,8 @@ bool BufferViewFilter::dropMimeData(const QMimeData *data, Qt::DropAction action
                     pos = 0;
             }
 
-            if (config()->bufferList().contains(bufferId) && !config()->sortAlphabetically()) {
-                if (config()->bufferList().indexOf(bufferId) < pos)
+            if (config()->containsBuffer(bufferId) && !config()->sortAlphabetically()) {
+                if (config()->bufferPosition(bufferId) < pos)
                     pos--;
                 ClientBufferViewConfig *clientConf = qobject_cast<ClientBufferViewConfig *>(config());
                 if (!clientConf || !clientConf->isLocked())
@@ -254,13 +266,80 @@ bool BufferViewFilter::dropMimeData(const QMimeData *data, Qt::DropAction action
 void BufferViewFilter::sort(int column, Qt::SortOrder order)
 {
     _sortOrder = order;
+    _resortTimer.stop();
     QSortFilterProxyModel::sort(column, order);
 }
 
 
+void BufferViewFilter::resort()
+{
+    if (sortColumn() >= 0)
+        sort(sortColumn(), _sortOrder);
+}
+
+
+void BufferViewFilter::sourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight)
+{
+    QModelIndex sourceParent = topLeft.parent();
+    // rows below a hidden network aren't shown either way
+    if (sourceParent.isValid() && !mapFromSource(sourceParent).isValid())
+        return;
+
+    bool needsRefilter = false;
+    bool needsResort = false;
+    for (int row = topLeft.row(); row <= bottomRight.row(); row++) {
+        QModelIndex proxyIndex = mapFromSource(sourceModel()->index(row, 0, sourceParent));
+        if (filterAcceptsRow(row, sourceParent) != proxyIndex.isValid())
+            needsRefilter = true;
+        else if (proxyIndex.isValid() && !isInSortedPosition(proxyIndex))
+            needsResort = true;
+    }
+
+    // The row appears or disappears. Unlike invalidate(), invalidateFilter() keeps the existing mapping and
+    // just removes the rows that are filtered out now, or inserts the new ones at their sorted position.
+    if (needsRefilter)
+        invalidateFilter();
+    if (needsResort)
+        resort();
+}
+
+
+void BufferViewFilter::sourceRowsInserted(const QModelIndex &parent, int start, int end)
+{
+    Q_UNUSED(parent);
+    Q_UNUSED(start);
+    Q_UNUSED(end);
+
+    if (sortColumn() >= 0 && !_resortTimer.isActive())
+        _resortTimer.start();
+}
+
+
+// Checks a row against its neighbours, so a changed row only causes a sort if its position is actually wrong
+bool BufferViewFilter::isInSortedPosition(const QModelIndex &proxyIndex) const
+{
+    if (sortColumn() < 0)
+        return true;
+
+    QModelIndex sourceIndex = mapToSource(proxyIndex.sibling(proxyIndex.row(), sortColumn()));
+    int row = proxyIndex.row();
+    if (row > 0) {
+        QModelIndex prevIndex = mapToSource(proxyIndex.sibling(row - 1, sortColumn()));
+        if (_sortOrder == Qt::AscendingOrder ? lessThan(sourceIndex, prevIndex) : lessThan(prevIndex, sourceIndex))
+            return false;
+    }
+    if (row < rowCount(proxyIndex.parent()) - 1) {
+        QModelIndex nextIndex = mapToSource(proxyIndex.sibling(row + 1, sortColumn()));
+        if (_sortOrder == Qt::AscendingOrder ? lessThan(nextIndex, sourceIndex) : lessThan(sourceIndex, nextIndex))
+            return false;
+    }
+    return true;
+}
+
+
 void BufferViewFilter::addBuffer(const BufferId &bufferId) const
 {
-    if (!config() || config()->bufferList().contains(bufferId))
+    if (!config() || config()->containsBuffer(bufferId))
         return;
 
     int pos = config()->bufferList().count();
@@ -320,7 +399,7 @@ bool BufferViewFilter::filterAcceptBuffer(const QModelIndex &source_bufferIndex)
 
     int activityLevel = sourceModel()->data(source_bufferIndex, NetworkModel::BufferActivityRole).toInt();
 
-    if (!config()->bufferList().contains(bufferId) && !_editMode) {
+    if (!config()->containsBuffer(bufferId) && !_editMode) {
         // add the buffer if...
         if (config()->isInitialized()
             && !config()->removedBuffers().contains(bufferId) // it hasn't been manually removed and either
@@ -421,8 +500,8 @@ bool BufferViewFilter::bufferLessThan(const QModelIndex &source_left, const QMod
     BufferId leftBufferId = sourceModel()->data(source_left, NetworkModel::BufferIdRole).value<BufferId>();
     BufferId rightBufferId = sourceModel()->data(source_right, NetworkModel::BufferIdRole).value<BufferId>();
     if (config()) {
-        int leftPos = config()->bufferList().indexOf(leftBufferId);
-        int rightPos = config()->bufferList().indexOf(rightBufferId);
+        int leftPos = config()->bufferPosition(leftBufferId);
+        int rightPos = config()->bufferPosition(rightBufferId);
         if (leftPos == -1 && rightPos == -1)
             return QSortFilterProxyModel::lessThan(source_left, source_right);
         if (leftPos == -1 || rightPos == -1)
@@ -480,7 +559,7 @@ QVariant BufferViewFilter::checkedState(const QModelIndex &index) const
     if (_toRemove.contains(bufferId))
         return Qt::Unchecked;
 
-    if (config()->bufferList().contains(bufferId))
+    if (config()->containsBuffer(bufferId))
         return Qt::Checked;
 
     if (config()->temporarilyRemovedBuffers().contains(bufferId))
@@ -27,6 +27,7 @@
 #include <QPointer>
 #include <QSet>
 #include <QSortFilterProxyModel>
+#include <QTimer>
 
 #include "types.h"
 #include "bufferviewconfig.h"
@@ -82,6 +83,9 @@ private slots:
     void configInitialized();
     void enableEditMode(bool enable);
     void showServerQueriesChanged();
+    void sourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight);
+    void sourceRowsInserted(const QModelIndex &parent, int start, int end);
+    void resort();
 
 private:
     QPointer<BufferViewConfig> _config;
@@ -93,12 +97,14 @@ private:
     QSet<BufferId> _toAdd;
     QSet<BufferId> _toTempRemove;
     QSet<BufferId> _toRemove;
+    QTimer _resortTimer;
 
     bool filterAcceptBuffer(const QModelIndex &) const;
     bool filterAcceptNetwork(const QModelIndex &) const;
     void addBuffer(const BufferId &bufferId) const;
     void addBuffers(const QList<BufferId> &bufferIds) const;
     static bool bufferIdLessThan(const BufferId &, const BufferId &);
+    bool isInSortedPosition(const QModelIndex &proxyIndex) const;
 };
 
 
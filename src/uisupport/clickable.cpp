@@ -21,6 +21,10 @@
 #include <QDesktopServices>
 #include <QModelIndex>
 #include <QUrl>
+#include <QVarLengthArray>
+
+#include <ctype.h>
+#include <string.h>
 
 #include "buffermodel.h"
 #include "clickable.h"
@@ -48,72 +52,275 @@ void Clickable::activate(NetworkId networkId, const QString &text) const
 }
 
 
-// NOTE: This method is not threadsafe and not reentrant!
-//       (RegExps are not constant while matching, and they are static here for efficiency)
-ClickableList ClickableList::fromString(const QString &str)
+// The scanner below is a hand-written equivalent of the regular expressions we used to match URLs and channel
+// names with:
+//
+//   URL:     \b((?:mailto:|(?:[+.-]?\w)+://|www(?=\.\S+\.))
+//              (?:(?:[,.;@:]?[-\w]+)+\.?|\[[0-9a-f:.]+\])(?::\d+)?
+//              (?:/(?:[,.;:]*[\w~@/?&=+$()!%#*-])*)?)(?:>|[,.;:"]*\s|\b|$)
+//   Channel: ((?:#|![A-Z0-9]{5})[^,:\s]+(?::[^,:\s]+)?)\b
+//
+// (both case insensitive). It finds both in a single pass over the string without backtracking through the whole
+// message, and doesn't need any shared state, so it is reentrant.
+
+static inline bool isOneOf(const QChar &c, const char *chars)
 {
-    // For matching URLs
-    static QString scheme("(?:(?:mailto:|(?:[+.-]?\\w)+://)|www(?=\\.\\S+\\.))");
-    static QString authority("(?:(?:[,.;@:]?[-\\w]+)+\\.?|\\[[0-9a-f:.]+\\])(?::\\d+)?");
-    static QString urlChars("(?:[,.;:]*[\\w~@/?&=+$()!%#*-])");
-    static QString urlEnd("(?:>|[,.;:\"]*\\s|\\b|$)");
-
-    static QRegExp regExp[] = {
-        // URL
-        // QRegExp(QString("((?:https?://|s?ftp://|irc://|mailto:|www\\.)%1+|%1+\\.[a-z]{2,4}(?:?=/%1+|\\b))%2").arg(urlChars, urlEnd)),
-        QRegExp(QString("\\b(%1%2(?:/%3*)?)%4").arg(scheme, authority, urlChars, urlEnd), Qt::CaseInsensitive),
-
-        // Channel name
-        // We don't match for channel names starting with + or &, because that gives us a lot of false positives.
-        QRegExp("((?:#|![A-Z0-9]{5})[^,:\\s]+(?::[^,:\\s]+)?)\\b", Qt::CaseInsensitive)
+    return c.unicode() && c.unicode() < 128 && strchr(chars, c.toLatin1());
+}
+
+
+// \w
+static inline bool isWordChar(const QChar &c)
+{
+    return c.isLetterOrNumber() || c.isMark() || c == '_';
+}
+
+
+// \b
+static inline bool isWordBoundary(const QString &str, int pos)
+{
+    bool before = pos > 0 && isWordChar(str.at(pos - 1));
+    bool after = pos < str.length() && isWordChar(str.at(pos));
+    return before != after;
+}
+
+
+static inline bool isHostChar(const QChar &c)
+{
+    return isWordChar(c) || c == '-';
+}
+
+
+static inline bool isUrlChar(const QChar &c)
+{
+    return isWordChar(c) || isOneOf(c, "~@/?&=+$()!%#*-");
+}
+
+
+static inline bool isChannelChar(const QChar &c)
+{
+    return !c.isSpace() && c != ',' && c != ':';
+}
+
+
+// Case insensitive check for an ASCII literal at pos
+static bool matchesAt(const QString &str, int pos, const char *literal)
+{
+    for (; *literal; ++literal, ++pos) {
+        if (pos >= str.length() || str.at(pos).toLower() != QLatin1Char(*literal))
+            return false;
+    }
+    return true;
+}
+
+
+// Returns the end of the URL scheme starting at pos, or -1 if there is none
+static int matchUrlScheme(const QString &str, int pos)
+{
+    int length = str.length();
+    if (matchesAt(str, pos, "mailto:"))
+        return pos + 7;
+
+    int end = pos;
+    forever {
+        int next = end;
+        if (next < length && isOneOf(str.at(next), "+.-"))
+            next++;
+        if (next >= length || !isWordChar(str.at(next)))
+            break;
+        end = next + 1;
+    }
+    if (end > pos && matchesAt(str, end, "://"))
+        return end + 3;
+
+    // www needs to be followed by something that looks like a domain
+    if (matchesAt(str, pos, "www.")) {
+        for (int i = pos + 4; i < length && !str.at(i).isSpace(); i++) {
+            if (i > pos + 4 && str.at(i) == '.')
+                return pos + 3;
+        }
+    }
+    return -1;
+}
+
+
+// Whether a URL may end at pos
+static bool isUrlEnd(const QString &str, int pos)
+{
+    int length = str.length();
+    if (pos == length || str.at(pos) == '>' || isWordBoundary(str, pos))
+        return true;
+    while (pos < length && isOneOf(str.at(pos), ",.;:\""))
+        pos++;
+    return pos < length && str.at(pos).isSpace();
+}
 
-        // TODO: Nicks, we'll need a filtering for only matching known nicknames further down if we do this
-    };
 
-    static const int regExpCount = 2; // number of regexps in the array above
+// Matches authority and path of a URL whose scheme ends at pos. Returns the end of the URL, or -1.
+static int matchUrlTail(const QString &str, int pos)
+{
+    int length = str.length();
+
+    // All the positions the URL could end at. The regexp is greedy throughout, so it would take the last one
+    // that is followed by something isUrlEnd() accepts.
+    QVarLengthArray<int, 64> ends;
+    int i = pos;
+
+    // authority
+    if (i < length && str.at(i) == '[') {
+        int end = i + 1;
+        while (end < length && (isOneOf(str.at(end), ":.") || (str.at(end).unicode() < 128 && isxdigit(str.at(end).toLatin1()))))
+            end++;
+        if (end == i + 1 || end >= length || str.at(end) != ']')
+            return -1;
+        i = end + 1;
+        ends.append(i);
+    }
+    else {
+        forever {
+            int next = i;
+            if (next < length && isOneOf(str.at(next), ",.;@:"))
+                next++;
+            if (next >= length || !isHostChar(str.at(next)))
+                break;
+            while (next < length && isHostChar(str.at(next)))
+                ends.append(++next);
+            i = next;
+        }
+        if (ends.isEmpty())
+            return -1;
+        if (i < length && str.at(i) == '.')
+            ends.append(++i);
+    }
+
+    // port
+    if (i + 1 < length && str.at(i) == ':' && str.at(i + 1).isDigit()) {
+        i++;
+        while (i < length && str.at(i).isDigit())
+            ends.append(++i);
+    }
+
+    // path
+    if (i < length && str.at(i) == '/') {
+        ends.append(++i);
+        forever {
+            int next = i;
+            while (next < length && isOneOf(str.at(next), ",.;:"))
+                next++;
+            if (next >= length || !isUrlChar(str.at(next)))
+                break;
+            i = next + 1;
+            ends.append(i);
+        }
+    }
+
+    for (int e = ends.count() - 1; e >= 0; e--) {
+        if (isUrlEnd(str, ends.at(e)))
+            return ends.at(e);
+    }
+    return -1;
+}
 
-    qint16 matches[] = { 0, 0, 0 };
-    qint16 matchEnd[] = { 0, 0, 0 };
+
+// Returns the end of the channel name starting at pos, or -1 if there is none
+static int matchChannel(const QString &str, int pos)
+{
+    int length = str.length();
+    int start;
+    if (str.at(pos) == '#') {
+        start = pos + 1;
+    }
+    else if (str.at(pos) == '!') {
+        // safe channel, the prefix has five [A-Z0-9]
+        start = pos + 6;
+        if (start > length)
+            return -1;
+        for (int i = pos + 1; i < start; i++) {
+            ushort c = str.at(i).unicode();
+            if (c >= 128 || !isalnum(c))
+                return -1;
+        }
+    }
+    else {
+        return -1;
+    }
+
+    int nameEnd = start;
+    while (nameEnd < length && isChannelChar(str.at(nameEnd)))
+        nameEnd++;
+    if (nameEnd == start)
+        return -1;
+
+    // the name may be followed by a :suffix; we try the longest match first, as the regexp did
+    if (nameEnd + 1 < length && str.at(nameEnd) == ':' && isChannelChar(str.at(nameEnd + 1))) {
+        int end = nameEnd + 1;
+        while (end < length && isChannelChar(str.at(end)))
+            end++;
+        for (; end > nameEnd + 1; end--) {
+            if (isWordBoundary(str, end))
+                return end;
+        }
+    }
+    for (int end = nameEnd; end > start; end--) {
+        if (isWordBoundary(str, end))
+            return end;
+    }
+    return -1;
+}
+
+
+// Whether the given channel name is just a #number
+static bool isChannelNumber(const QString &str, int start, int end)
+{
+    if (str.at(start) != '#')
+        return false;
+    for (int i = start + 1; i < end; i++) {
+        if (!str.at(i).isDigit())
+            return false;
+    }
+    return true;
+}
+
+
+ClickableList ClickableList::fromString(const QString &str)
+{
+    // TODO: Nicks, we'll need a filtering for only matching known nicknames further down if we do this
 
     ClickableList result;
-    //QString str = data(ChatLineModel::DisplayRole).toString();
-
-    qint16 idx = 0;
-    qint16 minidx;
-    int type = -1;
-
-    do {
-        type = -1;
-        minidx = str.length();
-        for (int i = 0; i < regExpCount; i++) {
-            if (matches[i] < 0 || matchEnd[i] > str.length()) continue;
-            if (idx >= matchEnd[i]) {
-                matches[i] = regExp[i].indexIn(str, qMax(matchEnd[i], idx));
-                if (matches[i] >= 0) matchEnd[i] = matches[i] + regExp[i].cap(1).length();
-            }
-            if (matches[i] >= 0 && matches[i] < minidx) {
-                minidx = matches[i];
-                type = i;
+    int length = str.length();
+    int idx = 0;
+    while (idx < length) {
+        const QChar c = str.at(idx);
+        Clickable::Type type = Clickable::Invalid;
+        int end = -1;
+
+        if ((isWordChar(c) || isOneOf(c, "+.-")) && isWordBoundary(str, idx)) {
+            int schemeEnd = matchUrlScheme(str, idx);
+            if (schemeEnd >= 0) {
+                end = matchUrlTail(str, schemeEnd);
+                type = Clickable::Url;
             }
         }
-        if (type >= 0) {
-            idx = matchEnd[type];
-            QString match = str.mid(matches[type], matchEnd[type] - matches[type]);
-            if (type == Clickable::Url && str.at(idx-1) == ')') { // special case: closing paren only matches if we had an open one
-                if (!match.contains('(')) {
-                    matchEnd[type]--;
-                    match.chop(1);
-                }
-            }
-            if (type == Clickable::Channel) {
-                // don't make clickable if it could be a #number
-                if (QRegExp("^#\\d+$").exactMatch(match))
-                    continue;
-            }
-            result.append(Clickable((Clickable::Type)type, matches[type], matchEnd[type] - matches[type]));
+        // We don't match for channel names starting with + or &, because that gives us a lot of false positives.
+        if (end < 0 && (c == '#' || c == '!')) {
+            end = matchChannel(str, idx);
+            type = Clickable::Channel;
+        }
+        if (end < 0) {
+            idx++;
+            continue;
+        }
+
+        if (type == Clickable::Url && str.at(end - 1) == ')') {
+            // special case: closing paren only matches if we had an open one
+            if (str.lastIndexOf('(', end - 1) < idx)
+                end--;
         }
+        // don't make clickable if it could be a #number
+        if (type != Clickable::Channel || !isChannelNumber(str, idx, end))
+            result.append(Clickable(type, idx, end - idx));
+        idx = end;
     }
-    while (type >= 0);
     return result;
 }
 
@@ -0,0 +1,520 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2016 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "nicklistmodel.h"
+
+#include <QMap>
+
+#include "client.h"
+#include "graphicalui.h"
+#include "ircchannel.h"
+#include "ircuser.h"
+#include "network.h"
+#include "networkmodel.h"
+#include "uistyle.h"
+
+// changes are applied at most once per frame
+const int updateInterval = 16;
+// batches larger than this (and than a quarter of the list) are applied with a model reset
+const int resetThreshold = 64;
+
+NickListModel::NickListModel(const BufferInfo &bufferInfo, QObject *parent)
+    : QAbstractItemModel(parent),
+    _bufferInfo(bufferInfo),
+    _categoriesChanged(false)
+{
+    _updateTimer.setSingleShot(true);
+    _updateTimer.setInterval(updateInterval);
+    connect(&_updateTimer, SIGNAL(timeout()), SLOT(applyPendingChanges()));
+
+    const Network *network = Client::network(bufferInfo.networkId());
+    if (network) {
+        connect(network, SIGNAL(ircChannelAdded(IrcChannel *)), SLOT(attachIrcChannel(IrcChannel *)));
+        IrcChannel *ircChannel = network->ircChannel(bufferInfo.bufferName());
+        if (ircChannel)
+            attachIrcChannel(ircChannel);
+    }
+}
+
+
+NickListModel::~NickListModel()
+{
+    qDeleteAll(_categories);
+}
+
+
+QModelIndex NickListModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (row < 0 || column != 0)
+        return QModelIndex();
+
+    if (!parent.isValid()) {
+        if (row >= _categories.count())
+            return QModelIndex();
+        return createIndex(row, column);
+    }
+
+    // users don't have any children
+    if (parent.internalPointer() || parent.row() >= _categories.count())
+        return QModelIndex();
+
+    Category *category = _categories.at(parent.row());
+    if (row >= category->users.count())
+        return QModelIndex();
+
+    return createIndex(row, column, category);
+}
+
+
+QModelIndex NickListModel::parent(const QModelIndex &index) const
+{
+    if (!index.isValid() || !index.internalPointer())
+        return QModelIndex();
+
+    Category *category = static_cast<Category *>(index.internalPointer());
+    return createIndex(_categories.indexOf(category), 0);
+}
+
+
+int NickListModel::rowCount(const QModelIndex &parent) const
+{
+    if (!parent.isValid())
+        return _categories.count();
+
+    if (parent.column() != 0 || parent.internalPointer() || parent.row() >= _categories.count())
+        return 0;
+
+    return _categories.at(parent.row())->users.count();
+}
+
+
+int NickListModel::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+    return 1;
+}
+
+
+QVariant NickListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid())
+        return QVariant();
+
+    switch (role) {
+    case Qt::FontRole:
+    case Qt::ForegroundRole:
+    case Qt::BackgroundRole:
+    case Qt::DecorationRole:
+        return GraphicalUi::uiStyle()->nickViewItemData(index, role);
+    case NetworkModel::BufferIdRole:
+        return qVariantFromValue(_bufferInfo.bufferId());
+    case NetworkModel::NetworkIdRole:
+        return qVariantFromValue(_bufferInfo.networkId());
+    case NetworkModel::BufferInfoRole:
+        return qVariantFromValue(_bufferInfo);
+    default:
+        break;
+    }
+
+    Category *category = static_cast<Category *>(index.internalPointer());
+    if (!category) {
+        category = _categories.at(index.row());
+        switch (role) {
+        case Qt::DisplayRole:
+            return UserCategoryItem::categoryName(category->categoryId, category->users.count());
+        case TreeModel::SortRole:
+            return category->categoryId;
+        case NetworkModel::ItemActiveRole:
+            return true;
+        case NetworkModel::ItemTypeRole:
+            return NetworkModel::UserCategoryItemType;
+        default:
+            return QVariant();
+        }
+    }
+
+    IrcUser *ircUser = category->users.at(index.row()).ircUser;
+    switch (role) {
+    case Qt::DisplayRole:
+    case TreeModel::SortRole:
+        return ircUser->nick();
+    case Qt::ToolTipRole:
+        return toolTip(ircUser);
+    case NetworkModel::ItemActiveRole:
+        return !ircUser->isAway();
+    case NetworkModel::ItemTypeRole:
+        return NetworkModel::IrcUserItemType;
+    case NetworkModel::IrcUserRole:
+        return QVariant::fromValue<QObject *>(ircUser);
+    case NetworkModel::IrcChannelRole:
+        return QVariant::fromValue<QObject *>(_ircChannel.data());
+    case NetworkModel::UserAwayRole:
+        return ircUser->isAway();
+    default:
+        return QVariant();
+    }
+}
+
+
+Qt::ItemFlags NickListModel::flags(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return Qt::NoItemFlags;
+
+    if (index.internalPointer())
+        return Qt::ItemIsSelectable | Qt::ItemIsEnabled;
+    else
+        return Qt::ItemIsEnabled;
+}
+
+
+void NickListModel::attachIrcChannel(IrcChannel *ircChannel)
+{
+    if (_ircChannel || ircChannel->name().compare(_bufferInfo.bufferName(), Qt::CaseInsensitive) != 0)
+        return;
+
+    _ircChannel = ircChannel;
+
+    connect(ircChannel, SIGNAL(destroyed()), SLOT(ircChannelParted()));
+    connect(ircChannel, SIGNAL(parted()), SLOT(ircChannelParted()));
+    connect(ircChannel, SIGNAL(ircUsersJoined(QList<IrcUser *>)), SLOT(ircUsersJoined(QList<IrcUser *>)));
+    connect(ircChannel, SIGNAL(ircUserParted(IrcUser *)), SLOT(ircUserParted(IrcUser *)));
+    connect(ircChannel, SIGNAL(ircUserNickSet(IrcUser *, QString)), SLOT(ircUserMoved(IrcUser *)));
+    connect(ircChannel, SIGNAL(ircUserModesSet(IrcUser *, QString)), SLOT(ircUserMoved(IrcUser *)));
+    connect(ircChannel, SIGNAL(ircUserModeAdded(IrcUser *, QString)), SLOT(ircUserMoved(IrcUser *)));
+    connect(ircChannel, SIGNAL(ircUserModeRemoved(IrcUser *, QString)), SLOT(ircUserMoved(IrcUser *)));
+
+    if (!ircChannel->ircUsers().isEmpty()) {
+        ircUsersJoined(ircChannel->ircUsers());
+        applyPendingChanges();
+    }
+}
+
+
+void NickListModel::ircChannelParted()
+{
+    if (_ircChannel) {
+        disconnect(_ircChannel, 0, this, 0);
+        _ircChannel = 0;
+    }
+    clear();
+}
+
+
+void NickListModel::ircUsersJoined(const QList<IrcUser *> &ircUsers)
+{
+    foreach(IrcUser *ircUser, ircUsers) {
+        if (_members.contains(ircUser))
+            continue;
+
+        _members.insert(ircUser);
+        _pendingUsers.insert(ircUser);
+        connectUser(ircUser);
+    }
+    scheduleUpdate();
+}
+
+
+void NickListModel::ircUserParted(IrcUser *ircUser)
+{
+    // we stay connected until the user is actually removed, so we notice if it's destroyed meanwhile
+    _members.remove(ircUser);
+    _pendingUsers.insert(ircUser);
+    scheduleUpdate();
+}
+
+
+void NickListModel::ircUserMoved(IrcUser *ircUser)
+{
+    _toolTips.remove(ircUser);
+    _pendingUsers.insert(ircUser);
+    scheduleUpdate();
+}
+
+
+void NickListModel::ircUserUpdated()
+{
+    IrcUser *ircUser = qobject_cast<IrcUser *>(sender());
+    if (!ircUser)
+        return;
+
+    _toolTips.remove(ircUser);
+    _changedUsers.insert(ircUser);
+    scheduleUpdate();
+}
+
+
+void NickListModel::ircUserDestroyed(QObject *object)
+{
+    // only use the pointer as a key, the IrcUser part of the object is gone already
+    IrcUser *ircUser = static_cast<IrcUser *>(object);
+    _members.remove(ircUser);
+    _pendingUsers.remove(ircUser);
+    _changedUsers.remove(ircUser);
+    _toolTips.remove(ircUser);
+
+    if (_userCategories.contains(ircUser)) {
+        removeUser(ircUser);
+        scheduleUpdate();
+    }
+}
+
+
+void NickListModel::scheduleUpdate()
+{
+    if (!_updateTimer.isActive())
+        _updateTimer.start();
+}
+
+
+void NickListModel::applyPendingChanges()
+{
+    _updateTimer.stop();
+
+    if (_pendingUsers.count() > resetThreshold && _pendingUsers.count() * 4 > _userCategories.count()) {
+        rebuild();
+        return;
+    }
+
+    foreach(IrcUser *ircUser, _pendingUsers) {
+        int categoryId = -1;
+        if (_ircChannel && _members.contains(ircUser))
+            categoryId = UserCategoryItem::categoryFromModes(_ircChannel->userModes(ircUser));
+
+        if (_userCategories.contains(ircUser)) {
+            if (_userCategories.value(ircUser) == categoryId && _userNicks.value(ircUser) == ircUser->nick()) {
+                _changedUsers.insert(ircUser);
+                continue;
+            }
+            removeUser(ircUser);
+        }
+
+        if (categoryId != -1)
+            insertUser(ircUser, categoryId);
+        else
+            disconnectUser(ircUser);
+    }
+    _pendingUsers.clear();
+
+    // emit one dataChanged() per category, spanning all of its changed users
+    QHash<int, QPair<int, int> > changedRows;
+    foreach(IrcUser *ircUser, _changedUsers) {
+        if (!_userCategories.contains(ircUser))
+            continue;
+
+        int catRow = categoryRow(_userCategories.value(ircUser));
+        const QVector<NickEntry> &users = _categories.at(catRow)->users;
+        NickEntry entry = { _userNicks.value(ircUser), ircUser };
+        int row = qLowerBound(users.begin(), users.end(), entry, nickEntryLessThan) - users.begin();
+
+        if (!changedRows.contains(catRow)) {
+            changedRows[catRow] = qMakePair(row, row);
+        }
+        else {
+            QPair<int, int> &range = changedRows[catRow];
+            range.first = qMin(range.first, row);
+            range.second = qMax(range.second, row);
+        }
+    }
+    _changedUsers.clear();
+
+    QHash<int, QPair<int, int> >::const_iterator rangeIter = changedRows.constBegin();
+    while (rangeIter != changedRows.constEnd()) {
+        QModelIndex parent = index(rangeIter.key(), 0);
+        emit dataChanged(index(rangeIter->first, 0, parent), index(rangeIter->second, 0, parent));
+        ++rangeIter;
+    }
+
+    // the category names contain the number of users
+    if (_categoriesChanged && !_categories.isEmpty())
+        emit dataChanged(index(0, 0), index(_categories.count() - 1, 0));
+    _categoriesChanged = false;
+}
+
+
+void NickListModel::rebuild()
+{
+    beginResetModel();
+
+    qDeleteAll(_categories);
+    _categories.clear();
+    _userCategories.clear();
+    _userNicks.clear();
+
+    foreach(IrcUser *ircUser, _pendingUsers) {
+        if (!_members.contains(ircUser))
+            disconnectUser(ircUser);
+    }
+
+    QMap<int, Category *> categories;
+    foreach(IrcUser *ircUser, _members) {
+        int categoryId = UserCategoryItem::categoryFromModes(_ircChannel->userModes(ircUser));
+        Category *&category = categories[categoryId];
+        if (!category)
+            category = new Category(categoryId);
+
+        NickEntry entry = { ircUser->nick(), ircUser };
+        category->users.append(entry);
+        _userCategories[ircUser] = categoryId;
+        _userNicks[ircUser] = entry.nick;
+    }
+
+    foreach(Category *category, categories) {
+        qSort(category->users.begin(), category->users.end(), nickEntryLessThan);
+        _categories << category;
+    }
+
+    _pendingUsers.clear();
+    _changedUsers.clear();
+    _categoriesChanged = false;
+
+    endResetModel();
+}
+
+
+void NickListModel::clear()
+{
+    _updateTimer.stop();
+
+    beginResetModel();
+
+    QSet<IrcUser *> connectedUsers = _members + _pendingUsers;
+    foreach(IrcUser *ircUser, _userCategories.keys())
+        connectedUsers.insert(ircUser);
+    foreach(IrcUser *ircUser, connectedUsers)
+        disconnectUser(ircUser);
+
+    qDeleteAll(_categories);
+    _categories.clear();
+    _userCategories.clear();
+    _userNicks.clear();
+    _members.clear();
+    _pendingUsers.clear();
+    _changedUsers.clear();
+    _toolTips.clear();
+    _categoriesChanged = false;
+
+    endResetModel();
+}
+
+
+void NickListModel::connectUser(IrcUser *ircUser)
+{
+    connect(ircUser, SIGNAL(awaySet(bool)), this, SLOT(ircUserUpdated()), Qt::UniqueConnection);
+    connect(ircUser, SIGNAL(updatedRemotely()), this, SLOT(ircUserUpdated()), Qt::UniqueConnection);
+    connect(ircUser, SIGNAL(initDone()), this, SLOT(ircUserUpdated()), Qt::UniqueConnection);
+    connect(ircUser, SIGNAL(destroyed(QObject *)), this, SLOT(ircUserDestroyed(QObject *)), Qt::UniqueConnection);
+}
+
+
+void NickListModel::disconnectUser(IrcUser *ircUser)
+{
+    disconnect(ircUser, 0, this, 0);
+    _toolTips.remove(ircUser);
+}
+
+
+bool NickListModel::nickEntryLessThan(const NickEntry &left, const NickEntry &right)
+{
+    int result = QString::compare(left.nick, right.nick, Qt::CaseInsensitive);
+    if (result != 0)
+        return result < 0;
+
+    // only to get a strict ordering, so we can find users by binary search
+    return left.ircUser < right.ircUser;
+}
+
+
+int NickListModel::categoryRow(int categoryId) const
+{
+    for (int i = 0; i < _categories.count(); i++) {
+        if (_categories.at(i)->categoryId == categoryId)
+            return i;
+    }
+    return -1;
+}
+
+
+void NickListModel::insertUser(IrcUser *ircUser, int categoryId)
+{
+    int catRow = 0;
+    while (catRow < _categories.count() && _categories.at(catRow)->categoryId < categoryId)
+        catRow++;
+
+    if (catRow == _categories.count() || _categories.at(catRow)->categoryId != categoryId) {
+        // insert the category empty, so views notice the new parent once its users arrive
+        beginInsertRows(QModelIndex(), catRow, catRow);
+        _categories.insert(catRow, new Category(categoryId));
+        endInsertRows();
+    }
+
+    QVector<NickEntry> &users = _categories.at(catRow)->users;
+    NickEntry entry = { ircUser->nick(), ircUser };
+    int row = qLowerBound(users.begin(), users.end(), entry, nickEntryLessThan) - users.begin();
+
+    beginInsertRows(index(catRow, 0), row, row);
+    users.insert(row, entry);
+    _userCategories[ircUser] = categoryId;
+    _userNicks[ircUser] = entry.nick;
+    endInsertRows();
+
+    _categoriesChanged = true;
+}
+
+
+// Must not touch the IrcUser itself, as it might be in the middle of being destroyed
+void NickListModel::removeUser(IrcUser *ircUser)
+{
+    int catRow = categoryRow(_userCategories.take(ircUser));
+    Q_ASSERT(catRow != -1);
+
+    QVector<NickEntry> &users = _categories.at(catRow)->users;
+    NickEntry entry = { _userNicks.take(ircUser), ircUser };
+    int row = qLowerBound(users.begin(), users.end(), entry, nickEntryLessThan) - users.begin();
+    Q_ASSERT(row < users.count() && users.at(row).ircUser == ircUser);
+
+    beginRemoveRows(index(catRow, 0), row, row);
+    users.remove(row);
+    endRemoveRows();
+
+    if (users.isEmpty()) {
+        beginRemoveRows(QModelIndex(), catRow, catRow);
+        delete _categories.takeAt(catRow);
+        endRemoveRows();
+    }
+
+    _categoriesChanged = true;
+}
+
+
+QString NickListModel::toolTip(IrcUser *ircUser) const
+{
+    QHash<IrcUser *, QString>::const_iterator iter = _toolTips.constFind(ircUser);
+    if (iter != _toolTips.constEnd())
+        return *iter;
+
+    QString toolTip = IrcUserItem::userToolTip(ircUser, _ircChannel ? _ircChannel->userModes(ircUser) : QString());
+
+    // the idle time is shown relative to now, so we can't keep that around
+    if (!ircUser->idleTime().isValid())
+        _toolTips[ircUser] = toolTip;
+
+    return toolTip;
+}
@@ -0,0 +1,114 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2016 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#ifndef NICKLISTMODEL_H
+#define NICKLISTMODEL_H
+
+#include <QAbstractItemModel>
+#include <QHash>
+#include <QPointer>
+#include <QSet>
+#include <QTimer>
+#include <QVector>
+
+#include "bufferinfo.h"
+
+class IrcChannel;
+class IrcUser;
+
+//! The nick list of a single channel, kept up to date incrementally
+/** Rather than filtering and sorting the channel's subtree of the NetworkModel, this keeps the
+ *  users of each category in a presorted vector. Joins, parts, mode and nick changes are collected and applied
+ *  at most once per frame, as are the resulting dataChanged() signals. Larger batches, such as a
+ *  netjoin, are applied with a single model reset instead of row by row.
+ *
+ *  The model provides the same roles as the channel's subtree of the NetworkModel, so views and
+ *  action providers can treat its indexes alike.
+ */
+class NickListModel : public QAbstractItemModel
+{
+    Q_OBJECT
+
+public:
+    NickListModel(const BufferInfo &bufferInfo, QObject *parent = 0);
+    ~NickListModel();
+
+    inline BufferId bufferId() const { return _bufferInfo.bufferId(); }
+
+    virtual QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const;
+    virtual QModelIndex parent(const QModelIndex &index) const;
+    virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    virtual int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    virtual QVariant data(const QModelIndex &index, int role) const;
+    virtual Qt::ItemFlags flags(const QModelIndex &index) const;
+
+private slots:
+    void attachIrcChannel(IrcChannel *ircChannel);
+    void ircChannelParted();
+    void ircUsersJoined(const QList<IrcUser *> &ircUsers);
+    void ircUserParted(IrcUser *ircUser);
+    void ircUserMoved(IrcUser *ircUser); // modes or nick changed
+    void ircUserUpdated();
+    void ircUserDestroyed(QObject *object);
+    void applyPendingChanges();
+
+private:
+    struct NickEntry {
+        QString nick; // the nick we were sorted by
+        IrcUser *ircUser;
+    };
+
+    struct Category {
+        Category(int categoryId) : categoryId(categoryId) {}
+        int categoryId;
+        QVector<NickEntry> users;
+    };
+
+    static bool nickEntryLessThan(const NickEntry &left, const NickEntry &right);
+
+    void scheduleUpdate();
+    void rebuild();
+    void clear();
+    void connectUser(IrcUser *ircUser);
+    void disconnectUser(IrcUser *ircUser);
+
+    int categoryRow(int categoryId) const;
+    void insertUser(IrcUser *ircUser, int categoryId);
+    void removeUser(IrcUser *ircUser);
+    QString toolTip(IrcUser *ircUser) const;
+
+    BufferInfo _bufferInfo;
+    QPointer<IrcChannel> _ircChannel;
+
+    QList<Category *> _categories; // ordered by category id, empty ones are removed
+    QHash<IrcUser *, int> _userCategories; // category id of every user we show
+    QHash<IrcUser *, QString> _userNicks; // nick every user we show was sorted by
+
+    QSet<IrcUser *> _members;
+    QSet<IrcUser *> _pendingUsers; // need to be (re)inserted or removed
+    QSet<IrcUser *> _changedUsers; // only their data changed
+    bool _categoriesChanged;
+    QTimer _updateTimer;
+
+    mutable QHash<IrcUser *, QString> _toolTips;
+};
+
+
+#endif
@@ -31,7 +31,6 @@
 #include "contextmenuactionprovider.h"
 #include "graphicalui.h"
 #include "nickview.h"
-#include "nickviewfilter.h"
 #include "networkmodel.h"
 #include "types.h"
 
@@ -82,6 +81,14 @@ void NickView::setModel(QAbstractItemModel *model_)
 
     TreeViewTouch::setModel(model_);
     init();
+    unanimatedExpandAll();
+}
+
+
+void NickView::reset()
+{
+    TreeViewTouch::reset();
+    unanimatedExpandAll();
 }
 
 
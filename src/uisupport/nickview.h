@@ -44,6 +44,7 @@ protected:
 public slots:
     virtual void setModel(QAbstractItemModel *model);
     virtual void setRootIndex(const QModelIndex &index);
+    virtual void reset();
     void init();
     void showContextMenu(const QPoint &pos);
     void startQuery(const QModelIndex &modelIndex);
@@ -19,12 +19,33 @@
  ***************************************************************************/
 
 #include <QApplication>
+#include <QCryptographicHash>
+#include <QFile>
 
 #include "qssparser.h"
 
-QssParser::QssParser()
+// A compiled stylesheet is stored as
+//   magic | version | key | palette entries | UiStyle palette | formats | list item formats | remaining sheet
+static const quint32 compiledMagic = 0x51515343; // "QQSC"
+static const quint32 compiledVersion = 2;
+
+QDataStream &operator<<(QDataStream &out, const QssParser::PaletteEntry &entry)
+{
+    out << entry.colorGroups << entry.role << entry.brush;
+    return out;
+}
+
+
+QDataStream &operator>>(QDataStream &in, QssParser::PaletteEntry &entry)
+{
+    in >> entry.colorGroups >> entry.role >> entry.brush;
+    return in;
+}
+
+
+QssParser::QssParser(const QPalette &palette)
+    : _palette(palette)
 {
-    _palette = QApplication::palette();
 
     // Init palette color roles
     _paletteColorRoles["alternate-base"] = QPalette::AlternateBase;
@@ -93,6 +114,89 @@ void QssParser::processStyleSheet(QString &ss)
 }
 
 
+QByteArray QssParser::compiledKey(const QString &sheet, const QPalette &palette)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray::number(compiledVersion));
+    hash.addData(sheet.toUtf8());
+
+    // palette(...) references are resolved against the palette we start from, so a changed
+    // system or Qt palette must invalidate the compiled result as well
+    QByteArray paletteData;
+    QDataStream out(&paletteData, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_6);
+    out << palette;
+    hash.addData(paletteData);
+    return hash.result();
+}
+
+
+bool QssParser::loadCompiled(const QString &fileName, const QByteArray &key, QString *sheet)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_4_6);
+    quint32 magic, version;
+    QByteArray fileKey;
+    in >> magic >> version >> fileKey;
+    if (in.status() != QDataStream::Ok || magic != compiledMagic || version != compiledVersion || fileKey != key)
+        return false;
+
+    QList<PaletteEntry> paletteEntries;
+    QVector<QBrush> uiStylePalette;
+    QHash<quint64, QTextCharFormat> formats;
+    QHash<quint32, QTextCharFormat> listItemFormats;
+    QString remainingSheet;
+    in >> paletteEntries >> uiStylePalette >> formats >> listItemFormats >> remainingSheet;
+    if (in.status() != QDataStream::Ok || uiStylePalette.count() != _uiStylePalette.count()) {
+        qWarning() << "Discarding unusable compiled stylesheet" << fileName;
+        return false;
+    }
+
+    foreach(const PaletteEntry &entry, paletteEntries)
+        setPaletteBrush(entry);
+    _paletteEntries = paletteEntries;
+    _uiStylePalette = uiStylePalette;
+    _formats = formats;
+    _listItemFormats = listItemFormats;
+    *sheet = remainingSheet;
+    return true;
+}
+
+
+bool QssParser::saveCompiled(const QString &fileName, const QByteArray &key, const QString &sheet) const
+{
+    // write to a temporary file first, so a crash doesn't leave a truncated file behind
+    QFile file(fileName + ".new");
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Could not save compiled stylesheet" << fileName << ":" << qPrintable(file.errorString());
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_4_6);
+    out << compiledMagic << compiledVersion << key;
+    out << _paletteEntries << _uiStylePalette << _formats << _listItemFormats << sheet;
+    file.close();
+    if (out.status() != QDataStream::Ok || file.error() != QFile::NoError) {
+        qWarning() << "Could not save compiled stylesheet" << fileName << ":" << qPrintable(file.errorString());
+        file.remove();
+        return false;
+    }
+
+    QFile::remove(fileName);
+    if (!file.rename(fileName)) {
+        qWarning() << "Could not replace compiled stylesheet" << fileName;
+        file.remove();
+        return false;
+    }
+    return true;
+}
+
+
 /******** Parse a whole block: declaration { contents } *******/
 
 void QssParser::parseChatLineBlock(const QString &decl, const QString &contents)
@@ -120,7 +224,7 @@ void QssParser::parseListItemBlock(const QString &decl, const QString &contents)
 //   Palette:inactive:disabled { ... } applies to both the Inactive and the Disabled state
 void QssParser::parsePaletteBlock(const QString &decl, const QString &contents)
 {
-    QList<QPalette::ColorGroup> colorGroups;
+    quint8 colorGroups = 0;
 
     // Check if we want to apply this palette definition for particular ColorGroups
     QRegExp rx("Palette((:(normal|active|inactive|disabled))*)");
@@ -131,12 +235,12 @@ void QssParser::parsePaletteBlock(const QString &decl, const QString &contents)
     if (!rx.cap(1).isEmpty()) {
         QStringList groups = rx.cap(1).split(':', QString::SkipEmptyParts);
         foreach(QString g, groups) {
-            if ((g == "normal" || g == "active") && !colorGroups.contains(QPalette::Active))
-                colorGroups.append(QPalette::Active);
-            else if (g == "inactive" && !colorGroups.contains(QPalette::Inactive))
-                colorGroups.append(QPalette::Inactive);
-            else if (g == "disabled" && !colorGroups.contains(QPalette::Disabled))
-                colorGroups.append(QPalette::Disabled);
+            if (g == "normal" || g == "active")
+                colorGroups |= 1 << QPalette::Active;
+            else if (g == "inactive")
+                colorGroups |= 1 << QPalette::Inactive;
+            else if (g == "disabled")
+                colorGroups |= 1 << QPalette::Disabled;
         }
     }
 
@@ -151,13 +255,12 @@ void QssParser::parsePaletteBlock(const QString &decl, const QString &contents)
         QString brushstr = line.mid(idx + 1).trimmed();
 
         if (_paletteColorRoles.contains(rolestr)) {
-            QBrush brush = parseBrush(brushstr);
-            if (colorGroups.count()) {
-                foreach(QPalette::ColorGroup group, colorGroups)
-                _palette.setBrush(group, _paletteColorRoles.value(rolestr), brush);
-            }
-            else
-                _palette.setBrush(_paletteColorRoles.value(rolestr), brush);
+            PaletteEntry entry;
+            entry.colorGroups = colorGroups;
+            entry.role = _paletteColorRoles.value(rolestr);
+            entry.brush = parseBrush(brushstr);
+            setPaletteBrush(entry);
+            _paletteEntries << entry;
         }
         else if (_uiStyleColorRoles.contains(rolestr)) {
             _uiStylePalette[_uiStyleColorRoles.value(rolestr)] = parseBrush(brushstr);
@@ -168,6 +271,20 @@ void QssParser::parsePaletteBlock(const QString &decl, const QString &contents)
 }
 
 
+void QssParser::setPaletteBrush(const PaletteEntry &entry)
+{
+    QPalette::ColorRole role = (QPalette::ColorRole)entry.role;
+    if (!entry.colorGroups) {
+        _palette.setBrush(role, entry.brush);
+        return;
+    }
+    for (int group = QPalette::Active; group <= QPalette::Inactive; group++) {
+        if (entry.colorGroups & (1 << group))
+            _palette.setBrush((QPalette::ColorGroup)group, role, entry.brush);
+    }
+}
+
+
 /******** Determine format types from a block declaration ********/
 
 quint64 QssParser::parseFormatType(const QString &decl)
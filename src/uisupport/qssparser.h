@@ -28,10 +28,25 @@ class QssParser
     Q_DECLARE_TR_FUNCTIONS(QssParser)
 
 public:
-    QssParser();
+    //! Creates a parser whose palette(...) references and palette block start from the given palette
+    explicit QssParser(const QPalette &palette);
 
     void processStyleSheet(QString &sheet);
 
+    //! Key identifying the compiled form of the given (unprocessed) stylesheet and the palette the parser starts from
+    static QByteArray compiledKey(const QString &sheet, const QPalette &palette);
+
+    //! Loads the result of an earlier processStyleSheet() from disk
+    /** \param fileName  The file the compiled stylesheet was saved to
+     *  \param key       The compiledKey() of the stylesheet to be processed
+     *  \param sheet     Is set to what processStyleSheet() would have left over
+     *  \return true, if the file contained a compiled stylesheet for the given key
+     */
+    bool loadCompiled(const QString &fileName, const QByteArray &key, QString *sheet);
+
+    //! Saves the result of processStyleSheet(), so loadCompiled() can skip parsing next time
+    bool saveCompiled(const QString &fileName, const QByteArray &key, const QString &sheet) const;
+
     inline QPalette palette() const { return _palette; }
     inline QVector<QBrush> uiStylePalette() const { return _uiStylePalette; }
     inline const QHash<quint64, QTextCharFormat> &formats() const { return _formats; }
@@ -40,6 +55,17 @@ public:
 protected:
     typedef QList<qreal> ColorTuple;
 
+    //! A palette role assignment; the palette we start from may differ between runs, so we keep these rather than the result
+    struct PaletteEntry {
+        quint8 colorGroups; // bit mask of QPalette::ColorGroups, 0 for all
+        quint8 role;        // QPalette::ColorRole
+        QBrush brush;
+    };
+    friend QDataStream &operator<<(QDataStream &out, const PaletteEntry &entry);
+    friend QDataStream &operator>>(QDataStream &in, PaletteEntry &entry);
+
+    void setPaletteBrush(const PaletteEntry &entry);
+
     void parseChatLineBlock(const QString &decl, const QString &contents);
     void parsePaletteBlock(const QString &decl, const QString &contents);
     void parseListItemBlock(const QString &decl, const QString &contents);
@@ -67,6 +93,7 @@ protected:
 
 private:
     QPalette _palette;
+    QList<PaletteEntry> _paletteEntries;
     QVector<QBrush> _uiStylePalette;
     QHash<quint64, QTextCharFormat> _formats;
     QHash<quint32, QTextCharFormat> _listItemFormats;
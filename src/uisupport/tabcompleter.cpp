@@ -27,23 +27,22 @@
 #include "multilineedit.h"
 #include "network.h"
 #include "networkmodel.h"
+#include "tabcompletionindex.h"
 #include "uisettings.h"
 #include "action.h"
 #include "actioncollection.h"
 #include "graphicalui.h"
 
 #include <QRegExp>
-
-const Network *TabCompleter::_currentNetwork;
-BufferId TabCompleter::_currentBufferId;
-QString TabCompleter::_currentBufferName;
-TabCompleter::Type TabCompleter::_completionType;
+#include <QSet>
 
 TabCompleter::TabCompleter(MultiLineEdit *_lineEdit)
     : QObject(_lineEdit),
     _lineEdit(_lineEdit),
     _enabled(false),
-    _nickSuffix(": ")
+    _nickSuffix(": "),
+    _nextCompletion(0),
+    _lastCompletionLength(0)
 {
     // This Action just serves as a container for the custom shortcut and isn't actually handled;
     // apparently, using tab as an Action shortcut  in an input widget is unreliable on some platforms (e.g. OS/2)
@@ -64,8 +63,8 @@ void TabCompleter::onTabCompletionKey()
 void TabCompleter::buildCompletionList()
 {
     // ensure a safe state in case we return early.
-    _completionMap.clear();
-    _nextCompletion = _completionMap.begin();
+    _completions.clear();
+    _nextCompletion = 0;
 
     // this is the first time tab is pressed -> build up the completion list and it's iterator
     QModelIndex currentIndex = Client::bufferModel()->currentIndex();
@@ -74,21 +73,30 @@ void TabCompleter::buildCompletionList()
         return;
 
     NetworkId networkId = currentIndex.data(NetworkModel::NetworkIdRole).value<NetworkId>();
-    _currentBufferName = currentIndex.sibling(currentIndex.row(), 0).data().toString();
+    QString currentBufferName = currentIndex.sibling(currentIndex.row(), 0).data().toString();
 
-    _currentNetwork = Client::network(networkId);
-    if (!_currentNetwork)
+    const Network *network = Client::network(networkId);
+    if (!network)
         return;
 
     QString tabAbbrev = _lineEdit->text().left(_lineEdit->cursorPosition()).section(QRegExp("[^#\\w\\d-_\\[\\]{}|`^.\\\\]"), -1, -1);
     QRegExp regex(QString("^[-_\\[\\]{}|`^.\\\\]*").append(QRegExp::escape(tabAbbrev)), Qt::CaseInsensitive);
 
-    // channel completion - add all channels of the current network to the map
+    // The index narrows things down to the candidates sharing the abbreviation's key, so we only need to check those
+    TabCompletionIndex *index = TabCompletionIndex::forNetwork(network);
+    QList<Completion> completions;
+
+    // channel completion - add all matching channels of the current network
     if (tabAbbrev.startsWith('#')) {
         _completionType = ChannelTab;
-        foreach(IrcChannel *ircChannel, _currentNetwork->ircChannels()) {
-            if (regex.indexIn(ircChannel->name()) > -1)
-                _completionMap[ircChannel->name()] = ircChannel->name();
+        foreach(IrcChannel *ircChannel, index->channels(tabAbbrev)) {
+            if (regex.indexIn(ircChannel->name()) < 0)
+                continue;
+            Completion completion;
+            completion.text = ircChannel->name();
+            completion.rank = QString::compare(currentBufferName, ircChannel->name(), Qt::CaseInsensitive) == 0 ? 0 : 1;
+            completion.isUser = false;
+            completions << completion;
         }
     }
     else {
@@ -97,32 +105,57 @@ void TabCompleter::buildCompletionList()
         switch (static_cast<BufferInfo::Type>(currentIndex.data(NetworkModel::BufferTypeRole).toInt())) {
         case BufferInfo::ChannelBuffer:
         { // scope is needed for local var declaration
-            IrcChannel *channel = _currentNetwork->ircChannel(_currentBufferName);
+            IrcChannel *channel = network->ircChannel(currentBufferName);
             if (!channel)
                 return;
-            foreach(IrcUser *ircUser, channel->ircUsers()) {
+            foreach(IrcUser *ircUser, index->channelUsers(channel, tabAbbrev)) {
                 if (regex.indexIn(ircUser->nick()) > -1)
-                    _completionMap[ircUser->nick().toLower()] = ircUser->nick();
+                    addUserCompletion(completions, network, ircUser, ircUser->nick());
             }
         }
         break;
         case BufferInfo::QueryBuffer:
-            if (regex.indexIn(_currentBufferName) > -1)
-                _completionMap[_currentBufferName.toLower()] = _currentBufferName;
+            if (regex.indexIn(currentBufferName) > -1)
+                addUserCompletion(completions, network, network->ircUser(currentBufferName), currentBufferName);
         case BufferInfo::StatusBuffer:
-            if (!_currentNetwork->myNick().isEmpty() && regex.indexIn(_currentNetwork->myNick()) > -1)
-                _completionMap[_currentNetwork->myNick().toLower()] = _currentNetwork->myNick();
+            if (!network->myNick().isEmpty() && regex.indexIn(network->myNick()) > -1)
+                addUserCompletion(completions, network, network->me(), network->myNick());
             break;
         default:
             return;
         }
     }
 
-    _nextCompletion = _completionMap.begin();
+    qSort(completions.begin(), completions.end(), completionLessThan);
+
+    // the same nick may show up more than once in query buffers
+    QSet<QString> seen;
+    foreach(const Completion &completion, completions) {
+        QString key = completion.text.toLower();
+        if (!seen.contains(key)) {
+            seen.insert(key);
+            _completions << completion.text;
+        }
+    }
     _lastCompletionLength = tabAbbrev.length();
 }
 
 
+void TabCompleter::addUserCompletion(QList<Completion> &completions, const Network *network, IrcUser *ircUser, const QString &nick)
+{
+    Completion completion;
+    completion.text = nick;
+    completion.rank = ircUser && network->isMe(ircUser) ? 1 : 0; // our own nick comes last
+    completion.isUser = ircUser != 0;
+    if (ircUser) {
+        // the timestamps are looked up once here rather than on every comparison
+        completion.lastSpokenTo = ircUser->lastSpokenTo(_currentBufferId);
+        completion.lastChannelActivity = ircUser->lastChannelActivity(_currentBufferId);
+    }
+    completions << completion;
+}
+
+
 void TabCompleter::complete()
 {
     TabCompletionSettings s;
@@ -133,17 +166,18 @@ void TabCompleter::complete()
         _enabled = true;
     }
 
-    if (_nextCompletion != _completionMap.end()) {
+    if (_nextCompletion < _completions.count()) {
         // clear previous completion
         for (int i = 0; i < _lastCompletionLength; i++) {
             _lineEdit->backspace();
         }
 
         // insert completion
-        _lineEdit->insert(*_nextCompletion);
+        const QString &completion = _completions.at(_nextCompletion);
+        _lineEdit->insert(completion);
 
         // remember charcount to delete next time and advance to next completion
-        _lastCompletionLength = _nextCompletion->length();
+        _lastCompletionLength = completion.length();
         _nextCompletion++;
 
         // we're completing the first word of the line
@@ -159,8 +193,8 @@ void TabCompleter::complete()
         // we're at the end of the list -> start over again
     }
     else {
-        if (!_completionMap.isEmpty()) {
-            _nextCompletion = _completionMap.begin();
+        if (!_completions.isEmpty()) {
+            _nextCompletion = 0;
             complete();
         }
     }
@@ -190,45 +224,19 @@ bool TabCompleter::eventFilter(QObject *obj, QEvent *event)
 
 
 // this determines the sort order
-bool TabCompleter::CompletionKey::operator<(const CompletionKey &other) const
+bool TabCompleter::completionLessThan(const Completion &left, const Completion &right)
 {
-    switch (_completionType) {
-    case UserTab:
-    {
-        IrcUser *thisUser = _currentNetwork->ircUser(this->contents);
-        if (thisUser && _currentNetwork->isMe(thisUser))
-            return false;
-
-        IrcUser *thatUser = _currentNetwork->ircUser(other.contents);
-        if (thatUser && _currentNetwork->isMe(thatUser))
-            return true;
-
-        if (!thisUser || !thatUser)
-            return QString::localeAwareCompare(this->contents, other.contents) < 0;
-
-        QDateTime thisSpokenTo = thisUser->lastSpokenTo(_currentBufferId);
-        QDateTime thatSpokenTo = thatUser->lastSpokenTo(_currentBufferId);
-
-        if (thisSpokenTo.isValid() || thatSpokenTo.isValid())
-            return thisSpokenTo > thatSpokenTo;
+    // the current channel comes first, our own nick last
+    if (left.rank != right.rank)
+        return left.rank < right.rank;
 
-        QDateTime thisTime = thisUser->lastChannelActivity(_currentBufferId);
-        QDateTime thatTime = thatUser->lastChannelActivity(_currentBufferId);
+    if (left.isUser && right.isUser) {
+        if (left.lastSpokenTo.isValid() || right.lastSpokenTo.isValid())
+            return left.lastSpokenTo > right.lastSpokenTo;
 
-        if (thisTime.isValid() || thatTime.isValid())
-            return thisTime > thatTime;
-    }
-    break;
-    case ChannelTab:
-        if (QString::compare(_currentBufferName, this->contents, Qt::CaseInsensitive) == 0)
-            return true;
-
-        if (QString::compare(_currentBufferName, other.contents, Qt::CaseInsensitive) == 0)
-            return false;
-        break;
-    default:
-        break;
+        if (left.lastChannelActivity.isValid() || right.lastChannelActivity.isValid())
+            return left.lastChannelActivity > right.lastChannelActivity;
     }
 
-    return QString::localeAwareCompare(this->contents, other.contents) < 0;
+    return QString::localeAwareCompare(left.text, right.text) < 0;
 }
@@ -21,9 +21,10 @@
 #ifndef TABCOMPLETER_H_
 #define TABCOMPLETER_H_
 
+#include <QDateTime>
 #include <QPointer>
 #include <QString>
-#include <QMap>
+#include <QStringList>
 
 #include "types.h"
 
@@ -52,29 +53,30 @@ public slots:
     void onTabCompletionKey();
 
 private:
-
-    struct CompletionKey {
-        inline CompletionKey(const QString &n) { contents = n; }
-        bool operator<(const CompletionKey &other) const;
-        QString contents;
+    //! A completion candidate, along with everything its position in the list depends on
+    struct Completion {
+        QString text;
+        int rank; // lower ranks come first
+        bool isUser;
+        QDateTime lastSpokenTo;
+        QDateTime lastChannelActivity;
     };
 
+    static bool completionLessThan(const Completion &left, const Completion &right);
+
     QPointer<MultiLineEdit> _lineEdit;
     bool _enabled;
     QString _nickSuffix;
 
-    static const Network *_currentNetwork;
-    static BufferId _currentBufferId;
-    static QString _currentBufferName;
-    static Type _completionType;
-
-    QMap<CompletionKey, QString> _completionMap;
-    // QStringList completionTemplates;
+    BufferId _currentBufferId;
+    Type _completionType;
 
-    QMap<CompletionKey, QString>::Iterator _nextCompletion;
+    QStringList _completions;
+    int _nextCompletion;
     int _lastCompletionLength;
 
     void buildCompletionList();
+    void addUserCompletion(QList<Completion> &completions, const Network *network, IrcUser *ircUser, const QString &nick);
 };
 
 
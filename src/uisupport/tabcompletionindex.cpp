@@ -0,0 +1,233 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2016 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include "tabcompletionindex.h"
+
+#include "ircchannel.h"
+#include "ircuser.h"
+#include "network.h"
+
+// joins larger than this are sorted in one go rather than inserted one by one
+const int maxSortedInserts = 64;
+
+QHash<const Network *, TabCompletionIndex *> TabCompletionIndex::_indexes;
+
+TabCompletionIndex *TabCompletionIndex::forNetwork(const Network *network)
+{
+    TabCompletionIndex *index = _indexes.value(network);
+    if (!index) {
+        // the index lives as long as the network does
+        index = new TabCompletionIndex(const_cast<Network *>(network));
+        _indexes[network] = index;
+    }
+    return index;
+}
+
+
+TabCompletionIndex::TabCompletionIndex(Network *network)
+    : QObject(network),
+    _network(network)
+{
+    connect(network, SIGNAL(ircChannelAdded(IrcChannel *)), SLOT(ircChannelAdded(IrcChannel *)));
+    foreach(IrcChannel *ircChannel, network->ircChannels())
+        ircChannelAdded(ircChannel);
+}
+
+
+TabCompletionIndex::~TabCompletionIndex()
+{
+    _indexes.remove(_network);
+}
+
+
+// Tab completion skips these at the start of nicks, see TabCompleter::buildCompletionList()
+QString TabCompletionIndex::indexKey(const QString &name)
+{
+    static const QString skippedChars("-_[]{}|`^.\\");
+
+    int start = 0;
+    while (start < name.length() && skippedChars.contains(name.at(start)))
+        start++;
+    return name.mid(start).toLower();
+}
+
+
+QList<IrcChannel *> TabCompletionIndex::channels(const QString &prefix) const
+{
+    QList<IrcChannel *> result;
+    foreach(QObject *object, findEntries(_channels, indexKey(prefix)))
+        result << static_cast<IrcChannel *>(object);
+    return result;
+}
+
+
+QList<IrcUser *> TabCompletionIndex::channelUsers(IrcChannel *ircChannel, const QString &prefix) const
+{
+    QList<IrcUser *> result;
+    QHash<IrcChannel *, ChannelUsers>::const_iterator channelIter = _channelUsers.constFind(ircChannel);
+    if (channelIter == _channelUsers.constEnd())
+        return result;
+
+    foreach(QObject *object, findEntries(channelIter->users, indexKey(prefix)))
+        result << static_cast<IrcUser *>(object);
+    return result;
+}
+
+
+bool TabCompletionIndex::entryLessThan(const Entry &left, const Entry &right)
+{
+    return left.key < right.key;
+}
+
+
+void TabCompletionIndex::insertEntry(EntryList &list, const QString &key, QObject *object)
+{
+    Entry entry = { key, object };
+    EntryList::iterator iter = qUpperBound(list.begin(), list.end(), entry, entryLessThan);
+    list.insert(iter, entry);
+}
+
+
+void TabCompletionIndex::removeEntry(EntryList &list, const QString &key, QObject *object)
+{
+    Entry entry = { key, object };
+    EntryList::iterator iter = qLowerBound(list.begin(), list.end(), entry, entryLessThan);
+    while (iter != list.end() && iter->key == key) {
+        if (iter->object == object) {
+            list.erase(iter);
+            return;
+        }
+        ++iter;
+    }
+}
+
+
+QList<QObject *> TabCompletionIndex::findEntries(const EntryList &list, const QString &prefix)
+{
+    QList<QObject *> result;
+    Entry entry = { prefix, 0 };
+    EntryList::const_iterator iter = qLowerBound(list.constBegin(), list.constEnd(), entry, entryLessThan);
+    while (iter != list.constEnd() && iter->key.startsWith(prefix)) {
+        result << iter->object;
+        ++iter;
+    }
+    return result;
+}
+
+
+void TabCompletionIndex::ircChannelAdded(IrcChannel *ircChannel)
+{
+    if (_channelUsers.contains(ircChannel))
+        return;
+
+    insertEntry(_channels, indexKey(ircChannel->name()), ircChannel);
+    _channelUsers[ircChannel] = ChannelUsers();
+
+    connect(ircChannel, SIGNAL(destroyed(QObject *)), SLOT(ircChannelDestroyed(QObject *)));
+    connect(ircChannel, SIGNAL(ircUsersJoined(QList<IrcUser *>)), SLOT(ircUsersJoined(QList<IrcUser *>)));
+    connect(ircChannel, SIGNAL(ircUserParted(IrcUser *)), SLOT(ircUserParted(IrcUser *)));
+    connect(ircChannel, SIGNAL(ircUserNickSet(IrcUser *, QString)), SLOT(ircUserNickSet(IrcUser *, QString)));
+
+    addUsers(ircChannel, ircChannel->ircUsers());
+}
+
+
+void TabCompletionIndex::ircChannelDestroyed(QObject *object)
+{
+    // the channel is gone already, so we can only use its address
+    IrcChannel *ircChannel = static_cast<IrcChannel *>(object);
+    for (int i = 0; i < _channels.count(); i++) {
+        if (_channels.at(i).object == object) {
+            _channels.remove(i);
+            break;
+        }
+    }
+    _channelUsers.remove(ircChannel);
+}
+
+
+void TabCompletionIndex::ircUsersJoined(const QList<IrcUser *> &ircUsers)
+{
+    IrcChannel *ircChannel = qobject_cast<IrcChannel *>(sender());
+    if (ircChannel)
+        addUsers(ircChannel, ircUsers);
+}
+
+
+void TabCompletionIndex::addUsers(IrcChannel *ircChannel, const QList<IrcUser *> &ircUsers)
+{
+    ChannelUsers &channelUsers = _channelUsers[ircChannel];
+    bool sortAll = ircUsers.count() > maxSortedInserts;
+    foreach(IrcUser *ircUser, ircUsers) {
+        if (channelUsers.userKeys.contains(ircUser))
+            continue;
+
+        QString key = indexKey(ircUser->nick());
+        channelUsers.userKeys[ircUser] = key;
+        if (sortAll) {
+            Entry entry = { key, ircUser };
+            channelUsers.users << entry;
+        }
+        else {
+            insertEntry(channelUsers.users, key, ircUser);
+        }
+        // users might be destroyed without parting first
+        connect(ircUser, SIGNAL(destroyed(QObject *)), SLOT(ircUserDestroyed(QObject *)), Qt::UniqueConnection);
+    }
+    if (sortAll)
+        qStableSort(channelUsers.users.begin(), channelUsers.users.end(), entryLessThan);
+}
+
+
+void TabCompletionIndex::ircUserParted(IrcUser *ircUser)
+{
+    IrcChannel *ircChannel = qobject_cast<IrcChannel *>(sender());
+    QHash<IrcChannel *, ChannelUsers>::iterator channelIter = _channelUsers.find(ircChannel);
+    if (channelIter == _channelUsers.end() || !channelIter->userKeys.contains(ircUser))
+        return;
+
+    removeEntry(channelIter->users, channelIter->userKeys.take(ircUser), ircUser);
+}
+
+
+void TabCompletionIndex::ircUserNickSet(IrcUser *ircUser, const QString &nick)
+{
+    IrcChannel *ircChannel = qobject_cast<IrcChannel *>(sender());
+    QHash<IrcChannel *, ChannelUsers>::iterator channelIter = _channelUsers.find(ircChannel);
+    if (channelIter == _channelUsers.end() || !channelIter->userKeys.contains(ircUser))
+        return;
+
+    QString key = indexKey(nick);
+    removeEntry(channelIter->users, channelIter->userKeys.value(ircUser), ircUser);
+    insertEntry(channelIter->users, key, ircUser);
+    channelIter->userKeys[ircUser] = key;
+}
+
+
+void TabCompletionIndex::ircUserDestroyed(QObject *object)
+{
+    // the user is gone already, so we can only use its address
+    IrcUser *ircUser = static_cast<IrcUser *>(object);
+    QHash<IrcChannel *, ChannelUsers>::iterator channelIter = _channelUsers.begin();
+    for (; channelIter != _channelUsers.end(); ++channelIter) {
+        if (channelIter->userKeys.contains(ircUser))
+            removeEntry(channelIter->users, channelIter->userKeys.take(ircUser), ircUser);
+    }
+}
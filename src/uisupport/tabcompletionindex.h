@@ -0,0 +1,94 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2016 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#ifndef TABCOMPLETIONINDEX_H_
+#define TABCOMPLETIONINDEX_H_
+
+#include <QHash>
+#include <QObject>
+#include <QVector>
+
+class IrcChannel;
+class IrcUser;
+class Network;
+
+//! Channel names and channel members of a network, sorted for prefix lookups
+/** Keys are lower case, with the leading characters that tab completion skips removed.
+ *  The index is created on first use and then kept up to date from the network's join, part and nick change
+ *  signals, so completing in large channels doesn't need to go through all of their users.
+ */
+class TabCompletionIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    //! Returns the index of the given network, creating it if necessary
+    static TabCompletionIndex *forNetwork(const Network *network);
+
+    //! Returns the key the given nick or channel name is indexed by
+    static QString indexKey(const QString &name);
+
+    //! Channels whose key starts with the key of the given prefix, in no particular order
+    QList<IrcChannel *> channels(const QString &prefix) const;
+
+    //! Members of the given channel whose key starts with the key of the given prefix, in no particular order
+    /** This is a superset of what TabCompleter matches, so callers still need to check the actual nicks.
+     */
+    QList<IrcUser *> channelUsers(IrcChannel *ircChannel, const QString &prefix) const;
+
+private slots:
+    void ircChannelAdded(IrcChannel *ircChannel);
+    void ircChannelDestroyed(QObject *object);
+    void ircUsersJoined(const QList<IrcUser *> &ircUsers);
+    void ircUserParted(IrcUser *ircUser);
+    void ircUserNickSet(IrcUser *ircUser, const QString &nick);
+    void ircUserDestroyed(QObject *object);
+
+private:
+    struct Entry {
+        QString key;
+        QObject *object;
+    };
+    typedef QVector<Entry> EntryList;
+
+    struct ChannelUsers {
+        EntryList users; // sorted by key
+        QHash<IrcUser *, QString> userKeys; // the key every user is currently indexed by
+    };
+
+    TabCompletionIndex(Network *network);
+    ~TabCompletionIndex();
+
+    static bool entryLessThan(const Entry &left, const Entry &right);
+    static void insertEntry(EntryList &list, const QString &key, QObject *object);
+    static void removeEntry(EntryList &list, const QString &key, QObject *object);
+    static QList<QObject *> findEntries(const EntryList &list, const QString &prefix);
+
+    void addUsers(IrcChannel *ircChannel, const QList<IrcUser *> &ircUsers);
+
+    const Network *_network;
+    EntryList _channels;
+    QHash<IrcChannel *, ChannelUsers> _channelUsers;
+
+    static QHash<const Network *, TabCompletionIndex *> _indexes;
+};
+
+
+#endif
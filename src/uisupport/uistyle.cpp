@@ -41,7 +41,8 @@ UiStyle::UiStyle(QObject *parent)
     _categoryOpIcon(QIcon::fromTheme("irc-operator")),
     _categoryVoiceIcon(QIcon::fromTheme("irc-voice")),
     _opIconLimit(UserCategoryItem::categoryFromModes("o")),
-    _voiceIconLimit(UserCategoryItem::categoryFromModes("v"))
+    _voiceIconLimit(UserCategoryItem::categoryFromModes("v")),
+    _formatTableHashCount(1)
 {
     // register FormatList if that hasn't happened yet
     // FIXME I don't think this actually avoids double registration... then again... does it hurt?
@@ -97,6 +98,7 @@ void UiStyle::loadStyleSheet()
     qDeleteAll(_metricsCache);
     _metricsCache.clear();
     _formatCache.clear();
+    _formatTable.clear();
     _formats.clear();
 
     UiStyleSettings s;
@@ -123,8 +125,18 @@ void UiStyle::loadStyleSheet()
     styleSheet += loadStyleSheet("file:///" + Quassel::optionValue("qss"), true);
 
     if (!styleSheet.isEmpty()) {
-        QssParser parser;
-        parser.processStyleSheet(styleSheet);
+        // We replace the application palette with the stylesheet's below, so reloading has to start from the
+        // one we had before that; it's also what the next start of the client will start from.
+        static const QPalette systemPalette = QApplication::palette();
+
+        // parsing large custom themes takes a while, so we reuse the result of the last run if the sheet didn't change
+        QssParser parser(systemPalette);
+        QString compiledPath = Quassel::configDirPath() + "stylesheet.compiled";
+        QByteArray compiledKey = QssParser::compiledKey(styleSheet, systemPalette);
+        if (!parser.loadCompiled(compiledPath, compiledKey, &styleSheet)) {
+            parser.processStyleSheet(styleSheet);
+            parser.saveCompiled(compiledPath, compiledKey, styleSheet);
+        }
         QApplication::setPalette(parser.palette());
 
         _uiStylePalette = parser.uiStylePalette();
@@ -136,6 +148,7 @@ void UiStyle::loadStyleSheet()
             qApp->setStyleSheet(styleSheet);  // pass the remaining sections to the application
     }
 
+    buildFormatTable();
     emit changed();
 }
 
@@ -176,6 +189,7 @@ void UiStyle::setTimestampFormatString(const QString &format)
 void UiStyle::allowMircColorsChanged(const QVariant &v)
 {
     _allowMircColors = v.toBool();
+    _formatCache.clear(); // the table doesn't contain mIRC colors, so it stays valid
     emit changed();
 }
 
@@ -331,15 +345,76 @@ QTextCharFormat UiStyle::format(quint64 key) const
 }
 
 
-QTextCharFormat UiStyle::cachedFormat(quint32 formatType, quint32 messageLabel) const
+// Number of message type slots in the format table: 0x00 to 0x10, then 0x20 and 0x30
+const int formatTableTypeCount = 0x13;
+// Sender hashes are 1 to 16, 0 means none
+const int maxSenderHashCount = 17;
+
+// The formats of the message parts we lay out for every line (i.e. a message type, at most one of timestamp,
+// sender and contents, and any labels) are computed into a flat table when the stylesheet is loaded. All other
+// combinations (mIRC formats and colors, nicks, URLs, ...) are merged on first use and cached in _formatCache.
+int UiStyle::formatTableIndex(quint32 ftype, quint32 label) const
 {
-    return _formatCache.value(formatType | ((quint64)messageLabel << 32), QTextCharFormat());
+    quint32 msgType = ftype & 0x000000ff;
+    quint32 senderHash = label >> 16;
+    if ((label & 0x0000fff8) || senderHash >= (quint32)maxSenderHashCount)
+        return -1;
+    if (msgType > 0x10 && ((msgType & 0x0f) || msgType > 0x30))
+        return -1;
+
+    int elementIndex;
+    switch (ftype & 0xffffff00) {
+        case 0:
+            elementIndex = 0;
+            break;
+        case Timestamp:
+            elementIndex = 1;
+            break;
+        case Sender:
+            elementIndex = 2;
+            break;
+        case Contents:
+            elementIndex = 3;
+            break;
+        default:
+            return -1;
+    }
+
+    // if the stylesheet doesn't have any formats for sender hashes, we don't need them in the table
+    if (_formatTableHashCount == 1)
+        senderHash = 0;
+
+    int typeIndex = msgType <= 0x10 ? msgType : 0x0f + (msgType >> 4);
+    return ((typeIndex * 4 + elementIndex) * 8 + (label & 0x07)) * _formatTableHashCount + senderHash;
 }
 
 
-void UiStyle::setCachedFormat(const QTextCharFormat &format, quint32 formatType, quint32 messageLabel) const
+void UiStyle::buildFormatTable()
 {
-    _formatCache[formatType | ((quint64)messageLabel << 32)] = format;
+    _formatTable.clear();
+    _formatTableHashCount = 1;
+    foreach(quint64 key, _formats.keys()) {
+        if (key & Q_UINT64_C(0xffff000000000000)) {
+            _formatTableHashCount = maxSenderHashCount;
+            break;
+        }
+    }
+
+    static const quint32 elements[] = { 0, Timestamp, Sender, Contents };
+
+    QVector<QTextCharFormat> table(formatTableTypeCount * 4 * 8 * _formatTableHashCount);
+    for (int typeIndex = 0; typeIndex < formatTableTypeCount; typeIndex++) {
+        quint32 msgType = typeIndex <= 0x10 ? typeIndex : (typeIndex - 0x0f) << 4;
+        for (int e = 0; e < 4; e++) {
+            for (quint32 labelFlags = 0; labelFlags < 8; labelFlags++) {
+                for (int hash = 0; hash < _formatTableHashCount; hash++) {
+                    quint32 label = labelFlags | (hash << 16);
+                    table[formatTableIndex(msgType | elements[e], label)] = mergedFormat(msgType | elements[e], label);
+                }
+            }
+        }
+    }
+    _formatTable = table;
 }
 
 
@@ -348,8 +423,9 @@ QFontMetricsF *UiStyle::fontMetrics(quint32 ftype, quint32 label) const
     // QFontMetricsF is not assignable, so we need to store pointers :/
     quint64 key = ftype | ((quint64)label << 32);
 
-    if (_metricsCache.contains(key))
-        return _metricsCache.value(key);
+    QHash<quint64, QFontMetricsF *>::const_iterator iter = _metricsCache.constFind(key);
+    if (iter != _metricsCache.constEnd())
+        return *iter;
 
     return (_metricsCache[key] = new QFontMetricsF(format(ftype, label).font()));
 }
@@ -359,26 +435,40 @@ QFontMetricsF *UiStyle::fontMetrics(quint32 ftype, quint32 label) const
 
 // NOTE: This and the following functions are intimately tied to the values in FormatType. Don't change this
 //       until you _really_ know what you do!
-QTextCharFormat UiStyle::format(quint32 ftype, quint32 label_) const
+QTextCharFormat UiStyle::format(quint32 ftype, quint32 label) const
 {
     if (ftype == Invalid)
         return QTextCharFormat();
 
-    quint64 label = (quint64)label_ << 32;
+    if (!_formatTable.isEmpty()) {
+        int tableIndex = formatTableIndex(ftype, label);
+        if (tableIndex >= 0)
+            return _formatTable.at(tableIndex);
+    }
 
     // check if we have exactly this format readily cached already
-    QTextCharFormat fmt = cachedFormat(ftype, label_);
-    if (fmt.properties().count())
-        return fmt;
+    quint64 key = ftype | ((quint64)label << 32);
+    QHash<quint64, QTextCharFormat>::const_iterator iter = _formatCache.constFind(key);
+    if (iter != _formatCache.constEnd())
+        return *iter;
+
+    QTextCharFormat fmt = mergedFormat(ftype, label);
+    _formatCache.insert(key, fmt);
+    return fmt;
+}
 
+
+QTextCharFormat UiStyle::mergedFormat(quint32 ftype, quint32 label_) const
+{
+    quint64 label = (quint64)label_ << 32;
+
+    QTextCharFormat fmt;
     mergeFormat(fmt, ftype, label & Q_UINT64_C(0xffff000000000000));
 
     for (quint64 mask = Q_UINT64_C(0x0000000100000000); mask <= (quint64)Selected << 32; mask <<= 1) {
         if (label & mask)
             mergeFormat(fmt, ftype, mask | Q_UINT64_C(0xffff000000000000));
     }
-
-    setCachedFormat(fmt, ftype, label_);
     return fmt;
 }
 
@@ -652,6 +742,94 @@ QString UiStyle::mircToInternal(const QString &mirc_)
 }
 
 
+// Reads a one or two digit mIRC color code starting at pos, and moves pos behind it
+static int mircColor(const QString &mirc, int *pos)
+{
+    int color = mirc.at((*pos)++).digitValue();
+    if (*pos < mirc.length() && mirc.at(*pos).isDigit())
+        color = 10 * color + mirc.at((*pos)++).digitValue();
+    return color;
+}
+
+
+// The result is the same as going through mircToInternal() and styleString(), but we don't need to build
+// (and parse) the intermediate string. Keep those in sync!
+UiStyle::StyledString UiStyle::styleMircString(const QString &mirc, quint32 baseFormat)
+{
+    // Tabs expand to 8 characters, so this keeps us within the quint16 indexes (styleString() handles the rest)
+    if (mirc.length() > 65535 / 8)
+        return styleString(mircToInternal(mirc), baseFormat);
+
+    StyledString result;
+    result.formatList.append(qMakePair((quint16)0, baseFormat));
+    result.plainText.reserve(mirc.length());
+
+    quint32 curfmt = baseFormat;
+    int length = mirc.length();
+    int pos = 0;
+    while (pos < length) {
+        ushort c = mirc.at(pos).unicode();
+        if (c >= 0x20 && c != 0x7f) {
+            result.plainText += mirc.at(pos++);
+            continue;
+        }
+
+        pos++;
+        switch (c) {
+            case '\x02':
+                curfmt ^= Bold;
+                break;
+            case '\x0f':
+                curfmt &= 0x000000ff; // we keep message type-specific formatting
+                break;
+            case '\x12':
+            case '\x16':
+                // TODO: implement reverse formatting
+                break;
+            case '\x1d':
+                curfmt ^= Italic;
+                break;
+            case '\x1f':
+                curfmt ^= Underline;
+                break;
+            case '\x03':
+                // Note: We use the "mirc standard" as described in <http://www.mirc.co.uk/help/color.txt>.
+                //       This means that we don't accept something like \x03,5 (even though others, like WeeChat, do).
+                if (pos < length && mirc.at(pos).isDigit()) {
+                    //TODO: use 99 as transparent color (re mirc color "standard")
+                    quint32 color = mircColor(mirc, &pos) & 0x0f;
+                    curfmt = (curfmt & 0xf0ffffff) | (color << 24) | 0x00400000;
+                    if (pos + 1 < length && mirc.at(pos) == ',' && mirc.at(pos + 1).isDigit()) {
+                        pos++;
+                        color = mircColor(mirc, &pos) & 0x0f;
+                        curfmt = (curfmt & 0x0fffffff) | (color << 28) | 0x00800000;
+                    }
+                }
+                else {
+                    curfmt &= 0x003fffff;
+                }
+                break;
+            case '\x09':
+                result.plainText += QString(8, ' ');
+                continue;
+            case '\x7f':
+                result.plainText += QChar(0x2421);
+                continue;
+            default:
+                result.plainText += QChar(0x2400 + c);
+                continue;
+        }
+
+        quint16 textPos = result.plainText.length();
+        if (textPos == result.formatList.last().first)
+            result.formatList.last().second = curfmt;
+        else
+            result.formatList.append(qMakePair(textPos, curfmt));
+    }
+    return result;
+}
+
+
 /***********************************************************************************/
 UiStyle::StyledMessage::StyledMessage(const Message &msg)
     : Message(msg)
@@ -665,6 +843,21 @@ UiStyle::StyledMessage::StyledMessage(const Message &msg)
 
 void UiStyle::StyledMessage::style() const
 {
+    switch (type()) {
+    case Message::Plain:
+    case Message::Notice:
+    case Message::Server:
+    case Message::Info:
+    case Message::Error:
+    case Message::Topic:
+    case Message::Invite:
+        // these show just the contents, so there's no need for the internal format codes
+        _contents = UiStyle::styleMircString(contents(), UiStyle::formatType(type()));
+        return;
+    default:
+        break;
+    }
+
     QString user = userFromMask(sender());
     QString host = hostFromMask(sender());
     QString nick = nickFromMask(sender());
@@ -678,10 +871,6 @@ void UiStyle::StyledMessage::style() const
 
     QString t;
     switch (type()) {
-    case Message::Plain:
-        t = QString("%1").arg(txt); break;
-    case Message::Notice:
-        t = QString("%1").arg(txt); break;
     case Message::Action:
         t = QString("%DN%1%DN %2").arg(nick).arg(txt);
         break;
@@ -719,20 +908,12 @@ void UiStyle::StyledMessage::style() const
     break;
     //case Message::Kill: FIXME
 
-    case Message::Server:
-        t = QString("%1").arg(txt); break;
-    case Message::Info:
-        t = QString("%1").arg(txt); break;
-    case Message::Error:
-        t = QString("%1").arg(txt); break;
     case Message::DayChange:
     {
         //: Day Change Message
         t = tr("{Day changed to %1}").arg(timestamp().date().toString(Qt::DefaultLocaleLongDate));
     }
         break;
-    case Message::Topic:
-        t = QString("%1").arg(txt); break;
     case Message::NetsplitJoin:
     {
         QStringList users = txt.split("#:#");
@@ -764,8 +945,6 @@ void UiStyle::StyledMessage::style() const
             t.append(tr("%DN%1%DN (%2 more)").arg(static_cast<QStringList>(users.mid(0, maxNetsplitNicks)).join(", ")).arg(users.count() - maxNetsplitNicks));
     }
     break;
-    case Message::Invite:
-        t = QString("%1").arg(txt); break;
     default:
         t = QString("[%1]").arg(txt);
     }
@@ -791,6 +970,14 @@ const UiStyle::FormatList &UiStyle::StyledMessage::contentsFormatList() const
 }
 
 
+int UiStyle::StyledMessage::styleMemoryUsage() const
+{
+    if (!isStyled())
+        return 0;
+    return _contents.plainText.capacity() * sizeof(QChar) + _contents.formatList.count() * sizeof(FormatList::value_type);
+}
+
+
 QString UiStyle::StyledMessage::decoratedTimestamp() const
 {
     return timestamp().toLocalTime().toString(UiStyle::timestampFormatString());
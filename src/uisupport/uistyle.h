@@ -137,6 +137,8 @@ public:
     static FormatType formatType(Message::Type msgType);
     static StyledString styleString(const QString &string, quint32 baseFormat = Base);
     static QString mircToInternal(const QString &);
+    //! Styles mIRC-formatted text in a single pass; equivalent to styleString(mircToInternal(mirc), baseFormat)
+    static StyledString styleMircString(const QString &mirc, quint32 baseFormat = Base);
     static inline QString timestampFormatString() { return _timestampFormatString; }
 
     QTextCharFormat format(quint32 formatType, quint32 messageLabel) const;
@@ -161,8 +163,7 @@ protected:
     QString loadStyleSheet(const QString &name, bool shouldExist = false);
 
     QTextCharFormat format(quint64 key) const;
-    QTextCharFormat cachedFormat(quint32 formatType, quint32 messageLabel) const;
-    void setCachedFormat(const QTextCharFormat &format, quint32 formatType, quint32 messageLabel) const;
+    QTextCharFormat mergedFormat(quint32 formatType, quint32 messageLabel) const;
     void mergeFormat(QTextCharFormat &format, quint32 formatType, quint64 messageLabel) const;
     void mergeSubElementFormat(QTextCharFormat &format, quint32 formatType, quint64 messageLabel) const;
 
@@ -177,9 +178,14 @@ private slots:
     void showItemViewIconsChanged(const QVariant &);
 
 private:
+    void buildFormatTable();
+    int formatTableIndex(quint32 formatType, quint32 messageLabel) const;
+
     QVector<QBrush> _uiStylePalette;
     QBrush _markerLineBrush;
     QHash<quint64, QTextCharFormat> _formats;
+    QVector<QTextCharFormat> _formatTable; // see buildFormatTable()
+    int _formatTableHashCount;
     mutable QHash<quint64, QTextCharFormat> _formatCache;
     mutable QHash<quint64, QFontMetricsF *> _metricsCache;
     QHash<quint32, QTextCharFormat> _listItemFormats;
@@ -217,6 +223,20 @@ public:
 
     quint8 senderHash() const;
 
+    //! Whether the styled contents have been computed (they are created lazily on first access)
+    inline bool isStyled() const { return !_contents.plainText.isNull(); }
+    //! Drops the styled contents to save memory; they will be recomputed on the next access
+    inline void clearStyle() { _contents = StyledString(); }
+
+    //! Approximate heap memory used by the styled contents
+    int styleMemoryUsage() const;
+
+    //! Computes the styled contents right away, e.g. in a worker thread, rather than on first access
+    inline void prestyle() const { if (!isStyled()) style(); }
+
+    //! Takes over the styled contents of other, which must be a copy of the same message
+    inline void adoptStyle(const StyledMessage &other) { _contents = other._contents; }
+
 protected:
     void style() const;
 
@@ -0,0 +1,202 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2016 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <QFile>
+#include <QRegExp>
+#include <QStringList>
+#include <QTextStream>
+#include <QtTest>
+
+#include "clickable.h"
+
+//! Checks ClickableList::fromString() against the regular expressions it replaced
+/** The corpus in data/irclines.txt is scanned both ways, and the results have to be the same. The benchmarks
+ *  run both implementations over the whole corpus.
+ */
+class ClickableTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void equivalence();
+    void examples_data();
+    void examples();
+
+    void benchmarkScanner();
+    void benchmarkRegExps();
+
+private:
+    static ClickableList regExpClickables(const QString &str);
+    static QString toString(const ClickableList &clickables);
+
+    QStringList _lines;
+};
+
+
+void ClickableTest::initTestCase()
+{
+    QFile file(TESTDATA_DIR "/irclines.txt");
+    QVERIFY(file.open(QIODevice::ReadOnly | QIODevice::Text));
+
+    QTextStream stream(&file);
+    stream.setCodec("UTF-8");
+    while (!stream.atEnd())
+        _lines << stream.readLine();
+    QVERIFY(!_lines.isEmpty());
+}
+
+
+// This is what ClickableList::fromString() used to do, including its quirks
+ClickableList ClickableTest::regExpClickables(const QString &str)
+{
+    static QString scheme("(?:(?:mailto:|(?:[+.-]?\\w)+://)|www(?=\\.\\S+\\.))");
+    static QString authority("(?:(?:[,.;@:]?[-\\w]+)+\\.?|\\[[0-9a-f:.]+\\])(?::\\d+)?");
+    static QString urlChars("(?:[,.;:]*[\\w~@/?&=+$()!%#*-])");
+    static QString urlEnd("(?:>|[,.;:\"]*\\s|\\b|$)");
+
+    static QRegExp regExp[] = {
+        QRegExp(QString("\\b(%1%2(?:/%3*)?)%4").arg(scheme, authority, urlChars, urlEnd), Qt::CaseInsensitive),
+        QRegExp("((?:#|![A-Z0-9]{5})[^,:\\s]+(?::[^,:\\s]+)?)\\b", Qt::CaseInsensitive)
+    };
+
+    static const int regExpCount = 2;
+
+    qint16 matches[] = { 0, 0, 0 };
+    qint16 matchEnd[] = { 0, 0, 0 };
+
+    ClickableList result;
+
+    qint16 idx = 0;
+    qint16 minidx;
+    int type = -1;
+
+    do {
+        type = -1;
+        minidx = str.length();
+        for (int i = 0; i < regExpCount; i++) {
+            if (matches[i] < 0 || matchEnd[i] > str.length()) continue;
+            if (idx >= matchEnd[i]) {
+                matches[i] = regExp[i].indexIn(str, qMax(matchEnd[i], idx));
+                if (matches[i] >= 0) matchEnd[i] = matches[i] + regExp[i].cap(1).length();
+            }
+            if (matches[i] >= 0 && matches[i] < minidx) {
+                minidx = matches[i];
+                type = i;
+            }
+        }
+        if (type >= 0) {
+            idx = matchEnd[type];
+            QString match = str.mid(matches[type], matchEnd[type] - matches[type]);
+            if (type == Clickable::Url && str.at(idx-1) == ')') {
+                if (!match.contains('(')) {
+                    matchEnd[type]--;
+                    match.chop(1);
+                }
+            }
+            if (type == Clickable::Channel) {
+                if (QRegExp("^#\\d+$").exactMatch(match))
+                    continue;
+            }
+            result.append(Clickable((Clickable::Type)type, matches[type], matchEnd[type] - matches[type]));
+        }
+    }
+    while (type >= 0);
+    return result;
+}
+
+
+QString ClickableTest::toString(const ClickableList &clickables)
+{
+    QStringList result;
+    foreach(const Clickable &clickable, clickables)
+        result << QString("%1:%2+%3").arg(clickable.type()).arg(clickable.start()).arg(clickable.length());
+    return result.join(" ");
+}
+
+
+void ClickableTest::equivalence()
+{
+    foreach(const QString &line, _lines) {
+        // The regexps could yield overlapping matches, whereas the scanner keeps the leftmost one only
+        ClickableList expected;
+        foreach(const Clickable &clickable, regExpClickables(line)) {
+            if (!expected.isEmpty() && clickable.start() < expected.last().start() + expected.last().length())
+                continue;
+            expected << clickable;
+        }
+
+        QString actual = toString(ClickableList::fromString(line));
+        if (actual != toString(expected))
+            QFAIL(qPrintable(QString("\"%1\": got [%2], expected [%3]").arg(line, actual, toString(expected))));
+    }
+}
+
+
+void ClickableTest::examples_data()
+{
+    QTest::addColumn<QString>("line");
+    QTest::addColumn<QString>("clickables");
+
+    QTest::newRow("plain") << "no links here" << "";
+    QTest::newRow("url") << "see http://example.org/foo." << "0:4+22";
+    QTest::newRow("www") << "www.quassel-irc.org rocks" << "0:0+19";
+    QTest::newRow("parens") << "(http://example.org/foo_(bar))" << "0:1+29";
+    QTest::newRow("unbalanced") << "(http://example.org/foo)" << "0:1+22";
+    QTest::newRow("ipv6") << "http://[2001:db8::1]:8080/ ok" << "0:0+26";
+    QTest::newRow("channels") << "join #quassel, #qt-de" << "1:5+8 1:15+6";
+    QTest::newRow("safe channel") << "!ABCDEsafe" << "1:0+10";
+    QTest::newRow("channel number") << "#42 is not a channel" << "";
+    QTest::newRow("mixed") << "#chan http://a.example/#x" << "1:0+5 0:6+19";
+}
+
+
+void ClickableTest::examples()
+{
+    QFETCH(QString, line);
+    QFETCH(QString, clickables);
+
+    QCOMPARE(toString(ClickableList::fromString(line)), clickables);
+    QCOMPARE(toString(regExpClickables(line)), clickables);
+}
+
+
+void ClickableTest::benchmarkScanner()
+{
+    QBENCHMARK {
+        foreach(const QString &line, _lines)
+            ClickableList::fromString(line);
+    }
+}
+
+
+void ClickableTest::benchmarkRegExps()
+{
+    QBENCHMARK {
+        foreach(const QString &line, _lines)
+            regExpClickables(line);
+    }
+}
+
+
+QTEST_APPLESS_MAIN(ClickableTest)
+
+#include "clickabletest.moc"
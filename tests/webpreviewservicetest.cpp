@@ -0,0 +1,252 @@
+/***************************************************************************
+ *   Copyright (C) 2005-2016 by the Quassel Project                        *
+ *   devel@quassel-irc.org                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) version 3.                                           *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.         *
+ ***************************************************************************/
+
+#include <QSignalSpy>
+#include <QStringList>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTime>
+#include <QtTest>
+
+#include "webpreviewservice.h"
+
+// short enough to keep the test fast, but long enough to make a difference
+const int requestDelay = 50;
+
+//! A minimal HTTP server that serves a small page for every path
+/** Requests for /hang are accepted, but never answered.
+ */
+class PageServer : public QTcpServer
+{
+    Q_OBJECT
+
+public:
+    PageServer(QObject *parent = 0)
+        : QTcpServer(parent)
+    {
+        connect(this, SIGNAL(newConnection()), SLOT(acceptConnections()));
+    }
+
+    inline QUrl url(const QString &path) const { return QUrl(QString("http://127.0.0.1:%1%2").arg(serverPort()).arg(path)); }
+
+    QStringList requests; // the requested paths, in order
+
+private slots:
+    void acceptConnections()
+    {
+        while (hasPendingConnections()) {
+            QTcpSocket *socket = nextPendingConnection();
+            connect(socket, SIGNAL(readyRead()), SLOT(readRequest()));
+            connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+        }
+    }
+
+    void readRequest()
+    {
+        QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+        if (!socket || !socket->canReadLine())
+            return;
+
+        // we only care about the request line, the headers are ignored
+        disconnect(socket, SIGNAL(readyRead()), this, SLOT(readRequest()));
+        QString path = QString::fromLatin1(socket->readLine()).section(' ', 1, 1);
+        if (path == "/favicon.ico") {
+            socket->write("HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            socket->disconnectFromHost();
+            return;
+        }
+
+        requests << path;
+        if (path == "/hang")
+            return;
+
+        QByteArray body = QString("<html><head><title>%1</title></head><body><h1>%1</h1></body></html>").arg(path).toUtf8();
+        socket->write("HTTP/1.0 200 OK\r\nContent-Type: text/html\r\nContent-Length: " + QByteArray::number(body.size())
+            + "\r\nConnection: close\r\n\r\n" + body);
+        socket->disconnectFromHost();
+    }
+};
+
+
+class WebPreviewServiceTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void preview();
+    void latestRequestWins();
+    void cancel();
+    void timeout();
+    void cacheEviction();
+
+private:
+    bool waitForPreviews(int count, int timeout = 10000);
+
+    PageServer _server;
+    WebPreviewService *_service;
+    QSignalSpy *_readySpy;
+};
+
+
+void WebPreviewServiceTest::initTestCase()
+{
+    QVERIFY(_server.listen(QHostAddress::LocalHost));
+}
+
+
+void WebPreviewServiceTest::init()
+{
+    _server.requests.clear();
+    _service = new WebPreviewService(this);
+    _service->setRequestDelay(requestDelay);
+    _readySpy = new QSignalSpy(_service, SIGNAL(previewReady(const QUrl &)));
+}
+
+
+void WebPreviewServiceTest::cleanup()
+{
+    delete _readySpy;
+    delete _service;
+}
+
+
+bool WebPreviewServiceTest::waitForPreviews(int count, int timeout)
+{
+    QTime time;
+    time.start();
+    while (_readySpy->count() < count && time.elapsed() < timeout)
+        QTest::qWait(10);
+    return _readySpy->count() >= count;
+}
+
+
+void WebPreviewServiceTest::preview()
+{
+    QUrl url = _server.url("/page");
+    QVERIFY(_service->preview(url).isNull());
+
+    _service->request(url);
+    QVERIFY(waitForPreviews(1));
+    QCOMPARE(_readySpy->at(0).at(0).toUrl(), url);
+    QCOMPARE(_server.requests, QStringList() << "/page");
+
+    QPixmap pixmap = _service->preview(url);
+    QVERIFY(!pixmap.isNull());
+    QCOMPARE(pixmap.size(), WebPreviewService::thumbnailSize());
+
+    // cached now, so asking again doesn't load it again
+    _service->request(url);
+    QTest::qWait(4 * requestDelay);
+    QCOMPARE(_server.requests.count(), 1);
+    QCOMPARE(_readySpy->count(), 1);
+}
+
+
+void WebPreviewServiceTest::latestRequestWins()
+{
+    _service->request(_server.url("/first"));
+    _service->request(_server.url("/second"));
+    QVERIFY(waitForPreviews(1));
+    QTest::qWait(4 * requestDelay);
+
+    QCOMPARE(_server.requests, QStringList() << "/second");
+    QCOMPARE(_readySpy->count(), 1);
+    QVERIFY(_service->preview(_server.url("/first")).isNull());
+}
+
+
+void WebPreviewServiceTest::cancel()
+{
+    QUrl url = _server.url("/page");
+    _service->request(url);
+    _service->cancel(url);
+    QTest::qWait(4 * requestDelay);
+
+    QVERIFY(_server.requests.isEmpty());
+    QVERIFY(_service->loadingUrl().isEmpty());
+    QCOMPARE(_readySpy->count(), 0);
+
+    // cancelling some other URL doesn't affect the pending request
+    _service->request(url);
+    _service->cancel(_server.url("/other"));
+    QVERIFY(waitForPreviews(1));
+    QCOMPARE(_server.requests, QStringList() << "/page");
+}
+
+
+void WebPreviewServiceTest::timeout()
+{
+    QUrl url = _server.url("/hang");
+    _service->setLoadTimeout(300);
+    _service->request(url);
+
+    QTime time;
+    time.start();
+    while (_server.requests.isEmpty() && time.elapsed() < 5000)
+        QTest::qWait(10);
+    QCOMPARE(_server.requests, QStringList() << "/hang");
+    QCOMPARE(_service->loadingUrl(), url);
+
+    while (!_service->loadingUrl().isEmpty() && time.elapsed() < 5000)
+        QTest::qWait(10);
+    QVERIFY(_service->loadingUrl().isEmpty());
+    QCOMPARE(_readySpy->count(), 0);
+    QVERIFY(_service->preview(url).isNull());
+
+    // the service isn't stuck on the page that never came
+    _service->request(_server.url("/page"));
+    QVERIFY(waitForPreviews(1));
+    QCOMPARE(_readySpy->at(0).at(0).toUrl(), _server.url("/page"));
+}
+
+
+void WebPreviewServiceTest::cacheEviction()
+{
+    QCOMPARE(_service->maxCacheSize(), 16 * 1024);
+
+    QUrl first = _server.url("/page/0");
+    _service->request(first);
+    QVERIFY(waitForPreviews(1));
+    int cost = _service->cacheSize();
+    QVERIFY(cost > 0);
+
+    // load a couple more pages than fit into the cache
+    int count = _service->maxCacheSize() / cost + 2;
+    QUrl last;
+    for (int i = 1; i < count; i++) {
+        last = _server.url(QString("/page/%1").arg(i));
+        _service->request(last);
+        QVERIFY(waitForPreviews(i + 1));
+    }
+
+    QCOMPARE(_server.requests.count(), count);
+    QVERIFY(_service->cacheSize() <= _service->maxCacheSize());
+    QVERIFY(_service->preview(first).isNull());
+    QVERIFY(!_service->preview(last).isNull());
+}
+
+
+QTEST_MAIN(WebPreviewServiceTest)
+
+#include "webpreviewservicetest.moc"